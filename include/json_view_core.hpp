@@ -1,53 +1,1121 @@
 #pragma once
 
 #include <nlohmann/json.hpp>
+#include <atomic>
+#include <climits>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <map>
 
 using json = nlohmann::json;
 
+class NodeTree;
+struct ParseProgress;
+struct SearchState;
+
+// Compression of an input, recognised by its first bytes.
+enum class Compression
+{
+    None,
+    Gzip,
+    Zstd,
+};
+
+Compression detectCompression(std::string_view head);
+// Compression of the file at path, from its first bytes.
+Compression fileCompression(const std::string &path);
+
+// Raw bytes of one input document.  Regular files (including a regular
+// file redirected to stdin) are memory-mapped read-only so the parser reads
+// straight from the page cache; pipes and terminals are read into a heap
+// buffer instead.
+class InputBuffer
+{
+public:
+    InputBuffer() = default;
+    ~InputBuffer();
+    InputBuffer(const InputBuffer &) = delete;
+    InputBuffer &operator=(const InputBuffer &) = delete;
+    InputBuffer(InputBuffer &&other) noexcept;
+    InputBuffer &operator=(InputBuffer &&other) noexcept;
+
+    bool openFile(const std::string &path, std::string &error);
+    bool openDescriptor(int fd, std::string &error);
+    void release();
+    // Replace gzip or zstd contents by their text, which is decompressed
+    // on another thread into an unlinked temporary file ($TMPDIR, else
+    // /var/tmp) and mapped from there, so it is paged like any input file
+    // rather than held in memory.  Other contents are left alone.
+    bool decompress(std::string &error, ParseProgress *progress = nullptr);
+
+    const char *data() const { return mapped ? mapped : owned.data(); }
+    size_t size() const { return mapped ? mappedSize : owned.size(); }
+    bool empty() const { return size() == 0; }
+    bool isMapped() const { return mapped != nullptr; }
+    std::string_view view() const { return std::string_view(data(), size()); }
+
+private:
+    const char *mapped = nullptr;
+    size_t mappedSize = 0;
+    std::string owned;
+};
+
+// Where a value that has not been parsed lives in its tree's source text.
+// `count` caches the number of children of a container once it has been
+// scanned for them.
+struct ValueSpan
+{
+    static constexpr uint32_t unknownCount = UINT32_MAX;
+
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    uint32_t count = unknownCount;
+};
+
+// Member names of the documents that are not parsed whole, shared by
+// every tree of the session.  Each distinct name is stored once however
+// many nodes (in however many inputs) carry it, and nodes rebuilt after
+// eviction get the same string back.  Interned strings stay put for the
+// life of the process; all members may be used from any thread.
+class KeyTable
+{
+public:
+    const std::string *intern(std::string_view key);
+    size_t size() const;
+    // Bytes held by the interned strings.
+    size_t bytes() const;
+    // Calls visit(const std::string &) for every key interned so far.
+    template <class Visit>
+    void forEach(Visit &&visit) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string &key : keys)
+            visit(key);
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::deque<std::string> keys;
+    std::unordered_map<std::string_view, const std::string *> index;
+    size_t keyBytes = 0;
+};
+
+extern KeyTable keyTable;
+
+// One row of the tree view.  Nodes are small, trivially destructible and
+// owned by a NodeTree: the children of a node form one contiguous block in
+// the tree's arena, created lazily by ensureChildren() the first time the
+// node is expanded or visited by a whole-tree operation.  Member names are
+// not copied (they point into the JSON object, or into the KeyTable for
+// members found by scanning the text) and array labels such as "[3]" are
+// computed from the node's position in its parent's block.
+// Nodes of line-delimited and indexed documents start out without a
+// value; nodeValue() parses them on first use, or leaves containers too
+// large to parse whole to be browsed through their byte spans.
+//
+// visibleCount is the number of rows the node's subtree occupies (the node
+// itself plus, when expanded, its children's counts).  It is kept current
+// by setExpanded() and the bulk expand/collapse helpers, which lets
+// VisibleRows map between row numbers and nodes without flattening the
+// tree.  Change `expanded` only through those functions.
 struct Node
 {
-    const json *value = nullptr;
+    mutable const json *value = nullptr;
     Node *parent = nullptr;
-    std::vector<std::unique_ptr<Node>> children;
-    std::string key;
-    bool expanded = false;
-    bool isDummyRoot = false;
-    bool isLastChild = false;
+    mutable Node *children = nullptr;
+    // Object member name or document label; null for array elements.
+    const std::string *name = nullptr;
+    mutable uint64_t visibleCount = 1;
+    mutable uint32_t childCount = 0;
+    bool expanded : 1 = false;
+    bool isDummyRoot : 1 = false;
+    bool isLastChild : 1 = false;
+    mutable bool childrenBuilt : 1 = false;
+};
+
+// Owner of every Node of one document.  Node blocks are carved out of a
+// monotonic arena and never freed individually, so tearing down even a
+// fully expanded tree is a handful of frees.
+class NodeTree
+{
+public:
+    // How a tree over raw input finds its values.  Lines: newline-delimited
+    // JSON (JSON Lines), where only the start of each non-blank line is
+    // recorded and the root's children are the lines.  Indexed: a single
+    // document whose containers are scanned for the byte ranges of their
+    // children, level by level as they are expanded; values small enough
+    // are parsed when first looked at.  Either way the input stays mapped
+    // for as long as the tree lives.
+    enum class Layout
+    {
+        Lines,
+        Indexed,
+    };
+
+    NodeTree(const json *doc, std::string label);
+    // savedIndex is what saveIndex() returned for the same input earlier;
+    // when it fits, the input is not scanned again.
+    NodeTree(InputBuffer input, std::string label, Layout layout, ParseProgress *progress = nullptr,
+             std::string_view savedIndex = {});
+    NodeTree(const NodeTree &) = delete;
+    NodeTree &operator=(const NodeTree &) = delete;
+
+    Node *root() const { return rootNode; }
+    const std::string &label() const { return rootLabel; }
+
+    bool isRecordList() const { return records; }
+    size_t recordCount() const { return recordStarts.size(); }
+    // Text of one record, without its line terminator.
+    std::string_view recordText(size_t index) const;
+    size_t recordOffset(size_t index) const { return recordStarts[index]; }
+    size_t recordLine(size_t index) const;
+    // Parse a record into storage owned by the tree.
+    const json *parseRecord(size_t index);
+    // Take over a longer copy of a line-delimited input that is being
+    // appended to and add the records written since.  A last line that
+    // was still unterminated is read again.  Existing nodes keep their
+    // expansion state; `moved` is set when the records' node block had to
+    // be reallocated, so pointers to records (not to their contents) went
+    // stale, and `released` when the nodes under the unterminated record
+    // were dropped, so pointers into it went stale.  No SearchJob may be
+    // reading the tree meanwhile.
+    size_t appendLines(InputBuffer grown, bool &moved, bool &released);
+
+    // Source text of line-delimited and indexed trees.
+    std::string_view text() const { return source.view(); }
+    // The line starts or top-level spans found by scanning the input, or
+    // nothing when the tree has none worth keeping.
+    std::string saveIndex() const;
+    bool restoredIndex() const { return restored; }
+    // Keep a value parsed from the text for the tree's life.
+    const json *adopt(json value);
+
+    // Blocks built from byte spans carry one ValueSpan per node.
+    Node *allocateBlock(size_t count, bool withSpans = false);
+    static NodeTree *owner(const Node *node);
+
+    // Memory budget support (--max-memory).  Once tracking is on, every
+    // value parsed from the text is remembered with the last frame it was
+    // shown in, so that evictCold() can drop the least recently used ones
+    // again; they are parsed anew when next needed.
+    void trackParsedValues() { tracking = true; }
+    // Estimated bytes of the values parsed from the text and of the node
+    // blocks in use.
+    size_t memoryUse() const { return parsedBytes + blockBytes; }
+    // Note that a node was shown in the given frame.
+    void touch(const Node *node, uint64_t frame);
+    // Called by nodeValue() when it has parsed textSize bytes for a node.
+    void noteParsed(const Node *node, size_t textSize);
+    // Drop parsed values of the trees, least recently shown first, until
+    // their memoryUse() adds up to at most `target`.  Only values shown
+    // before `frame` qualify, and only when their node is collapsed (or
+    // hidden under a collapsed ancestor) and nothing below it is a search
+    // match; the nodes built below them go too.  No SearchJob may be
+    // running.  Returns the number of bytes released.
+    static size_t evictCold(const std::vector<NodeTree *> &trees, size_t target, uint64_t frame,
+                            const SearchState &search);
+
+private:
+    struct ParsedValue
+    {
+        uint64_t lastUsed = 0;
+        size_t bytes = 0;
+    };
+
+    void release(Node *node);
+    void releaseChildren(Node *node);
+
+    void indexLines(ParseProgress *progress, size_t from = 0);
+    void indexDocument(ParseProgress *progress);
+    bool restoreIndex(std::string_view index);
+
+    std::pmr::monotonic_buffer_resource arena;
+    std::string rootLabel;
+    Node *rootNode = nullptr;
+    InputBuffer source;
+    std::vector<uint64_t> recordStarts;
+    std::deque<json> parsedValues;
+    // Slots of parsedValues and node blocks given back by evictCold(),
+    // reused before anything new is allocated.
+    std::vector<json *> freeValues;
+    std::map<std::pair<size_t, bool>, std::vector<Node *>> freeBlocks;
+    std::unordered_map<const Node *, ParsedValue> tracked;
+    size_t parsedBytes = 0;
+    size_t blockBytes = 0;
+    uint64_t lastFrame = 0;
+    bool tracking = false;
+    bool records = false;
+    bool restored = false;
+};
+
+// Row-number view over the visible nodes of several root trees, as shown
+// by the viewers.  Lookups in either direction cost O(depth · log(width))
+// thanks to the subtree counts on each node and per-block Fenwick trees
+// over wide child lists; nothing is rebuilt when the tree changes.
+class VisibleRows
+{
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    explicit VisibleRows(const std::vector<Node *> &roots) : roots(roots) {}
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    const Node *operator[](size_t row) const;
+    // Row of the node, or npos when one of its ancestors is collapsed.
+    size_t indexOf(const Node *node) const;
+
+private:
+    const std::vector<Node *> &roots;
+};
+
+// Expand-all and expand-to-level in steps.  Nodes are opened in document
+// order, depth first, and each step() stops once it has added about
+// rowBudget rows, so that a caller can show what there is and carry on
+// later.  Pending work holds expanded nodes only, which eviction leaves
+// alone, but collapsing one of them or appending lines to a tree makes
+// the expansion unsafe to continue.
+class Expansion
+{
+public:
+    static constexpr int unlimited = INT_MAX;
+
+    // With a maxLevel, nodes at that depth and below (roots are at depth
+    // 0) are collapsed, as expandToLevel() does; otherwise every branch is
+    // expanded.
+    explicit Expansion(std::vector<Node *> roots, int maxLevel = unlimited);
+
+    // Returns true once nothing is left to expand.
+    bool step(uint64_t rowBudget = UINT64_MAX);
+    bool done() const { return started && frames.empty() && nextRoot == roots.size(); }
+    // Rows added by all steps so far.
+    uint64_t rowsAdded() const { return added; }
+
+private:
+    // A node being expanded and the next of its children to look at.
+    struct Frame
+    {
+        Node *node;
+        size_t next;
+        int level;
+    };
+
+    void open(Node *node, int level);
+
+    std::vector<Node *> roots;
+    int maxLevel;
+    std::vector<Frame> frames;
+    size_t nextRoot = 0;
+    uint64_t added = 0;
+    bool started = false;
+};
+
+// How a node found by comparing two documents differs from the other one.
+enum class DiffChange : uint8_t
+{
+    Added,
+    Removed,
+    Changed,
+    // An array element equal to one elsewhere in the other array
+    Moved,
 };
 
 struct SearchState
 {
+    // What selected the matches: text in keys or values, a query (see
+    // Query) or the differences between two documents.
+    enum class Mode
+    {
+        Text,
+        Query,
+        Diff,
+    };
+
     std::string term;
     bool searchKeys = true;
     bool searchValues = false;
+    Mode mode = Mode::Text;
     std::vector<const Node *> matches;
     int currentIndex = 0;
+    // True while a SearchJob is still adding to matches.
+    bool inProgress = false;
+
+    // Lookup tables over `matches` so that drawing a row does not depend on
+    // the number of matches.  Append with addMatches() (or
+    // SearchJob::collect) and reset with clearMatches() to keep them current.
+    std::unordered_map<const Node *, size_t> matchPositions;
+    std::unordered_map<const Node *, size_t> rootMatchCounts;
+    // How each match of a diff differs.
+    std::unordered_map<const Node *, DiffChange> changes;
+
+    static constexpr size_t npos = SIZE_MAX;
+
+    void addMatches(std::span<const Node *const> found);
+    void clearMatches();
+    bool isMatch(const Node *node) const { return matchPositions.count(node) != 0; }
+    // Index of the node in `matches`, or npos.
+    size_t matchPosition(const Node *node) const;
+    // Number of matches below the given root node.
+    size_t matchCount(const Node *root) const;
+    // How a match of a diff differs, or null.
+    const DiffChange *change(const Node *node) const;
+};
+
+// Case-insensitive substring test against one precompiled needle, without
+// allocating.  ASCII text is folded and scanned 16 bytes at a time (SSE2 or
+// NEON, with a scalar fallback), filtering candidate positions on the
+// needle's first and last bytes.  Needles or haystacks containing other
+// UTF-8 characters take a slower path that compares towlower()-folded code
+// points, so "É" finds "é".
+class CaseInsensitiveMatcher
+{
+public:
+    explicit CaseInsensitiveMatcher(std::string_view needle = {});
+
+    bool matches(std::string_view haystack) const;
+    bool empty() const { return wide.empty(); }
+
+private:
+    bool findAscii(std::string_view haystack, bool &sawNonAscii) const;
+    bool findUnicode(std::string_view haystack) const;
+
+    std::string folded;  // ASCII-folded needle, used when it is pure ASCII
+    std::u32string wide; // folded code points of the needle
+    bool ascii = true;
+};
+
+// A compiled query in a subset of JSONPath.  $ is the document, .name or
+// ['name'] a member, [n] an element (negative n counts from the end), * or
+// [*] every child, ..name, ..* and ..[...] such children at any depth, and
+// [?(expr)] the children for which expr holds.  Filter expressions compare
+// paths relative to the child (@, @.a, @['a'], @[0]) and literals
+// (numbers, quoted strings, true, false, null) with == != < <= > >=, join
+// them with && || ! and parentheses; a path on its own tests that it
+// exists.  A node's progress through the steps is a bit mask, advanced
+// from parent to child, so evaluation only walks the branches that can
+// still lead to a match.
+class Query
+{
+public:
+    using State = uint64_t;
+
+    // False with a description of the first error.
+    bool compile(std::string_view text, std::string &error);
+
+    State initial() const { return 1; }
+    bool accepts(State state) const { return (state >> steps.size()) & 1; }
+    bool canDescend(State state) const { return (state & ((State(1) << steps.size()) - 1)) != 0; }
+    // State of a child, from its member name (null for elements), its
+    // index among `count` siblings and its value, which is only asked for
+    // by filters and may be null for values too large to parse.
+    template <class GetValue>
+    State advance(State state, const std::string *name, size_t index, size_t count, GetValue &&value) const;
+
+private:
+    // A path below @ in a filter: member names, or element indices when
+    // `name` is empty and isIndex is set.
+    struct PathItem
+    {
+        std::string name;
+        int64_t index = 0;
+        bool isIndex = false;
+    };
+    struct Operand
+    {
+        bool isPath = false;
+        std::vector<PathItem> path;
+        json literal;
+    };
+    struct Expr
+    {
+        enum class Op
+        {
+            Or,
+            And,
+            Not,
+            Exists,
+            Equal,
+            NotEqual,
+            Less,
+            LessEqual,
+            Greater,
+            GreaterEqual,
+        };
+        Op op;
+        // Sub-expressions of Or, And and Not
+        size_t left = 0;
+        size_t right = 0;
+        Operand a{};
+        Operand b{};
+    };
+    struct Step
+    {
+        enum class Kind
+        {
+            Name,
+            Index,
+            Wildcard,
+            Filter,
+        };
+        Kind kind;
+        // Also matches below the children, at any depth (..)
+        bool recursive = false;
+        std::string name;
+        int64_t index = 0;
+        size_t filter = 0;
+    };
+    class Parser;
+
+    bool matchesFilter(size_t expr, const json &value) const;
+
+    std::vector<Step> steps;
+    std::vector<Expr> exprs;
+};
+
+template <class GetValue>
+Query::State Query::advance(State state, const std::string *name, size_t index, size_t count, GetValue &&value) const
+{
+    State next = 0;
+    for (size_t k = 0; k < steps.size(); ++k)
+    {
+        if (!((state >> k) & 1))
+            continue;
+        const Step &step = steps[k];
+        if (step.recursive)
+            next |= State(1) << k;
+        bool hit = false;
+        switch (step.kind)
+        {
+        case Step::Kind::Name:
+            hit = name && *name == step.name;
+            break;
+        case Step::Kind::Index:
+            hit = !name && (step.index >= 0 ? index == static_cast<uint64_t>(step.index)
+                                            : count >= static_cast<uint64_t>(-step.index) &&
+                                                  index == count - static_cast<uint64_t>(-step.index));
+            break;
+        case Step::Kind::Wildcard:
+            hit = true;
+            break;
+        case Step::Kind::Filter:
+            if (const json *v = value())
+                hit = matchesFilter(step.filter, *v);
+            break;
+        }
+        if (hit)
+            next |= State(1) << (k + 1);
+    }
+    return next;
+}
+
+// Node at a JSON Pointer (RFC 6901) below a document's root, building the
+// nodes on the way.  Members are found by binary search over the sorted
+// names of their siblings, so a jump costs O(depth · log(width)) once the
+// blocks exist.  Null with a description when nothing is there.
+const Node *resolvePointer(const Node *root, std::string_view pointer, std::string &error);
+
+// Case-insensitive search below a set of start nodes, run on a pool of
+// worker threads.  Workers walk the read-only JSON values rather than the
+// node tree, each taking a slice of the documents; the owning thread turns
+// the results into nodes (building only the branches that lead to a match)
+// when it calls collect(), in document order.  Destroying the job or
+// calling cancel() stops the workers; matches collected so far stay valid.
+class SearchJob
+{
+public:
+    SearchJob(std::vector<const Node *> starts, const std::string &term, bool searchKeys,
+              bool searchValues, unsigned threads = 0);
+    // Nodes selected by a query, each start node being a document's $.
+    SearchJob(std::vector<const Node *> starts, Query query, unsigned threads = 0);
+    // Differences between two documents: members only one of them has and
+    // values that differ, each document's in document order, the left
+    // one's first.  See Diff.
+    SearchJob(const Node *left, const Node *right, unsigned threads = 0);
+    ~SearchJob();
+    SearchJob(const SearchJob &) = delete;
+    SearchJob &operator=(const SearchJob &) = delete;
+
+    // Append the matches of every slice finished since the last call to out.
+    // Returns true when anything was added.
+    bool collect(std::vector<const Node *> &out);
+    bool collect(SearchState &state);
+    // Block until every slice is finished or the job is cancelled.
+    void wait();
+    void cancel();
+    // True once all results were collected or the job was cancelled.
+    bool finished() const;
+    bool cancelled() const { return stop.load(std::memory_order_relaxed); }
+
+private:
+    // A node plus a range of its children, searched by one worker.  Paths
+    // are child indices from the start node.  The children of a
+    // line-delimited root are records, and those of an unparsed container
+    // are byte spans; either way the worker parses them itself.
+    struct Slice
+    {
+        size_t start = 0;
+        std::vector<uint32_t> path;
+        const json *value = nullptr;
+        const NodeTree *records = nullptr;
+        // Set instead of value for a container of an indexed document,
+        // whose children are built (on the owning thread) before searching.
+        std::string_view text;
+        const Node *spanChildren = nullptr;
+        const ValueSpan *childSpans = nullptr;
+        bool spanObject = false;
+        const std::string *name = nullptr;
+        size_t selfIndex = 0;
+        bool includeSelf = true;
+        size_t childBegin = 0;
+        size_t childEnd = 0;
+        // All children of the node, of which the slice may have a range
+        size_t childTotal = 0;
+        // Steps of a query the node has reached
+        Query::State state = 0;
+        // Matches as [length, index...] records relative to this slice's node.
+        std::vector<uint32_t> found;
+        // How each match differs, when diffing.
+        std::vector<DiffChange> changes;
+        std::atomic<bool> done{false};
+    };
+    class Diff;
+
+    void start(unsigned threads);
+    void run();
+    void searchSlice(Slice &slice);
+    void querySlice(Slice &slice);
+    void describe(Slice &slice, const Node *node) const;
+    void runDiff(unsigned threads);
+    bool collect(std::vector<const Node *> &out, std::vector<DiffChange> *changes);
+
+    std::vector<const Node *> starts;
+    CaseInsensitiveMatcher matcher;
+    bool searchKeys;
+    bool searchValues;
+    Query query;
+    bool querying = false;
+    std::unique_ptr<Diff> diff;
+    // Verdicts of the key search on every interned key, so that names of
+    // scanned members are matched once rather than once per node.
+    std::unordered_map<const std::string *, bool> internedMatches;
+    std::vector<std::unique_ptr<Slice>> slices;
+    std::atomic<size_t> nextSlice{0};
+    size_t nextToCollect = 0;
+    std::atomic<bool> stop{false};
+    // Set while the job's run time is still to be added to perfStats.
+    bool timed = false;
+    std::chrono::steady_clock::time_point started;
+    std::mutex mutex;
+    std::condition_variable sliceDone;
+    std::vector<std::thread> workers;
+};
+
+// Size and shape of a value and everything below it: how many values it
+// holds (itself included) of each type, how many levels they nest below
+// it, and how many bytes its compact serialization takes, written the way
+// copies are (NaN and Infinity as such).
+struct SubtreeStats
+{
+    enum Type
+    {
+        Null,
+        Boolean,
+        Number,
+        String,
+        Object,
+        Array,
+        TypeCount,
+    };
+
+    uint64_t values = 0;
+    uint64_t bytes = 0;
+    uint32_t depth = 0;
+    uint64_t types[TypeCount] = {};
+
+    uint64_t descendants() const { return values ? values - 1 : 0; }
+};
+
+// Figures counted so far.  Those of records of line-delimited trees are
+// kept by record, as the records' nodes move when lines are appended; the
+// others by node, which are only valid while the nodes are: drop them
+// when nodes are released (NodeTree::evictCold).
+struct SubtreeStatsCache
+{
+    std::unordered_map<const Node *, SubtreeStats> nodes;
+    // Figures with no values are not counted yet
+    std::unordered_map<const NodeTree *, std::vector<SubtreeStats>> records;
+
+    const SubtreeStats *find(const Node *node) const;
+    void store(const Node *node, const SubtreeStats &stats);
+    // Before lines are appended to a tree: drop its root's figures and
+    // those of its records from `first` on, with everything below them.
+    void forgetRecords(const NodeTree &tree, size_t first);
+    void clear()
+    {
+        nodes.clear();
+        records.clear();
+    }
+};
+
+// Counts the SubtreeStats of a node and of each of its children in the
+// background.  The children are split into ranges that worker threads
+// count straight from the values (or, for indexed documents, from the
+// text, scanning what is too large to parse), and the node's figures are
+// added up from theirs.  Children whose figures are in the cache already
+// are not counted again.  The trees must not change while it runs, so
+// callers hold off eviction and appending until finished().
+class StatsJob
+{
+public:
+    // One child of the node: its member name (null for elements) and figures.
+    struct Item
+    {
+        const std::string *name = nullptr;
+        SubtreeStats stats;
+    };
+
+    StatsJob(const Node *node, const SubtreeStatsCache &cache, unsigned threads = 0);
+    ~StatsJob();
+    StatsJob(const StatsJob &) = delete;
+    StatsJob &operator=(const StatsJob &) = delete;
+
+    const Node *node() const { return subject; }
+    bool finished() const;
+    // Fraction of the children counted, for progress.
+    double progress() const;
+    // Only valid once finished().
+    const SubtreeStats &total() const { return sum; }
+    const std::vector<Item> &items() const { return children; }
+    // Add the node's figures and those of its built children to the cache.
+    void store(SubtreeStatsCache &cache) const;
+    void cancel();
+
+private:
+    // Where a child's value is: parsed, a record of a line-delimited root,
+    // or a span of the document's text.
+    struct Source
+    {
+        const json *value = nullptr;
+        size_t record = SIZE_MAX;
+        ValueSpan span{};
+        bool known = false;
+    };
+
+    void run();
+    void countRange(size_t task);
+    void countValue(const json &v, SubtreeStats &stats, uint32_t level) const;
+    void countSpan(const ValueSpan &span, SubtreeStats &stats, uint32_t level) const;
+    void addUp();
+
+    const Node *subject;
+    const NodeTree *records = nullptr;
+    std::string_view text;
+    SubtreeStats::Type type = SubtreeStats::Null;
+    std::vector<Item> children;
+    std::vector<Source> sources;
+    SubtreeStats sum;
+    size_t width = 1;
+    size_t tasks = 0;
+    std::atomic<size_t> nextTask{0};
+    std::atomic<size_t> tasksDone{0};
+    std::atomic<size_t> itemsDone{0};
+    std::atomic<bool> complete{false};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+};
+
+// Byte position published by a parser as it consumes its input, so another
+// thread can show progress.  Setting *cancel makes the parser throw
+// ParseCancelled at its next update.
+struct ParseProgress
+{
+    std::atomic<size_t> consumed{0};
+    const std::atomic<bool> *cancel = nullptr;
+
+    void update(size_t position);
+};
+
+class ParseCancelled : public std::runtime_error
+{
+public:
+    ParseCancelled() : std::runtime_error("parsing cancelled") {}
+};
+
+// How DocumentLoader reads its inputs: as one JSON document each, as
+// newline-delimited records, as indexed documents parsed piece by piece,
+// or automatically: *.jsonl and *.ndjson files are line-delimited, and a
+// document whose DOM would not fit the memory budget is indexed.
+enum class InputFormat
+{
+    Auto,
+    Json,
+    Lines,
+    Indexed,
+};
+
+bool isLineDelimitedPath(const std::string &path);
+// What Auto means for a file of the given name and size: Lines for JSON
+// Lines files, Indexed when a DOM would not fit the memory budget (half of
+// physical memory when 0), Json otherwise.  Other formats are returned as is.
+InputFormat resolveFormat(InputFormat format, const std::string &path, size_t size, size_t memoryBudget = 0);
+// Build a line-delimited or indexed tree over a file, reusing the index
+// saved by an earlier run when the file is unchanged and saving a new one
+// otherwise.  Indexes live in $XDG_CACHE_HOME/json-view (or
+// ~/.cache/json-view), keyed by the file's absolute path, size and
+// modification time; setting JSON_VIEW_NO_INDEX_CACHE turns this off.
+std::unique_ptr<NodeTree> buildIndexedTree(InputBuffer input, const std::string &path, NodeTree::Layout layout,
+                                           ParseProgress *progress = nullptr);
+
+// Tells a viewer following a file when to look at it again.  It uses
+// inotify on Linux and kqueue on the BSDs and macOS; where neither is
+// available, or the watch cannot be set up, it falls back to comparing
+// the file's size and modification time on every call.
+class FileWatcher
+{
+public:
+    explicit FileWatcher(const std::string &path);
+    ~FileWatcher();
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    const std::string &path() const { return watchedPath; }
+    // True when the file may have changed since the last call.  Never
+    // blocks.
+    bool changed();
+
+private:
+    bool statChanged();
+
+    std::string watchedPath;
+    int fd = -1;
+    // The file itself, held open for kqueue.
+    int fileFd = -1;
+    int64_t lastSize = -1;
+    int64_t lastModified = -1;
+};
+
+// What the hot-path timers behind --stats measure.  Phases nest: values
+// are parsed while trees are built and rows are looked up while a frame is
+// drawn, so their times overlap rather than add up.
+enum class PerfPhase
+{
+    Read,
+    Parse,
+    SpecialNumbers,
+    BuildTree,
+    VisibleRows,
+    Search,
+    Draw,
+};
+
+enum class PerfCounter
+{
+    BytesRead,
+    NodesBuilt,
+    ValuesParsed,
+    SpecialNumbers,
+    SearchMatches,
+};
+
+// Timings and counters collected across the process for --stats and the
+// viewer's statistics overlay.  Nothing is recorded until enable() is
+// called; until then a PerfTimer or add() costs one relaxed load.  All
+// members may be used from any thread.
+class PerfStats
+{
+public:
+    static constexpr size_t phaseCount = static_cast<size_t>(PerfPhase::Draw) + 1;
+    static constexpr size_t counterCount = static_cast<size_t>(PerfCounter::SearchMatches) + 1;
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+    void enable() { on.store(true, std::memory_order_relaxed); }
+
+    void record(PerfPhase phase, std::chrono::steady_clock::duration elapsed);
+    void add(PerfCounter counter, uint64_t amount = 1)
+    {
+        if (enabled())
+            counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t calls(PerfPhase phase) const;
+    std::chrono::nanoseconds total(PerfPhase phase) const;
+    // Duration of the most recent call.
+    std::chrono::nanoseconds last(PerfPhase phase) const;
+    uint64_t count(PerfCounter counter) const;
+
+    // Table of every phase and counter plus the peak memory use, for --stats.
+    std::string summary() const;
+    // The figures worth watching while browsing, on one line.
+    std::string overlay() const;
+
+private:
+    struct Phase
+    {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> nanos{0};
+        std::atomic<uint64_t> lastNanos{0};
+    };
+
+    std::atomic<bool> on{false};
+    Phase phases[phaseCount];
+    std::atomic<uint64_t> counters[counterCount]{};
+};
+
+extern PerfStats perfStats;
+
+// Adds the time from its construction to stop() (or its destruction) to a
+// phase, if statistics were enabled when it was constructed.
+class PerfTimer
+{
+public:
+    explicit PerfTimer(PerfPhase phase) : phase(phase), active(perfStats.enabled())
+    {
+        if (active)
+            start = std::chrono::steady_clock::now();
+    }
+    ~PerfTimer() { stop(); }
+    PerfTimer(const PerfTimer &) = delete;
+    PerfTimer &operator=(const PerfTimer &) = delete;
+
+    void stop()
+    {
+        if (!active)
+            return;
+        perfStats.record(phase, std::chrono::steady_clock::now() - start);
+        active = false;
+    }
+
+private:
+    PerfPhase phase;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Peak resident memory of the process so far, in bytes.
+size_t peakMemoryUsage();
+
+// Result of loading one input.  `error` is empty on success; openFailed
+// tells an unreadable input apart from one that did not parse.  Empty
+// standard input yields neither a document nor an error.  Line-delimited
+// inputs always come with a tree and never with a DOM.
+struct LoadedDocument
+{
+    std::string label;
+    size_t size = 0;
+    std::unique_ptr<json> doc;
+    std::unique_ptr<NodeTree> tree;
+    std::string error;
+    bool openFailed = false;
+    // Set instead of doc and tree when the input was only validated.
+    bool valid = false;
+    // The input was gzip or zstd compressed.
+    bool compressed = false;
+
+    bool loaded() const { return doc || tree || valid; }
+};
+
+// Opens and parses a list of inputs on a pool of background threads while
+// the caller keeps running.  Finished documents are handed out strictly in
+// the order they were given, so the first file can be shown while later
+// ones are still loading.  The pool is limited to the number of cores, and
+// a file is only started while the estimated memory of documents being
+// built or waiting to be taken stays within the budget (half of physical
+// memory by default); a single file is always allowed to proceed.  An
+// empty path means standard input, labelled "(stdin)".  Line-delimited
+// inputs are only indexed.  gzip and zstd inputs are parsed while they
+// are decompressed, or decompressed to a temporary file first when they
+// are to be indexed.  When no trees are wanted (--validate) inputs are
+// just streamed through validateJson(), which needs one chunk of memory
+// each, so as many are checked at once as there are cores.  Destroying
+// the loader cancels work that is still running.
+class DocumentLoader
+{
+public:
+    DocumentLoader(std::vector<std::string> paths, bool buildTrees, InputFormat format = InputFormat::Auto,
+                   unsigned threads = 0, size_t memoryBudget = 0);
+    ~DocumentLoader();
+    DocumentLoader(const DocumentLoader &) = delete;
+    DocumentLoader &operator=(const DocumentLoader &) = delete;
+
+    // Documents that finished since the last call, in input order.
+    std::vector<LoadedDocument> takeFinished();
+    // Wait for the next document in order; false once all were taken.
+    bool waitNext(LoadedDocument &out);
+    // Wait up to `timeout` for the next document to become available.
+    bool waitReady(std::chrono::milliseconds timeout);
+    // True once every document has been handed out.
+    bool done() const;
+
+    size_t bytesConsumed() const;
+    size_t bytesTotal() const;
+    double secondsElapsed() const;
+    // Label of the first input still being loaded.
+    std::string currentLabel() const;
+    // Number of inputs that have not finished loading yet.
+    size_t pendingCount() const;
+
+private:
+    struct Job
+    {
+        std::string path;
+        std::string label;
+        std::atomic<size_t> total{0};
+        ParseProgress progress;
+        LoadedDocument result;
+        size_t reserved = 0;
+        bool lines = false;
+        bool indexed = false;
+        bool compressed = false;
+        bool finished = false;
+    };
+
+    void run();
+    void load(Job &job);
+    void loadLines(Job &job, InputBuffer input);
+    void validate(Job &job);
+    size_t memoryEstimate(const Job &job) const;
+    void releaseReservation(Job &job);
+
+    std::vector<std::unique_ptr<Job>> jobs;
+    size_t nextToStart = 0;
+    size_t nextToTake = 0;
+    size_t memoryBudget;
+    size_t memoryReserved = 0;
+    bool buildTrees;
+    mutable std::mutex mutex;
+    std::condition_variable jobFinished;
+    std::condition_variable budgetChanged;
+    std::atomic<bool> cancel{false};
+    std::chrono::steady_clock::time_point started;
+    std::vector<std::thread> workers;
+};
+
+// Pretty-printer behind --parse-only.  Output collects in a large buffer
+// that is written out with write(2) whenever it fills up, indentation is
+// copied from a precomputed run of spaces and strings are escaped in
+// place.  printText() formats a document straight from its text without
+// ever holding its whole DOM: containers too large to parse whole are
+// split with the structural scanner and everything else is parsed a piece
+// at a time.  Both print what json::dump(2) would, except that
+// NaN/Infinity literals are kept.
+class JsonPrinter
+{
+public:
+    // Receives each filled buffer; returning false stops the printing.
+    using Sink = std::function<bool(std::string_view)>;
+
+    explicit JsonPrinter(int fd = 1);
+    explicit JsonPrinter(Sink sink);
+    ~JsonPrinter();
+    JsonPrinter(const JsonPrinter &) = delete;
+    JsonPrinter &operator=(const JsonPrinter &) = delete;
+
+    void print(const json &j, int indent = 0);
+    // False with a description of the first syntax error.  Output of an
+    // invalid document is dropped as far as it was not written yet.  When
+    // text is part of a larger input (a record of a JSON Lines file), give
+    // that as `whole` so errors give positions in it.
+    bool printText(std::string_view text, std::string &error, std::string_view whole = {});
+    // Print the value of a node without copying it: parsed values as they
+    // are, containers of indexed documents from their text and
+    // line-delimited documents as an array of their records.  False with a
+    // reason when the text is malformed or the sink stopped the output.
+    bool printNode(const Node *node, std::string &error);
+    void write(std::string_view text);
+    void flush();
+
+private:
+    void printSpan(std::string_view text, const ValueSpan &span, int indent);
+    void printString(std::string_view text);
+    void newLine(int indent);
+
+    int fd = -1;
+    Sink sink;
+    std::string buffer;
+    size_t written = 0;
 };
 
 extern std::map<std::string, size_t> fileSizes;
 
-int getDisplayWidth(const std::string &str);
-std::unique_ptr<Node> buildTree(const json *j, const std::string &key, Node *parent, bool dummy);
+int getDisplayWidth(std::string_view str);
+std::unique_ptr<NodeTree> buildTree(const json *j, const std::string &label);
+const json *nodeValue(const Node *node);
+bool hasChildren(const Node *node);
+std::span<Node> ensureChildren(const Node *node);
+std::span<Node> builtChildren(const Node *node);
+size_t childIndex(const Node *node);
+std::string nodeKey(const Node *node);
 void collectVisible(const Node *node, std::vector<const Node *> &out);
 std::string buildPrefix(const Node *node);
 std::string shortenPath(const std::string &path, int maxWidth);
 std::string getTypeIcon(const Node *node);
+// Labels are cut to about maxWidth columns.  String values are escaped
+// and measured only as far as they are shown, so a row holding a huge
+// string costs no more than one holding a short one.
 std::string getContentLabel(const Node *node, int maxWidth = 80);
 std::string getContentLabelWithSearch(const Node *node, const SearchState &search, int maxWidth = 80);
+// Escaped text of a string value as labels show it, cut to maxWidth
+// display columns with "..." marking the cut.
+std::string labelText(std::string_view text, int maxWidth, bool *truncated = nullptr);
+// One line of a string value as the value pager shows it: at most `width`
+// columns from byte `from` on, ending early at a newline.  Returns where
+// the next line starts, text.size() after the last one.
+size_t pagerLine(std::string_view text, size_t from, int width, std::string &line);
+void setExpanded(Node *node, bool expanded);
 void expandAll(Node *node);
 void collapseAll(Node *node, bool keepRoot);
 void expandToLevel(Node *node, int targetLevel, int currentLevel = 0);
 void expandPath(Node *node);
 void searchTree(const Node *node, const std::string &term, bool searchKeys, bool searchValues, std::vector<const Node *> &out);
 bool osc52Likely();
+// Where copies go, in order of preference: nowhere when
+// JSON_VIEW_NO_CLIPBOARD is set, the file named by JSON_VIEW_CLIPBOARD_FILE,
+// wl-copy under Wayland, xclip or xsel under X11 and otherwise OSC 52 when
+// the terminal is likely to understand it.
+enum class ClipboardTarget
+{
+    None,
+    File,
+    WlCopy,
+    Xclip,
+    Xsel,
+    Osc52
+};
+ClipboardTarget clipboardTarget();
+// Why copying cannot work here (for ClipboardTarget::None).
 std::string getClipboardStatusMessage();
-void copyToClipboard(const std::string &text);
+// Serialize the value of a node into the clipboard as json::dump(2) would,
+// streaming it to the target without building a copy first.  `progress`
+// sees the number of bytes written so far.  Returns the message to show.
+std::string copyToClipboard(const Node *node, const std::function<void(size_t)> &progress = nullptr);
 json reconstructJson(const Node *node);
 std::string formatFileSize(size_t size);
 void printFormattedJson(const json &j, int indent = 0);
-json parseJsonWithSpecialNumbers(const std::string &contents);
+json parseJsonWithSpecialNumbers(std::string_view contents, ParseProgress *progress = nullptr);
+// Parse a gzip or zstd compressed document while another thread
+// decompresses it a chunk at a time, so its text is never held whole.
+// progress sees the number of compressed bytes consumed.
+json parseCompressedJson(std::string_view compressed, ParseProgress *progress = nullptr);
+// Check the JSON (or, with lines, JSON Lines) behind a descriptor without
+// building anything: it is read a chunk at a time and only the parser's
+// nesting state is kept, so memory use does not depend on the input.
+// gzip and zstd input is decompressed on the fly.  NaN/Infinity literals
+// are accepted.  On failure, error gives the line, column and byte offset
+// of the first problem.  progress->consumed ends up at the number of
+// bytes read.
+bool validateJson(int fd, bool lines, std::string &error, ParseProgress *progress = nullptr);
 
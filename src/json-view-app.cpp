@@ -10,7 +10,8 @@
 #define Uses_TMenuItem
 #define Uses_TDialog
 #define Uses_TFileDialog
-#define Uses_TOutline
+#define Uses_TOutlineViewer
+#define Uses_TDrawBuffer
 #define Uses_TScrollBar
 #define Uses_TRadioButtons
 #define Uses_TButton
@@ -23,145 +24,321 @@
 #define Uses_MsgBox
 #include <tvision/tv.h>
 
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 static constexpr const char *kDeveloperName = "Dr. C. Klukas";
 
-class JsonTNode : public TNode
+// Outline over the core tree itself.  TOutlineViewer only ever hands
+// node pointers back to the virtual functions below, so core nodes serve
+// as its TNode handles: nothing is allocated per node, children come
+// straight from ensureChildren() and labels are made when a row is drawn,
+// with a bounded cache of the most recent ones.
+class JsonOutline : public TOutlineViewer
 {
 public:
-    const Node *jsonNode;
-    JsonTNode *parent = nullptr;
-    JsonTNode(const Node *n, TStringView text, JsonTNode *children = nullptr,
-              JsonTNode *next = nullptr, Boolean exp = True)
-        : TNode(text, children, next, exp), jsonNode(n) {}
-};
+    JsonOutline(TRect r, TScrollBar *h, TScrollBar *v, Node *aRoot)
+        : TOutlineViewer(r, h, v), roots{aRoot}, rows(roots)
+    {
+        update();
+    }
 
-class JsonOutline : public TOutline
-{
-public:
-    JsonOutline(TRect r, TScrollBar *h, TScrollBar *v, JsonTNode *aRoot)
-        : TOutline(r, h, v, aRoot), root(aRoot) {}
+    static TNode *handle(const Node *node) { return reinterpret_cast<TNode *>(const_cast<Node *>(node)); }
+    static Node *node(TNode *handle) { return reinterpret_cast<Node *>(handle); }
+
+    virtual TNode *getRoot() override { return handle(roots[0]); }
+
+    virtual Boolean hasChildren(TNode *n) override { return ::hasChildren(node(n)) ? True : False; }
+
+    virtual Boolean isExpanded(TNode *n) override { return node(n)->expanded ? True : False; }
+
+    virtual int getNumChildren(TNode *n) override { return static_cast<int>(ensureChildren(node(n)).size()); }
 
-    JsonTNode *root;
+    virtual TNode *getChild(TNode *n, int i) override { return handle(&ensureChildren(node(n))[i]); }
 
-    JsonTNode *focusedNode()
+    virtual char *getText(TNode *n) override
     {
-        return static_cast<JsonTNode *>(getNode(foc));
+        auto it = labels.find(node(n));
+        if (it == labels.end())
+        {
+            if (labels.size() >= kLabelCacheLimit)
+                labels.clear();
+            it = labels.emplace(node(n), getContentLabel(node(n), kLabelWidth)).first;
+        }
+        return const_cast<char *>(it->second.c_str());
     }
 
-    void focusNode(JsonTNode *target)
+    virtual void adjust(TNode *n, Boolean expand) override { setExpanded(node(n), expand != False); }
+
+    // Rows are looked up and counted through VisibleRows rather than by
+    // walking every visible node as TOutlineViewer does.
+    virtual TNode *getNode(int i) override
     {
-        struct Finder
-        {
-            JsonTNode *target;
-            int index = 0;
-            int found = -1;
-        } finder{target};
+        return i >= 0 && static_cast<size_t>(i) < rows.size() ? handle(rows[i]) : nullptr;
+    }
 
-        forEach([](TOutlineViewer *, TNode *node, int, int pos, long, ushort, void *arg) -> Boolean
-                {
-            auto &f = *static_cast<Finder *>(arg);
-            if (node == f.target)
-            {
-                f.found = f.index;
-                return True;
-            }
-            ++f.index;
-            return False; }, &finder);
+    void update()
+    {
+        int count = static_cast<int>(std::min<size_t>(rows.size(), INT_MAX));
+        setLimit(std::max<int>(widest, size.x), count);
+        if (foc >= count)
+            foc = std::max(0, count - 1);
+    }
 
-        if (finder.found >= 0)
+    // TOutlineViewer::draw() walks the outline from the root down to the
+    // first row on screen; drawing only the rows in view keeps the cost
+    // tied to the window height rather than the scroll position.
+    virtual void draw() override
+    {
+        PerfTimer timer(PerfPhase::Draw);
+        TDrawBuffer buf;
+        for (int y = 0; y < size.y; ++y)
         {
-            foc = finder.found;
-            scrollTo(0, finder.found);
-            drawView();
-            focused(finder.found);
+            int row = delta.y + y;
+            Node *n = node(getNode(row));
+            TAttrPair color;
+            if (row == foc && (state & sfFocused))
+                color = getColor(0x0202);
+            else if (isSelected(row))
+                color = getColor(0x0303);
+            else
+                color = getColor(0x0401);
+            buf.moveChar(0, ' ', color, size.x);
+            if (n)
+            {
+                std::string text = graphFor(n);
+                if (::hasChildren(n) && !n->expanded)
+                    text += "~" + std::string(getText(handle(n))) + "~";
+                else
+                    text += getText(handle(n));
+                widest = std::max(widest, getDisplayWidth(text));
+                if (static_cast<size_t>(delta.x) < text.size())
+                    buf.moveCStr(0, text.c_str() + delta.x, color);
+            }
+            writeLine(0, y, size.x, 1, buf);
         }
+        // Rows are measured as they are drawn; let the horizontal scroll
+        // bar reach the widest one straight away.
+        if (widest > limit.x)
+            setLimit(widest, limit.y);
     }
 
+    // Expand every ancestor of a node so that it gets a row.
+    void reveal(const Node *target)
+    {
+        for (Node *p = target->parent; p; p = p->parent)
+            setExpanded(p, true);
+    }
+
+    const Node *focusedNode() { return node(getNode(foc)); }
+
+    void focusNode(const Node *target)
+    {
+        size_t row = rows.indexOf(target);
+        if (row == VisibleRows::npos)
+            return;
+        foc = static_cast<int>(row);
+        scrollTo(0, foc);
+        drawView();
+        focused(foc);
+    }
+
+    // Every mouse and key event of the outline is handled here: the
+    // TOutlineViewer versions walk the visible nodes to find the focused
+    // one and call its non-virtual update(), which walks them all again.
     virtual void handleEvent(TEvent &event) override
     {
-        if (event.what == evMouseDown && (event.mouse.buttons & mbLeftButton))
+        if (event.what == evMouseDown)
+        {
+            TScroller::handleEvent(event);
+            if (event.what == evMouseDown)
+                trackMouse(event);
+            return;
+        }
+        if (event.what != evKeyDown)
         {
-            int clickX = event.mouse.where.x;
-            TOutline::handleEvent(event);
-            JsonTNode *node = focusedNode();
-            if (node)
+            TOutlineViewer::handleEvent(event);
+            return;
+        }
+        const Node *n = focusedNode();
+        int newFocus = foc;
+        switch (ctrlToArrow(event.keyDown.keyCode))
+        {
+        case kbUp:
+            --newFocus;
+            break;
+        case kbDown:
+            ++newFocus;
+            break;
+        case kbPgUp:
+            newFocus -= size.y - 1;
+            break;
+        case kbPgDn:
+            newFocus += size.y - 1;
+            break;
+        case kbCtrlPgUp:
+            newFocus = 0;
+            break;
+        case kbCtrlPgDn:
+            newFocus = limit.y - 1;
+            break;
+        case kbLeft:
+            if (n)
             {
-                int depth = 0;
-                for (const Node *p = node->jsonNode; p && p->parent; p = p->parent)
-                    ++depth;
-                int prefixWidth = depth * 2 + 2;
-                if (clickX < prefixWidth)
+                if (n->expanded && ::hasChildren(n))
+                    toggle(n, false);
+                else if (n->parent)
+                    newFocus = static_cast<int>(rows.indexOf(n->parent));
+            }
+            break;
+        case kbRight:
+            if (n)
+            {
+                if (!n->expanded && ::hasChildren(n))
+                    toggle(n, true);
+                else if (::hasChildren(n))
+                    ++newFocus;
+            }
+            break;
+        case kbHome:
+            newFocus = 0;
+            break;
+        case kbEnd:
+            newFocus = limit.y - 1;
+            break;
+        case kbEnter:
+        case kbCtrlEnter:
+            selected(foc);
+            break;
+        default:
+            switch (event.keyDown.charScan.charCode)
+            {
+            case '+':
+            case '-':
+                if (n && ::hasChildren(n))
+                    toggle(n, event.keyDown.charScan.charCode == '+');
+                break;
+            case '*':
+                if (n)
                 {
-                    node->expanded = node->expanded ? False : True;
-                    const_cast<Node *>(node->jsonNode)->expanded = node->expanded;
+                    ::expandAll(const_cast<Node *>(n));
                     update();
-                    drawView();
                 }
+                break;
+            default:
+                return;
             }
         }
-        else if (event.what == evKeyDown)
+        clearEvent(event);
+        moveFocus(newFocus);
+        drawView();
+    }
+
+private:
+    static constexpr size_t kLabelCacheLimit = 4096;
+    // Auto-repeat events outside the view between steps of the focus
+    static constexpr int kMouseAutoToSkip = 3;
+
+    void toggle(const Node *n, bool expand)
+    {
+        setExpanded(const_cast<Node *>(n), expand);
+        update();
+    }
+
+    // Focus a row and scroll it into view, as TOutlineViewer does.
+    void moveFocus(int row)
+    {
+        row = std::max(0, std::min(row, limit.y - 1));
+        if (row != foc)
+            focused(row);
+        if (row < delta.y)
+            scrollTo(delta.x, row);
+        else if (row - size.y >= delta.y)
+            scrollTo(delta.x, row - size.y + 1);
+    }
+
+    // Follow the mouse while a button is held.  A double click selects
+    // the row and a plain click on its graph opens or closes it.
+    void trackMouse(TEvent &event)
+    {
+        int newFocus = foc;
+        int autoCount = 0;
+        int dragged = 0;
+        TPoint mouse;
+        do
         {
-            JsonTNode *node = focusedNode();
-            switch (event.keyDown.keyCode)
+            if (dragged < 2)
+                ++dragged;
+            mouse = makeLocal(event.mouse.where);
+            if (mouseInView(event.mouse.where))
+                newFocus = delta.y + mouse.y;
+            else if (event.what == evMouseAuto && ++autoCount == kMouseAutoToSkip)
             {
-            case kbLeft:
-                if (node)
-                {
-                    if (node->expanded && node->childList)
-                    {
-                        node->expanded = False;
-                        const_cast<Node *>(node->jsonNode)->expanded = false;
-                        update();
-                        drawView();
-                    }
-                    else if (node->parent)
-                        focusNode(node->parent);
-                }
-                clearEvent(event);
-                break;
-            case kbRight:
-                if (node)
-                {
-                    if (!node->expanded && node->childList)
-                    {
-                        node->expanded = True;
-                        const_cast<Node *>(node->jsonNode)->expanded = true;
-                        update();
-                        drawView();
-                    }
-                    else if (node->childList)
-                        focusNode(static_cast<JsonTNode *>(node->childList));
-                }
-                clearEvent(event);
-                break;
-            case kbHome:
-                focusNode(static_cast<JsonTNode *>(getNode(0)));
-                clearEvent(event);
-                break;
-            case kbEnd:
+                autoCount = 0;
+                newFocus += mouse.y < 0 ? -1 : mouse.y >= size.y ? 1 : 0;
+            }
+            if (newFocus != foc)
             {
-                JsonTNode *last = nullptr;
-                forEach([](TOutlineViewer *, TNode *n, int, int, long, ushort, void *arg) -> Boolean
-                        {
-                    *static_cast<JsonTNode **>(arg) = static_cast<JsonTNode *>(n);
-                    return False; }, &last);
-                if (last)
-                    focusNode(last);
-                clearEvent(event);
-                break;
+                moveFocus(newFocus);
+                drawView();
             }
-            default:
-                TOutline::handleEvent(event);
+        } while (!(event.mouse.eventFlags & meDoubleClick) && mouseEvent(event, evMouseMove | evMouseAuto));
+
+        if (event.mouse.eventFlags & meDoubleClick)
+            selected(foc);
+        else if (dragged < 2)
+        {
+            const Node *n = focusedNode();
+            if (n && ::hasChildren(n) && mouse.x + delta.x < getDisplayWidth(graphFor(n)))
+            {
+                toggle(n, !n->expanded);
+                drawView();
             }
         }
-        else
-            TOutline::handleEvent(event);
+        clearEvent(event);
+    }
+    // Labels are cut to this many columns; the outline scrolls sideways.
+    static constexpr int kLabelWidth = 512;
+
+    // Tree graph for a row, built from the same level/lines/flags that
+    // TOutlineViewer would pass while walking to it.
+    std::string graphFor(const Node *n)
+    {
+        int level = depth(n);
+        long lines = 0;
+        int l = level - 1;
+        for (const Node *p = n->parent; p && p->parent; p = p->parent, --l)
+            if (!p->isLastChild && l < static_cast<int>(sizeof(long) * CHAR_BIT))
+                lines |= 1L << l;
+        ushort flags = 0;
+        if (n->isLastChild || !n->parent)
+            flags |= ovLast;
+        if (::hasChildren(n))
+            flags |= ovChildren;
+        if (n->expanded)
+            flags |= ovExpanded;
+        char *graph = getGraph(level, lines, flags);
+        std::string result = graph ? graph : "";
+        delete[] graph;
+        return result;
     }
+
+    static int depth(const Node *n)
+    {
+        int d = 0;
+        for (const Node *p = n; p && p->parent; p = p->parent)
+            ++d;
+        return d;
+    }
+
+    std::vector<Node *> roots;
+    VisibleRows rows;
+    std::unordered_map<const Node *, std::string> labels;
+    int widest = 0;
 };
 
 class JsonViewApp : public TApplication
@@ -176,10 +353,13 @@ public:
 
 private:
     bool loadFile(const std::string &name);
-    std::unique_ptr<Node> root;
-    std::unordered_map<const Node *, JsonTNode *> nodeMap;
+    json doc;
+    std::unique_ptr<NodeTree> tree;
+    Node *root = nullptr;
     JsonOutline *outline = nullptr;
     SearchState search;
+    // Running search, polled from idle() until it has finished.
+    std::unique_ptr<SearchJob> searchJob;
 
     void openFile();
     void closeFile();
@@ -215,7 +395,7 @@ public:
     {
         disposeItems(items);
         TStatusItem *chain = nullptr;
-        if (s.matches.empty())
+        if (s.matches.empty() && !s.inProgress)
         {
             auto *i1 = new TStatusItem("~F2~ Open", kbF2, cmOpen);
             auto *i2 = new TStatusItem("~F3~ Find", kbF3, cmFind);
@@ -227,8 +407,10 @@ public:
         else
         {
             std::string info = "search '" + s.term + "' " +
-                               std::to_string(s.currentIndex + 1) + "/" +
+                               std::to_string(s.matches.empty() ? 0 : s.currentIndex + 1) + "/" +
                                std::to_string(s.matches.size());
+            if (s.inProgress)
+                info += " searching";
             auto *i1 = new TStatusItem(info.c_str(), kbNoKey, 0);
             auto *i2 = new TStatusItem("~F3~ Next", kbF3, cmFindNext);
             auto *i3 = new TStatusItem("~Shift-F3~ Prev", kbShiftF3, cmFindPrev);
@@ -255,21 +437,15 @@ private:
     }
 };
 
-static void syncExpanded(JsonTNode *n)
-{
-    if (!n)
-        return;
-    n->expanded = n->jsonNode->expanded ? True : False;
-    for (JsonTNode *c = static_cast<JsonTNode *>(n->childList); c; c = static_cast<JsonTNode *>(c->next))
-        syncExpanded(c);
-}
-
 JsonViewApp::JsonViewApp(int argc, char **argv)
     : TProgInit(&JsonViewApp::initStatusLine, &JsonViewApp::initMenuBar, &TApplication::initDeskTop),
       TApplication()
 {
     for (int i = 1; i < argc; ++i)
-        loadFile(argv[i]);
+    {
+        if (std::string(argv[i]) != "--stats")
+            loadFile(argv[i]);
+    }
 }
 
 void JsonViewApp::handleEvent(TEvent &event)
@@ -283,12 +459,21 @@ void JsonViewApp::handleEvent(TEvent &event)
             if (root)
             {
                 int level = event.keyDown.keyCode - '0';
-                expandToLevel(root.get(), level, 0);
+                expandToLevel(root, level, 0);
                 syncOutlineExpansion();
             }
             clearEvent(event);
             return;
         }
+        if (event.keyDown.keyCode == kbEsc && searchJob)
+        {
+            // Stop the running search but keep what it found so far
+            searchJob.reset();
+            search.inProgress = false;
+            updateStatusBar();
+            clearEvent(event);
+            return;
+        }
         if (event.keyDown.keyCode == kbEsc && !search.matches.empty())
         {
             search = SearchState();
@@ -322,12 +507,16 @@ void JsonViewApp::handleEvent(TEvent &event)
             if (!search.matches.empty())
             {
                 search.currentIndex = (search.currentIndex - 1 + search.matches.size()) % search.matches.size();
-                outline->focusNode(nodeMap[search.matches[search.currentIndex]]);
+                const Node *target = search.matches[search.currentIndex];
+                outline->reveal(target);
+                outline->update();
+                outline->focusNode(target);
                 updateStatusBar();
             }
             break;
         case cmEndSearch:
-            if (!search.matches.empty())
+            searchJob.reset();
+            if (!search.matches.empty() || search.inProgress)
             {
                 search = SearchState();
                 updateStatusBar();
@@ -348,7 +537,7 @@ void JsonViewApp::handleEvent(TEvent &event)
             if (root)
             {
                 int level = event.message.command - cmLevel0;
-                expandToLevel(root.get(), level, 0);
+                expandToLevel(root, level, 0);
                 syncOutlineExpansion();
             }
             break;
@@ -369,6 +558,29 @@ void JsonViewApp::handleEvent(TEvent &event)
 void JsonViewApp::idle()
 {
     TApplication::idle();
+    if (!searchJob)
+        return;
+    bool first = search.matches.empty();
+    bool added = searchJob->collect(search);
+    if (added && first)
+    {
+        outline->reveal(search.matches[0]);
+        outline->update();
+        outline->focusNode(search.matches[0]);
+    }
+    if (searchJob->finished())
+    {
+        searchJob.reset();
+        search.inProgress = false;
+        updateStatusBar();
+        if (search.matches.empty())
+            messageBox("No matches", mfOKButton);
+    }
+    else if (added)
+    {
+        updateStatusBar();
+        outline->drawView();
+    }
 }
 
 void JsonViewApp::openFile()
@@ -382,18 +594,44 @@ void JsonViewApp::openFile()
 
 bool JsonViewApp::loadFile(const std::string &name)
 {
-    std::ifstream in(name);
-    if (!in)
+    InputBuffer input;
+    std::string openError;
+    if (!input.openFile(name, openError) || !input.decompress(openError))
     {
         messageBox("Could not open file", mfError | mfOKButton);
         return false;
     }
-    std::ostringstream ss;
-    ss << in.rdbuf();
-    json j = parseJsonWithSpecialNumbers(ss.str());
+    size_t size = input.size();
+    // JSON Lines files and documents too large for memory are only indexed
+    // here, reusing a saved index when there is one; parts parse as shown
+    std::unique_ptr<NodeTree> indexedTree;
+    json parsed;
+    try
+    {
+        InputFormat format = resolveFormat(InputFormat::Auto, name, size);
+        if (format == InputFormat::Lines)
+            indexedTree = buildIndexedTree(std::move(input), name, NodeTree::Layout::Lines);
+        else if (format == InputFormat::Indexed)
+            indexedTree = buildIndexedTree(std::move(input), name, NodeTree::Layout::Indexed);
+        else
+            parsed = parseJsonWithSpecialNumbers(input.view());
+    }
+    catch (const std::exception &ex)
+    {
+        messageBox(ex.what(), mfError | mfOKButton);
+        return false;
+    }
     fileSizes.clear();
-    fileSizes[name] = ss.str().size();
-    root = buildTree(&j, name, nullptr, true);
+    fileSizes[name] = size;
+    input.release();
+    // The tree points into the document, so drop the old tree before the
+    // document it refers to is replaced.
+    searchJob.reset();
+    root = nullptr;
+    tree.reset();
+    doc = std::move(parsed);
+    tree = indexedTree ? std::move(indexedTree) : buildTree(&doc, name);
+    root = tree->root();
     search = SearchState();
     rebuildOutline();
     updateStatusBar();
@@ -407,15 +645,16 @@ void JsonViewApp::closeFile()
         deskTop->remove(outline->owner);
         outline = nullptr;
     }
-    root.reset();
-    nodeMap.clear();
+    searchJob.reset();
+    root = nullptr;
+    tree.reset();
+    doc = json();
     search = SearchState();
     updateStatusBar();
 }
 
 void JsonViewApp::rebuildOutline()
 {
-    nodeMap.clear();
     if (outline)
     {
         deskTop->remove(outline->owner);
@@ -424,38 +663,9 @@ void JsonViewApp::rebuildOutline()
     if (!root)
         return;
 
-    struct Builder
-    {
-        std::unordered_map<const Node *, JsonTNode *> &map;
-        JsonTNode *operator()(const Node *n)
-        {
-            JsonTNode *firstChild = nullptr;
-            JsonTNode *prev = nullptr;
-            std::vector<JsonTNode *> createdChildren;
-            for (const auto &c : n->children)
-            {
-                JsonTNode *child = (*this)(c.get());
-                createdChildren.push_back(child);
-                if (!firstChild)
-                    firstChild = child;
-                else
-                    prev->next = child;
-                prev = child;
-            }
-            std::string label = getContentLabel(n);
-            auto node = new JsonTNode(n, label, firstChild, nullptr, n->expanded ? True : False);
-            for (auto *child : createdChildren)
-                child->parent = node;
-            map[n] = node;
-            return node;
-        }
-    } builder{nodeMap};
-
-    JsonTNode *tvRoot = builder(root.get());
-
     TRect r = deskTop->getExtent();
     r.grow(-2, -2);
-    std::string title = root->key;
+    std::string title = tree->label();
     size_t pos = title.find_last_of("/\\");
     if (pos != std::string::npos)
         title = title.substr(pos + 1);
@@ -468,7 +678,7 @@ void JsonViewApp::rebuildOutline()
     sbH->growMode = gfGrowHiX;
     auto *sbV = new TScrollBar(TRect(c.b.x - 1, 1, c.b.x, c.b.y - 1));
     sbV->growMode = gfGrowHiY;
-    auto *view = new JsonOutline(TRect(1, 1, c.b.x - 1, c.b.y - 1), sbH, sbV, tvRoot);
+    auto *view = new JsonOutline(TRect(1, 1, c.b.x - 1, c.b.y - 1), sbH, sbV, root);
     view->growMode = gfGrowHiX | gfGrowHiY;
     win->insert(sbH);
     win->insert(sbV);
@@ -484,7 +694,6 @@ void JsonViewApp::syncOutlineExpansion()
 {
     if (!outline)
         return;
-    syncExpanded(outline->root);
     outline->update();
     outline->drawView();
 }
@@ -519,36 +728,36 @@ void JsonViewApp::doSearch(bool newTerm)
         d->insert(new TButton(TRect(21, 9, 31, 11), "Cancel", cmCancel, bfNormal));
         if (executeDialog(d, &data) != cmCancel)
         {
-            search.matches.clear();
+            // Matches arrive in idle(), which also reveals the first one.
+            searchJob.reset();
+            search.clearMatches();
             search.term = data.term;
             search.searchKeys = (data.mode != 1);
             search.searchValues = (data.mode != 0);
-            searchTree(root.get(), search.term, search.searchKeys, search.searchValues, search.matches);
             search.currentIndex = 0;
+            search.inProgress = !search.term.empty();
+            if (search.inProgress)
+                searchJob = std::make_unique<SearchJob>(std::vector<const Node *>{root}, search.term,
+                                                        search.searchKeys, search.searchValues);
+            else
+                messageBox("No matches", mfOKButton);
+            updateStatusBar();
         }
-        else
-            return;
+        return;
     }
     if (search.matches.empty())
     {
+        if (search.inProgress)
+            return;
         messageBox("No matches", mfOKButton);
         updateStatusBar();
         return;
     }
     const Node *n = search.matches[search.currentIndex];
-    for (const Node *p = n; p; p = p->parent)
-    {
-        auto it = nodeMap.find(p);
-        if (it != nodeMap.end())
-        {
-            it->second->expanded = True;
-            const_cast<Node *>(p)->expanded = true;
-        }
-    }
+    outline->reveal(n);
     outline->update();
-    outline->focusNode(nodeMap[n]);
-    if (!newTerm)
-        search.currentIndex = (search.currentIndex + 1) % search.matches.size();
+    outline->focusNode(n);
+    search.currentIndex = (search.currentIndex + 1) % search.matches.size();
     updateStatusBar();
 }
 
@@ -556,12 +765,10 @@ void JsonViewApp::copySelection()
 {
     if (!outline)
         return;
-    JsonTNode *n = outline->focusedNode();
+    const Node *n = outline->focusedNode();
     if (!n)
         return;
-    json j = reconstructJson(n->jsonNode);
-    copyToClipboard(j.dump());
-    messageBox(getClipboardStatusMessage().c_str(), mfOKButton);
+    messageBox(copyToClipboard(n).c_str(), mfOKButton);
 }
 
 TMenuBar *JsonViewApp::initMenuBar(TRect r)
@@ -603,7 +810,17 @@ TStatusLine *JsonViewApp::initStatusLine(TRect r)
 
 int main(int argc, char **argv)
 {
-    JsonViewApp app(argc, argv);
-    app.run();
+    // --stats prints timings and memory use once the screen is restored
+    bool showStats = false;
+    for (int i = 1; i < argc; ++i)
+        showStats = showStats || std::string(argv[i]) == "--stats";
+    if (showStats)
+        perfStats.enable();
+    {
+        JsonViewApp app(argc, argv);
+        app.run();
+    }
+    if (showStats)
+        fputs(perfStats.summary().c_str(), stderr);
     return 0;
 }
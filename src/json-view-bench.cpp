@@ -0,0 +1,554 @@
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json_view_core.hpp"
+
+// Benchmarks of the core over generated documents.  Every (shape, size)
+// case runs in a child process of its own so that its peak RSS is not
+// inflated by the cases before it; each prints one JSON object per line
+// (JSON Lines) so results can be collected and compared across releases.
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const char *kShapes[] = {"deep", "wide", "strings", "numbers"};
+constexpr const char *kNeedle = "needle";
+// Rows drawn per simulated screen, and screens sampled for the scroll cost.
+constexpr size_t kPageRows = 50;
+constexpr size_t kScrollPages = 200;
+constexpr int kLabelWidth = 80;
+
+double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Peak resident set size of this process so far, in bytes.
+size_t peakRss()
+{
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+// "64M", "1G", "512k" or a plain byte count.
+bool parseSize(const std::string &text, size_t &size)
+{
+    char *end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || value <= 0)
+        return false;
+    switch (*end)
+    {
+    case 'k': case 'K': value *= 1024.0; ++end; break;
+    case 'm': case 'M': value *= 1024.0 * 1024.0; ++end; break;
+    case 'g': case 'G': value *= 1024.0 * 1024.0 * 1024.0; ++end; break;
+    default: break;
+    }
+    if (*end != '\0')
+        return false;
+    size = static_cast<size_t>(value);
+    return true;
+}
+
+std::vector<std::string> splitList(const std::string &text)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos)
+            comma = text.size();
+        if (comma > start)
+            items.push_back(text.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+// Buffered writer for the generators; documents of several gigabytes are
+// streamed to disk rather than built in memory.
+class Output
+{
+public:
+    explicit Output(FILE *file) : file(file) { buffer.reserve(1 << 20); }
+    ~Output() { flush(); }
+
+    void put(std::string_view text)
+    {
+        buffer.append(text);
+        written += text.size();
+        if (buffer.size() >= (1 << 20))
+            flush();
+    }
+    void number(uint64_t value) { put(std::to_string(value)); }
+    void flush()
+    {
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+    size_t size() const { return written; }
+
+private:
+    FILE *file;
+    std::string buffer;
+    size_t written = 0;
+};
+
+// Small deterministic generator, so every run sees the same documents.
+struct Random
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+    uint64_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+    uint64_t below(uint64_t limit) { return next() % limit; }
+};
+
+// An array of chains of nested objects, 64 levels each.
+void generateDeep(Output &out, size_t target)
+{
+    out.put("[\n");
+    for (uint64_t item = 0; out.size() < target; ++item)
+    {
+        if (item)
+            out.put(",\n");
+        for (int level = 0; level < 64; ++level)
+        {
+            out.put("{\"level\": ");
+            out.number(level);
+            out.put(item % 1000 == 0 && level == 63 ? ", \"name\": \"needle\", \"next\": " : ", \"name\": \"node\", \"next\": ");
+        }
+        out.put("null");
+        for (int level = 0; level < 64; ++level)
+            out.put("}");
+    }
+    out.put("\n]\n");
+}
+
+// One object with a very large number of members.
+void generateWide(Output &out, size_t target)
+{
+    Random random;
+    char key[32];
+    out.put("{\n");
+    for (uint64_t item = 0; out.size() < target; ++item)
+    {
+        if (item)
+            out.put(",\n");
+        snprintf(key, sizeof(key), "  \"%s%010llu\": ", item % 1000 == 0 ? kNeedle : "key",
+                 static_cast<unsigned long long>(item));
+        out.put(key);
+        switch (item % 4)
+        {
+        case 0: out.number(random.below(1000000)); break;
+        case 1: out.put("\"value\""); break;
+        case 2: out.put(item % 8 == 2 ? "true" : "false"); break;
+        default: out.put("null"); break;
+        }
+    }
+    out.put("\n}\n");
+}
+
+// An array of long strings with escapes and non-ASCII characters.
+void generateStrings(Output &out, size_t target)
+{
+    static constexpr std::string_view words[] = {"lorem", "ipsum", "dolor", "sit", "amet", "caf\\u00e9",
+                                                 "na\xc3\xafve", "line\\nbreak", "\\\"quoted\\\"", "tab\\there"};
+    Random random;
+    out.put("[\n");
+    for (uint64_t item = 0; out.size() < target; ++item)
+    {
+        if (item)
+            out.put(",\n");
+        out.put("  \"");
+        size_t count = 8 + random.below(64);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i)
+                out.put(" ");
+            out.put(item % 1000 == 0 && i == count / 2 ? std::string_view(kNeedle)
+                                                       : words[random.below(std::size(words))]);
+        }
+        out.put("\"");
+    }
+    out.put("\n]\n");
+}
+
+// An array of rows of integers and floating-point numbers.
+void generateNumbers(Output &out, size_t target)
+{
+    Random random;
+    char number[48];
+    out.put("[\n");
+    for (uint64_t item = 0; out.size() < target; ++item)
+    {
+        out.put(item ? ",\n  [" : "  [");
+        for (int i = 0; i < 16; ++i)
+        {
+            if (i)
+                out.put(", ");
+            uint64_t bits = random.next();
+            if (i % 2)
+                snprintf(number, sizeof(number), "%.17g",
+                         static_cast<double>(bits >> 11) * 0x1.0p-53 * ((bits & 1) ? -1e6 : 1e-6));
+            else
+                snprintf(number, sizeof(number), "%lld", static_cast<long long>(bits >> 20) - (1LL << 43));
+            out.put(number);
+        }
+        out.put("]");
+    }
+    out.put("\n]\n");
+}
+
+bool generate(const std::string &shape, size_t target, const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    {
+        Output out(file);
+        if (shape == "deep")
+            generateDeep(out, target);
+        else if (shape == "wide")
+            generateWide(out, target);
+        else if (shape == "strings")
+            generateStrings(out, target);
+        else
+            generateNumbers(out, target);
+    }
+    return fclose(file) == 0;
+}
+
+// What drawing one row costs a viewer: its tree prefix, icon and label.
+size_t drawRows(const VisibleRows &rows, size_t first, size_t count, const SearchState &search)
+{
+    size_t bytes = 0;
+    for (size_t row = first; row < first + count && row < rows.size(); ++row)
+    {
+        const Node *node = rows[row];
+        bytes += buildPrefix(node).size() + getTypeIcon(node).size() +
+                 getContentLabelWithSearch(node, search, kLabelWidth).size();
+    }
+    return bytes;
+}
+
+json runCase(const std::string &shape, const std::string &path)
+{
+    json result;
+    result["shape"] = shape;
+    size_t size = std::filesystem::file_size(path);
+    result["bytes"] = size;
+    InputFormat format = resolveFormat(InputFormat::Auto, path, size);
+    result["format"] = format == InputFormat::Indexed ? "indexed" : "json";
+
+    // Pretty-printing, as done by --parse-only.
+    {
+        InputBuffer input;
+        std::string error;
+        if (!input.openFile(path, error) || !input.decompress(error))
+            throw std::runtime_error(error);
+        int devNull = open("/dev/null", O_WRONLY);
+        auto start = Clock::now();
+        {
+            JsonPrinter printer(devNull);
+            if (!printer.printText(input.view(), error))
+                throw std::runtime_error(error);
+        }
+        result["print_s"] = secondsSince(start);
+        close(devNull);
+    }
+
+    // The parts of a DOM load, timed on their own.
+    if (format == InputFormat::Json)
+    {
+        InputBuffer input;
+        std::string error;
+        if (!input.openFile(path, error) || !input.decompress(error))
+            throw std::runtime_error(error);
+        auto start = Clock::now();
+        auto doc = std::make_unique<json>(parseJsonWithSpecialNumbers(input.view()));
+        result["parse_s"] = secondsSince(start);
+        start = Clock::now();
+        auto tree = buildTree(doc.get(), path);
+        result["build_tree_s"] = secondsSince(start);
+    }
+
+    // Load as the viewers do, up to the first screen of rows.
+    auto start = Clock::now();
+    DocumentLoader loader({path}, true, format);
+    LoadedDocument loaded;
+    if (!loader.waitNext(loaded) || !loaded.error.empty())
+        throw std::runtime_error(loaded.error.empty() ? "no document" : loaded.error);
+    result["load_s"] = secondsSince(start);
+    std::vector<Node *> roots{loaded.tree->root()};
+    roots.back()->isLastChild = true;
+    setExpanded(roots.back(), true);
+    VisibleRows rows(roots);
+    SearchState search;
+    drawRows(rows, 0, kPageRows, search);
+    result["first_frame_s"] = secondsSince(start);
+
+    // Search keys and values, as after "s" in the viewer.
+    {
+        start = Clock::now();
+        SearchJob job({roots.back()}, kNeedle, true, true);
+        double first = -1;
+        while (!job.finished())
+        {
+            if (job.collect(search) && first < 0)
+                first = secondsSince(start);
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        result["search_first_s"] = first;
+        result["search_s"] = secondsSince(start);
+        result["matches"] = search.matches.size();
+    }
+
+    start = Clock::now();
+    expandAll(roots.back());
+    result["expand_all_s"] = secondsSince(start);
+
+    {
+        std::vector<const Node *> visible;
+        start = Clock::now();
+        collectVisible(roots.back(), visible);
+        result["collect_visible_s"] = secondsSince(start);
+        result["visible_rows"] = visible.size();
+    }
+
+    // Redraw a screen at offsets spread over the fully expanded tree.
+    {
+        size_t total = rows.size();
+        size_t pages = std::min(kScrollPages, std::max<size_t>(1, total / kPageRows));
+        start = Clock::now();
+        for (size_t page = 0; page < pages; ++page)
+            drawRows(rows, total / pages * page, kPageRows, search);
+        result["scroll_page_us"] = secondsSince(start) * 1e6 / static_cast<double>(pages);
+    }
+
+    result["peak_rss_bytes"] = peakRss();
+    return result;
+}
+
+// Run one case in a child process and return its result line.
+std::string runIsolated(const std::string &shape, const std::string &path)
+{
+    int channel[2];
+    if (pipe(channel) != 0)
+        return {};
+    fflush(nullptr);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(channel[0]);
+        std::string line;
+        try
+        {
+            line = runCase(shape, path).dump();
+        }
+        catch (const std::exception &ex)
+        {
+            line = json{{"shape", shape}, {"error", ex.what()}}.dump();
+        }
+        line += '\n';
+        for (size_t sent = 0; sent < line.size();)
+        {
+            ssize_t n = write(channel[1], line.data() + sent, line.size() - sent);
+            if (n <= 0)
+                break;
+            sent += static_cast<size_t>(n);
+        }
+        _exit(0);
+    }
+    close(channel[1]);
+    std::string line;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(channel[0], chunk, sizeof(chunk))) > 0)
+        line.append(chunk, static_cast<size_t>(n));
+    close(channel[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (line.empty())
+    {
+        // Killed, most likely by running out of memory.
+        std::string reason = WIFSIGNALED(status) ? std::string("killed by signal ") + std::to_string(WTERMSIG(status))
+                                                 : std::string("exited with status ") + std::to_string(WEXITSTATUS(status));
+        line = json{{"shape", shape}, {"error", reason}}.dump() + '\n';
+    }
+    return line;
+}
+
+void showUsage(const char *progName)
+{
+    std::cout << "json-view-bench - Benchmarks of the json-view core over generated documents\n\n";
+    std::cout << "USAGE:\n";
+    std::cout << "  " << progName << " [--shapes LIST] [--sizes LIST] [--dir DIR] [--output FILE]\n\n";
+    std::cout << "OPTIONS:\n";
+    std::cout << "  -h, --help        Show this help message\n";
+    std::cout << "      --shapes LIST Comma-separated document shapes: deep, wide, strings, numbers\n"
+              << "                    (default: all of them)\n";
+    std::cout << "      --sizes LIST  Comma-separated document sizes such as 1M,64M,5G (default: 1M,16M)\n";
+    std::cout << "      --dir DIR     Keep generated documents in DIR and reuse them on later runs\n"
+              << "                    (default: a temporary directory that is removed afterwards)\n";
+    std::cout << "      --output FILE Append results to FILE instead of writing them to standard output\n\n";
+    std::cout << "Each case prints one JSON object per line with its timings in seconds (print_s,\n"
+              << "parse_s, build_tree_s, load_s, first_frame_s, search_first_s, search_s,\n"
+              << "expand_all_s, collect_visible_s), the cost of redrawing one screen after\n"
+              << "scrolling (scroll_page_us) and the peak resident memory (peak_rss_bytes).\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> shapes(std::begin(kShapes), std::end(kShapes));
+    std::vector<size_t> sizes{1 << 20, 16 << 20};
+    std::string directory;
+    std::string outputPath;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0)
+        {
+            showUsage(argv[0]);
+            return 0;
+        }
+        if (strcmp(arg, "--shapes") == 0 && i + 1 < argc)
+        {
+            shapes = splitList(argv[++i]);
+            for (const std::string &shape : shapes)
+            {
+                if (std::find(std::begin(kShapes), std::end(kShapes), shape) == std::end(kShapes))
+                {
+                    std::cerr << "Unknown shape: " << shape << std::endl;
+                    return 1;
+                }
+            }
+            continue;
+        }
+        if (strcmp(arg, "--sizes") == 0 && i + 1 < argc)
+        {
+            sizes.clear();
+            for (const std::string &item : splitList(argv[++i]))
+            {
+                size_t size = 0;
+                if (!parseSize(item, size))
+                {
+                    std::cerr << "Invalid size: " << item << std::endl;
+                    return 1;
+                }
+                sizes.push_back(size);
+            }
+            continue;
+        }
+        if (strcmp(arg, "--dir") == 0 && i + 1 < argc)
+        {
+            directory = argv[++i];
+            continue;
+        }
+        if (strcmp(arg, "--output") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+            continue;
+        }
+        std::cerr << "Unknown option: " << arg << std::endl;
+        showUsage(argv[0]);
+        return 1;
+    }
+
+    // An index saved by an earlier run would skip the scan being measured.
+    setenv("JSON_VIEW_NO_INDEX_CACHE", "1", 1);
+
+    bool temporary = directory.empty();
+    std::error_code ec;
+    if (temporary)
+    {
+        std::string pattern = (std::filesystem::temp_directory_path(ec) / "json-view-bench.XXXXXX").string();
+        if (!mkdtemp(pattern.data()))
+        {
+            std::cerr << "Cannot create a temporary directory: " << strerror(errno) << std::endl;
+            return 1;
+        }
+        directory = pattern;
+    }
+    else
+    {
+        std::filesystem::create_directories(directory, ec);
+    }
+
+    FILE *output = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "a");
+    if (!output)
+    {
+        std::cerr << "Cannot open " << outputPath << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    int status = 0;
+    for (size_t size : sizes)
+    {
+        for (const std::string &shape : shapes)
+        {
+            std::string path = directory + "/" + shape + "-" + std::to_string(size) + ".json";
+            auto start = Clock::now();
+            bool reused = !temporary && std::filesystem::exists(path, ec);
+            if (!reused && !generate(shape, size, path))
+            {
+                std::cerr << "Cannot write " << path << ": " << strerror(errno) << std::endl;
+                status = 1;
+                continue;
+            }
+            double generated = secondsSince(start);
+            std::cerr << shape << " " << formatFileSize(std::filesystem::file_size(path, ec)) << "..." << std::endl;
+
+            json result = json::parse(runIsolated(shape, path), nullptr, false);
+            if (result.is_discarded())
+                result = json{{"shape", shape}, {"error", "no result"}};
+            result["version"] = JSON_VIEW_VERSION;
+            result["size"] = size;
+            if (!reused)
+                result["generate_s"] = generated;
+            if (result.contains("error"))
+                status = 1;
+            fprintf(output, "%s\n", result.dump().c_str());
+            fflush(output);
+            if (temporary)
+                std::filesystem::remove(path, ec);
+        }
+    }
+    if (output != stdout)
+        fclose(output);
+    if (temporary)
+        std::filesystem::remove_all(directory, ec);
+    return status;
+}
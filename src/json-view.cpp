@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
@@ -14,11 +15,11 @@
 #include <limits>
 #include <map>
 #include <memory>
-#include <deque>
 #include <cmath>
 #include <sstream>
 #include <chrono>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "json_view_core.hpp"
@@ -181,6 +182,90 @@ static inline void showTransientStatus(const std::string &msg, int duration_ms)
     transientStatusExpiresAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(duration_ms);
 }
 
+// Progress of the background loader, shown in the status bar while any
+// input is still being parsed.  The main loop polls at kLoadPollMs.
+static std::string loadStatusMessage;
+// Whether the status bar shows the --stats figures ("P" toggles it).
+static bool statsOverlay = false;
+// Size and shape of the selected subtree, shown next to its path while
+// "i" has them on; counted in the background by a StatsJob.
+static std::string subtreeStatsMessage;
+static bool subtreeStatsShown = false;
+// Children listed by the statistics panel ("I") at most.
+static constexpr size_t kStatsPanelRows = 1000;
+static constexpr int kLoadPollMs = 100;
+// Rows one press of + or a level key expands at most; pressing it again
+// carries on where it stopped.
+static constexpr uint64_t kExpandRowBudget = 1000000;
+// How often followed files are looked at while waiting for keys.
+static constexpr int kFollowPollMs = 250;
+// Frames drawn for movement keys are at least this far apart (about 60
+// per second); keys arriving in between are folded into the next one.
+static constexpr int kFrameIntervalMs = 16;
+// Rows one notch of the mouse wheel moves the selection.
+static constexpr size_t kWheelRows = 3;
+
+// Rows the selection moves for a wheel event: negative up, 0 when the
+// event is not the wheel.
+static long wheelRows(const MEVENT &ev)
+{
+    if (ev.bstate & BUTTON4_PRESSED)
+        return -static_cast<long>(kWheelRows);
+#ifdef BUTTON5_PRESSED
+    if (ev.bstate & BUTTON5_PRESSED)
+        return static_cast<long>(kWheelRows);
+#endif
+    return 0;
+}
+static std::string formatLoadProgress(const DocumentLoader &loader)
+{
+    size_t consumed = loader.bytesConsumed();
+    size_t total = loader.bytesTotal();
+    double seconds = loader.secondsElapsed();
+    std::string msg = "[loading " + shortenPath(loader.currentLabel(), 30);
+    size_t pending = loader.pendingCount();
+    if (pending > 1)
+    {
+        msg += " +" + std::to_string(pending - 1) + " more";
+    }
+    msg += " " + formatFileSize(consumed);
+    if (total > 0)
+    {
+        msg += " / " + formatFileSize(total);
+    }
+    if (seconds > 0.0)
+    {
+        msg += ", " + formatFileSize(static_cast<size_t>(consumed / seconds)) + "/s";
+    }
+    msg += "]";
+    return msg;
+}
+
+// Types in the order the statistics list them.
+static const struct
+{
+    SubtreeStats::Type type;
+    const char *name;
+} kStatsTypes[] = {
+    {SubtreeStats::Object, "obj"},  {SubtreeStats::Array, "arr"},    {SubtreeStats::String, "str"},
+    {SubtreeStats::Number, "num"}, {SubtreeStats::Boolean, "bool"}, {SubtreeStats::Null, "null"},
+};
+
+static std::string formatSubtreeStats(const SubtreeStats &stats)
+{
+    std::string msg = "[" + formatFileSize(stats.bytes) + ", " + std::to_string(stats.values) + " values, depth " +
+                      std::to_string(stats.depth);
+    const char *separator = ": ";
+    for (const auto &entry : kStatsTypes)
+    {
+        if (stats.types[entry.type] == 0)
+            continue;
+        msg += separator + std::to_string(stats.types[entry.type]) + " " + entry.name;
+        separator = ", ";
+    }
+    return msg + "]";
+}
+
 // Display a help screen listing all key bindings.  The overlay
 // temporarily clears the screen and waits for any key press before
 // returning.
@@ -190,13 +275,17 @@ static void showHelp()
     int rows, cols;
     getmaxyx(stdscr, rows, cols);
 
-    bool clipboardSupported = osc52Likely();
+    bool clipboardSupported = clipboardTarget() != ClipboardTarget::None;
 
     std::string copyLine = "  y                Copy selected JSON to clipboard";
     if (!clipboardSupported)
     {
         const char *tmux = std::getenv("TMUX");
-        if (tmux && osc52Likely())
+        if (std::getenv("JSON_VIEW_NO_CLIPBOARD"))
+        {
+            copyLine += " (disabled by JSON_VIEW_NO_CLIPBOARD)";
+        }
+        else if (tmux && osc52Likely())
         {
             copyLine += " (tmux: enable OSC 52 forwarding)";
         }
@@ -223,9 +312,17 @@ static void showHelp()
         "  0-9              Expand to nesting level (0=collapse all, 1=first level, etc.)",
         "  s                Search keys",
         "  S                Search values",
+        "  f                Query with $.json.path or jump to a /json/pointer",
+        "  d                Compare the selected document with the next one",
         "  n / N            Next / previous search match",
         "  c                Clear search results",
+        "  g                Go to an item (record) of the current document by number",
+        "  Esc              Stop a running search",
         "  t                Cycle color scheme",
+        "  v                View the full value of the selected item",
+        "  i                Show or hide the size and shape of the selected item",
+        "  I                List the children of the selected item, largest first",
+        "  P                Show or hide timings and memory use in the status bar",
         copyLine,
         "  ?                Show this help screen",
         "  q                Quit the program",
@@ -319,6 +416,148 @@ static void showHelp()
     }
 }
 
+// Show the full text of a value a screen at a time.  Lines are cut from
+// the text only as they scroll into view, so a value of any size opens
+// at once; the starts of the lines seen so far are kept for scrolling
+// back.  A change of terminal width starts over from the top.
+static int showValuePager(const std::string &title, std::string_view text)
+{
+    timeout(-1);
+    std::vector<size_t> starts{0};
+    size_t top = 0;
+    int wrapWidth = 0;
+    std::string line;
+    while (true)
+    {
+        int rows, cols;
+        getmaxyx(stdscr, rows, cols);
+        if (cols != wrapWidth)
+        {
+            wrapWidth = cols;
+            starts.assign(1, 0);
+            top = 0;
+        }
+        int height = std::max(rows - 2, 1);
+
+        erase();
+        attron(A_REVERSE);
+        mvhline(0, 0, ' ', cols);
+        mvaddnstr(0, 0, title.c_str(), static_cast<int>(title.size()));
+        attroff(A_REVERSE);
+        size_t pos = starts[top];
+        for (int r = 0; r < height && pos < text.size(); ++r)
+        {
+            size_t next = pagerLine(text, pos, cols, line);
+            mvaddnstr(r + 1, 0, line.c_str(), static_cast<int>(line.size()));
+            if (top + r + 1 == starts.size())
+                starts.push_back(next);
+            pos = next;
+        }
+        bool atEnd = pos >= text.size();
+        size_t percent = text.empty() ? 100 : (atEnd ? 100 : pos * 100 / text.size());
+        std::string status = " Line " + std::to_string(top + 1) + ", " + std::to_string(percent) +
+                             "%  ↑/↓ PgUp/PgDn Home: scroll  q: back";
+        attron(A_REVERSE);
+        mvhline(rows - 1, 0, ' ', cols);
+        mvaddnstr(rows - 1, 0, status.c_str(), static_cast<int>(status.size()));
+        attroff(A_REVERSE);
+        refresh();
+
+        int ch = getch();
+        switch (ch)
+        {
+        case KEY_DOWN:
+        case 'j':
+            if (!atEnd)
+                ++top;
+            break;
+        case KEY_NPAGE:
+        case ' ':
+            // The lines of the next page start where this one ended
+            for (int r = 0; r < height && !atEnd && top + 1 < starts.size() && starts[top + 1] < text.size(); ++r)
+                ++top;
+            break;
+        case KEY_UP:
+        case 'k':
+            if (top > 0)
+                --top;
+            break;
+        case KEY_PPAGE:
+            top -= std::min<size_t>(top, height);
+            break;
+        case KEY_HOME:
+            top = 0;
+            break;
+        case KEY_RESIZE:
+            break;
+        case ERR:
+            break;
+        default:
+            return ch;
+        }
+    }
+}
+
+// The figures of a subtree and its children in a pager, heaviest children
+// first; s switches between sorting by size, by values, by depth and
+// document order.
+static void showStatsPanel(const std::string &path, const StatsJob &job)
+{
+    static const char *const orders[] = {"size", "values", "depth", "document order"};
+    const SubtreeStats &total = job.total();
+    const std::vector<StatsJob::Item> &items = job.items();
+    std::vector<size_t> order(items.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    for (int sort = 0;;)
+    {
+        auto key = [&](size_t i) {
+            const SubtreeStats &stats = items[i].stats;
+            return sort == 0 ? stats.bytes : sort == 1 ? stats.values : stats.depth;
+        };
+        size_t shown = std::min(order.size(), kStatsPanelRows);
+        std::sort(order.begin(), order.end());
+        if (sort < 3)
+            std::partial_sort(order.begin(), order.begin() + shown, order.end(),
+                              [&](size_t a, size_t b) { return key(a) > key(b) || (key(a) == key(b) && a < b); });
+
+        char line[160];
+        std::string text;
+        std::snprintf(line, sizeof(line), "Size    %s (%llu bytes)\nValues  %llu (%llu below)\nDepth   %u\nTypes  ",
+                      formatFileSize(total.bytes).c_str(), static_cast<unsigned long long>(total.bytes),
+                      static_cast<unsigned long long>(total.values),
+                      static_cast<unsigned long long>(total.descendants()), total.depth);
+        text += line;
+        for (const auto &entry : kStatsTypes)
+        {
+            std::snprintf(line, sizeof(line), " %s %llu (%.1f%%)", entry.name,
+                          static_cast<unsigned long long>(total.types[entry.type]),
+                          100.0 * total.types[entry.type] / total.values);
+            text += line;
+        }
+        text += "\n";
+        if (!items.empty())
+        {
+            text += "\n        SIZE       %       VALUES  DEPTH  KEY\n";
+            for (size_t n = 0; n < shown; ++n)
+            {
+                const StatsJob::Item &item = items[order[n]];
+                std::snprintf(line, sizeof(line), "%12s  %5.1f%%  %11llu  %5u  ", formatFileSize(item.stats.bytes).c_str(),
+                              total.bytes ? 100.0 * item.stats.bytes / total.bytes : 0.0,
+                              static_cast<unsigned long long>(item.stats.values), item.stats.depth);
+                text += line;
+                text += item.name ? *item.name : "[" + std::to_string(order[n]) + "]";
+                text += "\n";
+            }
+            if (shown < items.size())
+                text += "... and " + std::to_string(items.size() - shown) + " more\n";
+        }
+        if (showValuePager(path + " (by " + orders[sort] + ", s: sort)", text) != 's')
+            return;
+        sort = (sort + 1) % 4;
+    }
+}
+
 // Prompt the user for a search term.  The prompt appears on the
 // bottom line and the typed characters are echoed.  Return the
 // entered string with leading/trailing whitespace trimmed.
@@ -349,8 +588,8 @@ static void showUsage(const char *progName)
 {
     std::cout << "json-view - Interactive JSON viewer with tree navigation\n\n";
     std::cout << "USAGE:\n";
-    std::cout << "  " << progName << " [--parse-only|--validate] [--no-mouse] [--ascii] [--color-scheme NAME] [file1.json] [file2.json] ...\n";
-    std::cout << "  cat data.json | " << progName << " [--parse-only|--validate] [--no-mouse] [--ascii] [--color-scheme NAME]\n\n";
+    std::cout << "  " << progName << " [--parse-only|--validate] [--ndjson|--index] [--follow] [--max-memory SIZE] [--stats] [--no-mouse] [--ascii] [--color-scheme NAME] [file1.json] [file2.json] ...\n";
+    std::cout << "  cat data.json | " << progName << " [--parse-only|--validate] [--ndjson|--index] [--stats] [--no-mouse] [--ascii] [--color-scheme NAME]\n\n";
     std::cout << "DESCRIPTION:\n";
     std::cout << "  A simple console JSON viewer using ncurses for interactive tree navigation.\n";
     std::cout << "  Pass JSON file names as arguments to open them, or pipe JSON into the program\n";
@@ -366,9 +605,14 @@ static void showUsage(const char *progName)
     std::cout << "  0-9       Expand to nesting level (0=collapse all)\n";
     std::cout << "  s         Search keys\n";
     std::cout << "  S         Search values\n";
+    std::cout << "  f         Query with $.json.path or jump to a /json/pointer\n";
+    std::cout << "  d         Compare the selected document with the next one\n";
     std::cout << "  n/N       Next/previous search match\n";
     std::cout << "  c         Clear search results\n";
+    std::cout << "  g         Go to an item (record) of the current document by number\n";
+    std::cout << "  Esc       Stop a running search\n";
     std::cout << "  t         Cycle color scheme\n";
+    std::cout << "  P         Show or hide timings and memory use in the status bar\n";
     std::cout << "  y         Copy selected JSON to clipboard\n";
     std::cout << "  ?         Show help screen\n";
     std::cout << "  q         Quit the program\n";
@@ -378,6 +622,16 @@ static void showUsage(const char *progName)
     std::cout << "  -V, --version     Show version information\n";
     std::cout << "  -p, --parse-only  Parse input and pretty-print JSON then exit\n";
     std::cout << "      --validate    Validate JSON input and exit with status\n";
+    std::cout << "      --ndjson      Read inputs as JSON Lines, one record per line\n"
+              << "                    (the default for *.jsonl and *.ndjson files, also\n"
+              << "                    when gzip or zstd compressed)\n";
+    std::cout << "      --index       Index documents and parse parts only as they are shown\n"
+              << "                    (the default for files too large to parse in memory)\n";
+    std::cout << "  -f, --follow      Keep reading records appended to the files, like tail -f\n"
+              << "                    (implies --ndjson)\n";
+    std::cout << "      --max-memory SIZE  Keep memory use within SIZE (such as 512M or 4G): larger\n"
+              << "                    documents are indexed and parts scrolled away are dropped\n";
+    std::cout << "      --stats       Print timings, node counts and peak memory use on exit\n";
     std::cout << "      --no-mouse    Disable mouse support (or set JSON_VIEW_NO_MOUSE=1)\n";
     std::cout << "      --ascii       Use ASCII tree/indicator characters (or set JSON_VIEW_ASCII=1)\n";
     std::cout << "      --color-scheme NAME  Select color scheme (default, colorblind, none)\n"
@@ -385,6 +639,7 @@ static void showUsage(const char *progName)
     std::cout << "EXAMPLES:\n";
     std::cout << "  " << progName << " config.json data.json\n";
     std::cout << "  " << progName << " --parse-only config.json\n";
+    std::cout << "  " << progName << " --follow service.log.jsonl\n";
     std::cout << "  echo '{\"key\":\"value\"}' | " << progName << " --parse-only\n";
     std::cout << "  curl -s https://api.example.com/data | " << progName << "\n\n";
     std::cout << "AUTHOR:\n";
@@ -393,53 +648,225 @@ static void showUsage(const char *progName)
     std::cout << "  GPLv3 or later\n";
 }
 
-// Helper function to draw a single line in the display
-static void drawLine(int row, int idx, const Node *node, size_t selected,
-                     const SearchState &search, int cols, bool colours)
+// A run of text drawn with one colour pair (or none).
+struct RowPiece
+{
+    std::string text;
+    int colorPair;
+    bool coloured;
+};
+
+// Everything about a row that does not depend on selection or match
+// state.  Building it (prefix walk, labels, array previews and their
+// display widths) is the expensive part of drawing, so layouts are cached
+// per node.  An entry is reused while the node's expansion state, the
+// terminal width and the colour mode are unchanged and rowCacheGeneration
+// has not moved on; search result changes and new root documents bump
+// the generation.
+struct RowLayout
 {
-    std::string prefix = buildPrefix(node);
+    std::string prefix;
+    int prefixWidth = 0;
+    std::string indicator;
+    int indicatorWidth = 0;
+    std::string typeIcon; // only set for leaves
+    int typeIconWidth = 0;
+    std::vector<RowPiece> pieces;
+    int contentWidth = 0;
+
+    unsigned generation = 0;
+    int cols = 0;
+    bool colours = false;
+    bool expanded = false;
+};
+
+static std::unordered_map<const Node *, RowLayout> rowCache;
+static unsigned rowCacheGeneration = 1;
+// The cache only needs to cover a few screens; drop it when it grows past this.
+static constexpr size_t kRowCacheLimit = 4096;
+
+static void invalidateRowCache()
+{
+    ++rowCacheGeneration;
+}
+
+static void buildRowLayout(const Node *node, const SearchState &search, int cols, bool colours, RowLayout &layout)
+{
+    layout.prefix = buildPrefix(node);
+    layout.prefixWidth = getDisplayWidth(layout.prefix);
 
     // Calculate available width for label (accounting for prefix, indicator, and icon)
-    int prefixWidth = getDisplayWidth(prefix) + 4; // +4 for indicator and icon space
-    int availableWidth = cols - prefixWidth - 5;   // -5 for some margin
+    int prefixWidth = layout.prefixWidth + 4; // +4 for indicator and icon space
+    int availableWidth = cols - prefixWidth - 5; // -5 for some margin
     std::string typeIcon = getTypeIcon(node);
-    std::string contentLabel = getContentLabelWithSearch(node, search, availableWidth);
-    int contentWidthForHighlight = getDisplayWidth(contentLabel);
 
     // Add expand/collapse indicator with subtle Unicode triangles (ASCII when enabled)
-    std::string indicator;
-
-    if (!node->children.empty())
+    if (hasChildren(node))
     {
         // For expandable nodes (objects and arrays), use regular expand/collapse indicator
-        indicator = node->expanded ? (asciiMode ? "v " : "▼ ") : (asciiMode ? "> " : "▶ ");
+        layout.indicator = node->expanded ? (asciiMode ? "v " : "▼ ") : (asciiMode ? "> " : "▶ ");
     }
     else if (!typeIcon.empty())
     {
         // For leaf nodes with type icons, use the icon as the indicator
-        indicator = "";
+        layout.indicator.clear();
     }
     else
     {
-        indicator = "  ";
+        layout.indicator = "  ";
     }
+    layout.indicatorWidth = getDisplayWidth(layout.indicator);
 
-    // Determine selection and match status
-    bool isSelected = (idx == (int)selected);
-    bool isMatch = false;
-    if (!search.term.empty())
+    // The type icon is drawn right after the indicator for leaf nodes
+    layout.typeIcon = hasChildren(node) ? std::string() : typeIcon;
+    layout.typeIconWidth = getDisplayWidth(layout.typeIcon);
+
+    layout.pieces.clear();
+    const json *v = nodeValue(node);
+    if (colours && v && v->is_array() && !node->expanded && !node->isDummyRoot)
     {
-        // Determine if current node is in search matches
-        for (const Node *m : search.matches)
+        // Build base label (key + count info)
+        size_t count = v->size();
+        std::string baseLabel = nodeKey(node) + " (list, " + std::to_string(count) + (count == 1 ? " item)" : " items)");
+        int baseWidth = getDisplayWidth(baseLabel);
+        layout.pieces.push_back({baseLabel, ColorScheme::NORMAL_TEXT, false});
+        layout.contentWidth = baseWidth;
+        if (v->empty())
+            return;
+
+        // Preview the elements with colours, as many as fit
+        layout.pieces.push_back({": ", ColorScheme::NORMAL_TEXT, false});
+        int previewPrintedWidth = 2; // account for ": "
+        int previewBudget = std::max(0, availableWidth - baseWidth); // budget for preview part
+
+        bool first = true;
+        for (const auto &item : *v)
         {
-            if (m == node)
+            std::string token;
+            int colorPair = ColorScheme::NORMAL_TEXT;
+            int sepWidth = first ? 0 : 2; // ", "
+            bool truncated = false;
+
+            if (item.is_string())
+            {
+                // Look at no more of the string than could fit; a cut
+                // string does not fit and ends the preview
+                int room = previewBudget - 3 - previewPrintedWidth - sepWidth - 2;
+                token = "\"" + labelText(item.get_ref<const std::string &>(), std::max(room, 0), &truncated) + "\"";
+                colorPair = ColorScheme::STRING_VALUES;
+            }
+            else if (item.is_number())
+            {
+                token = item.dump();
+                colorPair = ColorScheme::NUMBER_VALUES;
+            }
+            else if (item.is_boolean())
+            {
+                token = item.get<bool>() ? "true" : "false";
+                colorPair = ColorScheme::BOOLEAN_VALUES;
+            }
+            else if (item.is_null())
             {
-                isMatch = true;
+                token = "null";
+                colorPair = ColorScheme::NULL_VALUES;
+            }
+            else
+            {
+                token = item.is_object() ? "{...}" : "[...]";
+                colorPair = ColorScheme::NORMAL_TEXT;
+            }
+
+            int tokenWidth = getDisplayWidth(token);
+
+            // Reserve space for trailing ellipsis if we can't fit all items
+            if (truncated || previewPrintedWidth + sepWidth + tokenWidth > previewBudget - 3)
+            {
+                // Not enough space; add ellipsis if we have printed something
+                if (previewPrintedWidth < previewBudget)
+                {
+                    layout.pieces.push_back({"...", ColorScheme::NORMAL_TEXT, false});
+                    previewPrintedWidth += 3;
+                }
                 break;
             }
+
+            if (!first)
+            {
+                layout.pieces.push_back({", ", ColorScheme::NORMAL_TEXT, false});
+                previewPrintedWidth += 2;
+            }
+            layout.pieces.push_back({std::move(token), colorPair, colorPair != ColorScheme::NORMAL_TEXT});
+            previewPrintedWidth += tokenWidth;
+            first = false;
         }
+
+        layout.contentWidth = baseWidth + previewPrintedWidth;
+        return;
     }
 
+    std::string contentLabel = getContentLabelWithSearch(node, search, availableWidth);
+    layout.contentWidth = getDisplayWidth(contentLabel);
+    size_t colonPos;
+    if (colours && v && !v->is_object() && !v->is_array() && !node->isDummyRoot &&
+        (colonPos = contentLabel.find(": ")) != std::string::npos)
+    {
+        // For primitive values, separate key and value
+        int valueColorPair = ColorScheme::NORMAL_TEXT; // default
+        if (v->is_string())
+            valueColorPair = ColorScheme::STRING_VALUES;
+        else if (v->is_number())
+            valueColorPair = ColorScheme::NUMBER_VALUES;
+        else if (v->is_boolean())
+            valueColorPair = ColorScheme::BOOLEAN_VALUES;
+        else if (v->is_null())
+            valueColorPair = ColorScheme::NULL_VALUES;
+
+        layout.pieces.push_back({contentLabel.substr(0, colonPos), ColorScheme::KEY_NAMES, true});
+        layout.pieces.push_back({": ", ColorScheme::NORMAL_TEXT, false});
+        layout.pieces.push_back({contentLabel.substr(colonPos + 2), valueColorPair, true});
+    }
+    else
+    {
+        // Objects, expanded arrays and uncoloured rows are drawn as one run
+        layout.pieces.push_back({std::move(contentLabel), ColorScheme::NORMAL_TEXT, false});
+    }
+}
+
+static const RowLayout &rowLayout(const Node *node, const SearchState &search, int cols, bool colours)
+{
+    auto it = rowCache.find(node);
+    if (it != rowCache.end())
+    {
+        const RowLayout &cached = it->second;
+        if (cached.generation == rowCacheGeneration && cached.cols == cols && cached.colours == colours &&
+            cached.expanded == node->expanded)
+            return cached;
+    }
+    else
+    {
+        if (rowCache.size() >= kRowCacheLimit)
+            rowCache.clear();
+        it = rowCache.emplace(node, RowLayout()).first;
+    }
+    RowLayout &layout = it->second;
+    buildRowLayout(node, search, cols, colours, layout);
+    layout.generation = rowCacheGeneration;
+    layout.cols = cols;
+    layout.colours = colours;
+    layout.expanded = node->expanded;
+    return layout;
+}
+
+// Helper function to draw a single line in the display
+static void drawLine(int row, int idx, const Node *node, size_t selected,
+                     const SearchState &search, int cols, bool colours)
+{
+    const RowLayout &layout = rowLayout(node, search, cols, colours);
+
+    // Determine selection and match status
+    bool isSelected = (idx == (int)selected);
+    bool isMatch = !search.term.empty() && search.isMatch(node);
+
     // Clear the line first
     mvhline(row, 0, ' ', cols);
 
@@ -448,190 +875,50 @@ static void drawLine(int row, int idx, const Node *node, size_t selected,
     int pos = 0;
 
     // Render tree structure (prefix) in blue
-    if (!prefix.empty())
+    if (!layout.prefix.empty())
     {
         if (colours)
             attron(COLOR_PAIR(ColorScheme::TREE_STRUCTURE));
-        addnstr(prefix.c_str(), prefix.length());
+        addnstr(layout.prefix.c_str(), layout.prefix.length());
         if (colours)
             attroff(COLOR_PAIR(ColorScheme::TREE_STRUCTURE));
-        pos += getDisplayWidth(prefix);
+        pos += layout.prefixWidth;
     }
 
     // Render expand/collapse indicator in magenta
-    if (!indicator.empty())
+    if (!layout.indicator.empty())
     {
         if (colours)
             attron(COLOR_PAIR(ColorScheme::EXPAND_INDICATORS));
-        addnstr(indicator.c_str(), indicator.length());
+        addnstr(layout.indicator.c_str(), layout.indicator.length());
         if (colours)
             attroff(COLOR_PAIR(ColorScheme::EXPAND_INDICATORS));
-        pos += getDisplayWidth(indicator);
+        pos += layout.indicatorWidth;
     }
 
     // Render type icon right after indicator (for leaf nodes, this replaces the spaces)
-    if (!typeIcon.empty() && node->children.empty())
+    if (!layout.typeIcon.empty())
     {
         if (colours)
             attron(COLOR_PAIR(ColorScheme::EXPAND_INDICATORS)); // Use same color as indicators
-        addnstr(typeIcon.c_str(), typeIcon.length());
+        addnstr(layout.typeIcon.c_str(), layout.typeIcon.length());
         if (colours)
             attroff(COLOR_PAIR(ColorScheme::EXPAND_INDICATORS));
-        pos += getDisplayWidth(typeIcon);
+        pos += layout.typeIconWidth;
     }
 
     // Render content with proper colors
-    if (colours)
-    {
-        const json *v = node->value;
-
-        // Special handling for arrays with preview
-        if (v->is_array() && !node->expanded && !node->isDummyRoot)
-        {
-            // Build base label (key + count info)
-            size_t count = v->size();
-            std::string baseLabel = node->key + " (list, " + std::to_string(count) + (count == 1 ? " item)" : " items)");
-
-            // If array is empty, just render the base label
-            if (v->empty())
-            {
-                addnstr(baseLabel.c_str(), baseLabel.length());
-                contentWidthForHighlight = getDisplayWidth(baseLabel);
-            }
-            else
-            {
-                // Render base label
-                addnstr(baseLabel.c_str(), baseLabel.length());
-                int baseWidth = getDisplayWidth(baseLabel);
-
-                // Render preview directly from JSON with colors
-                addstr(": ");
-
-                int previewPrintedWidth = 2; // account for ": "
-                int previewBudget = std::max(0, availableWidth - baseWidth); // budget for preview part
-
-                bool first = true;
-                for (const auto &item : *v)
-                {
-                    std::string token;
-                    int colorPair = ColorScheme::NORMAL_TEXT;
-
-                    if (item.is_string())
-                    {
-                        token = "\"" + item.get<std::string>() + "\"";
-                        colorPair = ColorScheme::STRING_VALUES;
-                    }
-                    else if (item.is_number())
-                    {
-                        token = item.dump();
-                        colorPair = ColorScheme::NUMBER_VALUES;
-                    }
-                    else if (item.is_boolean())
-                    {
-                        token = item.get<bool>() ? "true" : "false";
-                        colorPair = ColorScheme::BOOLEAN_VALUES;
-                    }
-                    else if (item.is_null())
-                    {
-                        token = "null";
-                        colorPair = ColorScheme::NULL_VALUES;
-                    }
-                    else
-                    {
-                        token = item.is_object() ? "{...}" : "[...]";
-                        colorPair = ColorScheme::NORMAL_TEXT;
-                    }
-
-                    int sepWidth = first ? 0 : 2; // ", "
-                    int tokenWidth = getDisplayWidth(token);
-
-                    // Reserve space for trailing ellipsis if we can't fit all items
-                    if (previewPrintedWidth + sepWidth + tokenWidth > previewBudget - 3)
-                    {
-                        // Not enough space; add ellipsis if we have printed something
-                        if (previewPrintedWidth < previewBudget)
-                        {
-                            addnstr("...", 3);
-                            previewPrintedWidth += 3;
-                        }
-                        break;
-                    }
-
-                    if (!first)
-                    {
-                        addstr(", ");
-                        previewPrintedWidth += 2;
-                    }
-
-                    if (colorPair != ColorScheme::NORMAL_TEXT)
-                    {
-                        attron(COLOR_PAIR(colorPair));
-                        addnstr(token.c_str(), token.length());
-                        attroff(COLOR_PAIR(colorPair));
-                    }
-                    else
-                    {
-                        addnstr(token.c_str(), token.length());
-                    }
-
-                    previewPrintedWidth += tokenWidth;
-                    first = false;
-                }
-
-                contentWidthForHighlight = baseWidth + previewPrintedWidth;
-            }
-        }
-        else if (!v->is_object() && !v->is_array() && !node->isDummyRoot)
-        {
-            // For primitive values, separate key and value
-            size_t colonPos = contentLabel.find(": ");
-            if (colonPos != std::string::npos)
-            {
-                // Render key in white
-                std::string keyPart = contentLabel.substr(0, colonPos);
-                attron(COLOR_PAIR(ColorScheme::KEY_NAMES));
-                addnstr(keyPart.c_str(), keyPart.length());
-                attroff(COLOR_PAIR(ColorScheme::KEY_NAMES));
-
-                // Render colon
-                addstr(": ");
-
-                // Render value in appropriate color
-                std::string valuePart = contentLabel.substr(colonPos + 2);
-                int valueColorPair = ColorScheme::NORMAL_TEXT; // default
-                if (v->is_string())
-                    valueColorPair = ColorScheme::STRING_VALUES;
-                else if (v->is_number())
-                    valueColorPair = ColorScheme::NUMBER_VALUES;
-                else if (v->is_boolean())
-                    valueColorPair = ColorScheme::BOOLEAN_VALUES;
-                else if (v->is_null())
-                    valueColorPair = ColorScheme::NULL_VALUES;
-
-                attron(COLOR_PAIR(valueColorPair));
-                addnstr(valuePart.c_str(), valuePart.length());
-                attroff(COLOR_PAIR(valueColorPair));
-            }
-            else
-            {
-                // No colon found, just render normally
-                addnstr(contentLabel.c_str(), contentLabel.length());
-            }
-        }
-        else
-        {
-            // For objects/expanded arrays, render normally
-            addnstr(contentLabel.c_str(), contentLabel.length());
-        }
-    }
-    else
+    for (const RowPiece &piece : layout.pieces)
     {
-        // No colors, just add the content
-        addnstr(contentLabel.c_str(), contentLabel.length());
+        if (piece.coloured)
+            attron(COLOR_PAIR(piece.colorPair));
+        addnstr(piece.text.c_str(), piece.text.length());
+        if (piece.coloured)
+            attroff(COLOR_PAIR(piece.colorPair));
     }
 
     // Calculate actual rendered text length for proper highlighting
-    int actualTextLen = pos + contentWidthForHighlight;
+    int actualTextLen = pos + layout.contentWidth;
 
     // Apply selection/match highlighting with minimal extra space
     if (isSelected || isMatch)
@@ -667,7 +954,7 @@ static void drawLine(int row, int idx, const Node *node, size_t selected,
 }
 
 // Helper function to draw the status bar
-static void drawStatusBar(int statusRow, size_t selected, const std::vector<const Node *> &visible,
+static void drawStatusBar(int statusRow, size_t selected, const VisibleRows &visible,
                           const SearchState &search, int cols, bool colours)
 {
     std::string status;
@@ -688,12 +975,13 @@ static void drawStatusBar(int statusRow, size_t selected, const std::vector<cons
     }
 
     // Show path of selected node
+    if (!visible.empty())
     {
         const Node *cur = visible[selected];
         std::vector<std::string> parts;
         while (cur != nullptr)
         {
-            parts.push_back(cur->key);
+            parts.push_back(nodeKey(cur));
             cur = cur->parent;
         }
         std::string path;
@@ -719,6 +1007,16 @@ static void drawStatusBar(int statusRow, size_t selected, const std::vector<cons
         status = path.empty() ? "/" : path;
     }
 
+    if (!subtreeStatsMessage.empty())
+    {
+        status += (status.empty() ? "" : " ") + subtreeStatsMessage;
+    }
+
+    if (!loadStatusMessage.empty())
+    {
+        status += (status.empty() ? "" : "   ") + loadStatusMessage;
+    }
+
     int curWidth = getDisplayWidth(status);
 
     auto addHint = [&](char key, const std::string &label, bool addComma) {
@@ -738,7 +1036,17 @@ static void drawStatusBar(int statusRow, size_t selected, const std::vector<cons
     {
         int total = search.matches.size();
         int curIdx = (total == 0 ? 0 : search.currentIndex + 1);
-        status += "   [search '" + search.term + "' " + std::to_string(curIdx) + "/" + std::to_string(total) + "]";
+        static const char *const modeNames[] = {"search", "query", "diff"};
+        status += std::string("   [") + modeNames[static_cast<int>(search.mode)] + " '" + search.term + "' " +
+                  std::to_string(curIdx) + "/" + std::to_string(total);
+        if (search.inProgress)
+            status += search.mode == SearchState::Mode::Diff ? " comparing, Esc stops" : " searching, Esc stops";
+        else if (const DiffChange *change = selected < visible.size() ? search.change(visible[selected]) : nullptr)
+            status += *change == DiffChange::Added     ? ", added"
+                      : *change == DiffChange::Removed ? ", removed"
+                      : *change == DiffChange::Moved   ? ", moved"
+                                                       : ", changed";
+        status += "]";
         curWidth = getDisplayWidth(status);
         status += "   (";
         curWidth += 4;
@@ -756,6 +1064,11 @@ static void drawStatusBar(int statusRow, size_t selected, const std::vector<cons
         status += ")";
     }
 
+    if (statsOverlay)
+    {
+        status += "   [" + perfStats.overlay() + "]";
+    }
+
     if (getDisplayWidth(status) > cols)
     {
         status = status.substr(0, cols);
@@ -768,7 +1081,7 @@ static void drawStatusBar(int statusRow, size_t selected, const std::vector<cons
 }
 
 // Helper function to redraw from a specific row downwards (for expand/collapse optimization)
-static void drawFromRowDownwards(int startRow, int scrollOffset, const std::vector<const Node *> &visible,
+static void drawFromRowDownwards(int startRow, int scrollOffset, const VisibleRows &visible,
                                  size_t selected, const SearchState &search, int rows, int cols, bool colours)
 {
     int displayRows = rows - 1; // Reserve last row for status bar
@@ -792,6 +1105,119 @@ static void drawFromRowDownwards(int startRow, int scrollOffset, const std::vect
     drawStatusBar(rows - 1, selected, visible, search, cols, colours);
 }
 
+// --parse-only: print the inputs one after another straight from their
+// text, so no DOM of a whole document is ever built.  JSON Lines inputs
+// are printed a record at a time.
+static int printDocuments(const std::vector<std::string> &paths, InputFormat format)
+{
+    JsonPrinter printer;
+    bool anyPrinted = false;
+    for (const std::string &path : paths)
+    {
+        const bool fromStdin = path.empty();
+        InputBuffer input;
+        std::string error;
+        if (!(fromStdin ? input.openDescriptor(STDIN_FILENO, error) : input.openFile(path, error)))
+        {
+            printer.flush();
+            std::cerr << (fromStdin ? "Failed to read stdin: " + error : "Failed to open file: " + path) << std::endl;
+            continue;
+        }
+        // Empty standard input is not an error; there is simply nothing to print.
+        if (fromStdin && input.empty())
+            continue;
+        if (!input.decompress(error))
+        {
+            printer.flush();
+            std::cerr << (fromStdin ? "Failed to decompress stdin: " + error
+                                    : "Failed to decompress " + path + ": " + error)
+                      << std::endl;
+            continue;
+        }
+        bool ok = true;
+        if (resolveFormat(format, path, input.size()) == InputFormat::Lines)
+        {
+            NodeTree tree(std::move(input), std::string(), NodeTree::Layout::Lines);
+            for (size_t i = 0; ok && i < tree.recordCount(); ++i)
+            {
+                ok = printer.printText(tree.recordText(i), error, tree.text());
+                if (ok)
+                {
+                    printer.write("\n");
+                    // Records before a bad line are out already
+                    anyPrinted = true;
+                }
+            }
+        }
+        else
+        {
+            ok = printer.printText(input.view(), error);
+            if (ok)
+                printer.write("\n");
+        }
+        if (!ok)
+        {
+            printer.flush();
+            std::cerr << (fromStdin ? "Error parsing JSON from stdin: " + error
+                                    : "Error parsing JSON in " + path + ": " + error)
+                      << std::endl;
+            continue;
+        }
+        anyPrinted = true;
+    }
+    printer.flush();
+    if (!anyPrinted)
+    {
+        std::cerr << "No valid JSON documents provided." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// "512M", "2G", "800k" or a plain number of bytes.
+static bool parseByteSize(const char *text, size_t &size)
+{
+    char *end = nullptr;
+    double value = std::strtod(text, &end);
+    if (end == text || !(value > 0))
+        return false;
+    switch (*end)
+    {
+    case 'k':
+    case 'K':
+        value *= 1024.0;
+        ++end;
+        break;
+    case 'm':
+    case 'M':
+        value *= 1024.0 * 1024.0;
+        ++end;
+        break;
+    case 'g':
+    case 'G':
+        value *= 1024.0 * 1024.0 * 1024.0;
+        ++end;
+        break;
+    default:
+        break;
+    }
+    if (*end == 'B' || *end == 'b')
+        ++end;
+    if (*end != '\0')
+        return false;
+    size = static_cast<size_t>(value);
+    return true;
+}
+
+// A file shown with --follow.  `recheck` makes the first look at it not
+// wait for the watcher, in case it grew while it was being loaded.
+struct FollowedFile
+{
+    NodeTree *tree;
+    std::unique_ptr<FileWatcher> watcher;
+    bool recheck = true;
+};
+
 // Entry point
 int main(int argc, char **argv)
 {
@@ -800,6 +1226,11 @@ int main(int argc, char **argv)
 
     bool parseOnly = false;
     bool validateOnly = false;
+    bool lineDelimited = false;
+    bool indexed = false;
+    bool follow = false;
+    bool showStats = false;
+    size_t memoryBudget = 0; // --max-memory; 0 leaves the loader's default
     bool enableMouse = true;
     const char *envAscii = std::getenv("JSON_VIEW_ASCII");
     if (envAscii && *envAscii)
@@ -842,6 +1273,37 @@ int main(int argc, char **argv)
             validateOnly = true;
             continue;
         }
+        if (strcmp(arg, "--ndjson") == 0)
+        {
+            lineDelimited = true;
+            continue;
+        }
+        if (strcmp(arg, "--index") == 0)
+        {
+            indexed = true;
+            continue;
+        }
+        if (strcmp(arg, "--follow") == 0 || strcmp(arg, "-f") == 0)
+        {
+            follow = true;
+            continue;
+        }
+        const char *memoryPrefix = "--max-memory=";
+        if ((strcmp(arg, "--max-memory") == 0 && i + 1 < argc) || strncmp(arg, memoryPrefix, strlen(memoryPrefix)) == 0)
+        {
+            const char *value = strcmp(arg, "--max-memory") == 0 ? argv[++i] : arg + strlen(memoryPrefix);
+            if (!parseByteSize(value, memoryBudget))
+            {
+                std::cerr << "Invalid --max-memory size: " << value << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (strcmp(arg, "--stats") == 0)
+        {
+            showStats = true;
+            continue;
+        }
         if (strcmp(arg, "--no-mouse") == 0)
         {
             enableMouse = false;
@@ -866,85 +1328,103 @@ int main(int argc, char **argv)
         files.push_back(arg);
     }
 
-    // Parse JSON files or standard input
-    std::vector<std::unique_ptr<Node>> roots;
-    std::deque<json> jsonDocs; // deque guarantees stable addresses for elements
+    // The report goes to stderr once everything, curses included, is torn down
+    struct StatsReport
+    {
+        bool wanted;
+        ~StatsReport()
+        {
+            if (wanted)
+                std::cerr << perfStats.summary();
+        }
+    } statsReport{showStats};
+    if (showStats)
+        perfStats.enable();
+
+    // Parse JSON files or standard input on a background thread.  Without
+    // file arguments standard input is read as a single document.
+    bool fromStdin = files.empty();
+    if (follow && fromStdin && !parseOnly && !validateOnly)
+    {
+        std::cerr << "--follow needs file arguments." << std::endl;
+        return 1;
+    }
+    // Followed files grow a record at a time, so they are read as JSON Lines
+    if (follow)
+        lineDelimited = true;
+    std::vector<std::string> paths(files.begin(), files.end());
+    if (fromStdin)
+        paths.emplace_back();
+    InputFormat format = lineDelimited ? InputFormat::Lines : indexed ? InputFormat::Indexed : InputFormat::Auto;
+    if (parseOnly)
+        return printDocuments(paths, format);
+    DocumentLoader loader(std::move(paths), !validateOnly, format, 0, memoryBudget);
+
+    std::vector<std::unique_ptr<NodeTree>> trees;
+    std::vector<Node *> roots;
+    std::vector<std::unique_ptr<json>> jsonDocs;
+    std::vector<FollowedFile> followed;
+    std::vector<std::string> loadErrors; // reported once curses has ended
+    bool cursesActive = false;
     bool anyParsed = false;
     bool allParsed = true;
-    for (const char *filename : files)
-    {
-        std::ifstream f(filename);
-        if (!f)
+    auto reportError = [&](const std::string &message) {
+        if (cursesActive)
         {
-            std::cerr << "Failed to open file: " << filename << std::endl;
-            continue;
+            loadErrors.push_back(message);
+            showTransientStatus(message, 3000);
         }
-        std::ostringstream ss;
-        ss << f.rdbuf();
-        std::string contents = ss.str();
-
-        // Store the actual file size
-        size_t fileSize = contents.size();
-        fileSizes[filename] = fileSize;
-
-        try
+        else
         {
-            json doc = parseJsonWithSpecialNumbers(contents);
-            anyParsed = true;
-            if (parseOnly)
-            {
-                printFormattedJson(doc);
-                std::cout << "\n";
-            }
-            else if (!validateOnly)
-            {
-                jsonDocs.push_back(std::move(doc));
-                const json *ptr = &jsonDocs.back();
-                auto root = buildTree(ptr, filename, nullptr, true);
-                roots.push_back(std::move(root));
-            }
+            std::cerr << message << std::endl;
         }
-        catch (const std::exception &ex)
+    };
+    // Take ownership of a finished document, or report why it failed.
+    auto adoptDocument = [&](LoadedDocument &loaded) {
+        if (loaded.openFailed)
         {
-            std::cerr << "Error parsing JSON in " << filename << ": " << ex.what() << std::endl;
-            allParsed = false;
+            reportError(fromStdin ? "Failed to read stdin: " + loaded.error
+                                  : "Failed to open file: " + loaded.label);
+            return;
         }
-    }
-
-    if (files.empty())
-    {
-        // Read from stdin and parse as a single JSON document
-        std::ostringstream ss;
-        ss << std::cin.rdbuf();
-        std::string contents = ss.str();
-        if (!contents.empty())
+        fileSizes[loaded.label] = loaded.size;
+        if (!loaded.loaded())
         {
-            size_t contentSize = contents.size();
-            fileSizes["(stdin)"] = contentSize;
-
-            try
-            {
-                json doc = parseJsonWithSpecialNumbers(contents);
-                anyParsed = true;
-                if (parseOnly)
-                {
-                    printFormattedJson(doc);
-                    std::cout << "\n";
-                }
-                else if (!validateOnly)
-                {
-                    jsonDocs.push_back(std::move(doc));
-                    const json *ptr = &jsonDocs.back();
-                    auto root = buildTree(ptr, "(stdin)", nullptr, true);
-                    roots.push_back(std::move(root));
-                }
-            }
-            catch (const std::exception &ex)
+            if (!loaded.error.empty())
             {
-                std::cerr << "Error parsing JSON from stdin: " << ex.what() << std::endl;
+                reportError(fromStdin ? "Error parsing JSON from stdin: " + loaded.error
+                                      : "Error parsing JSON in " + loaded.label + ": " + loaded.error);
                 allParsed = false;
             }
+            return;
         }
+        anyParsed = true;
+        if (validateOnly)
+            return;
+        // Mark last child among roots so that prefixes are drawn properly
+        if (!roots.empty())
+            roots.back()->isLastChild = false;
+        if (loaded.doc)
+            jsonDocs.push_back(std::move(loaded.doc));
+        trees.push_back(std::move(loaded.tree));
+        if (memoryBudget)
+            trees.back()->trackParsedValues();
+        roots.push_back(trees.back()->root());
+        roots.back()->isLastChild = true;
+        // Appended text cannot be told apart in a compressed file.
+        if (follow && trees.back()->isRecordList() && !loaded.compressed)
+            followed.push_back({trees.back().get(), std::make_unique<FileWatcher>(loaded.label)});
+        invalidateRowCache();
+    };
+
+    // Batch modes simply wait for every document.  Standard input is also
+    // read to the end before curses starts, since curses reads keys from
+    // the same descriptor.
+    if (validateOnly || fromStdin)
+    {
+        LoadedDocument loaded;
+        while (loader.waitNext(loaded))
+            adoptDocument(loaded);
     }
 
     if (validateOnly)
@@ -954,38 +1434,36 @@ int main(int argc, char **argv)
         return 0;
     }
 
-    if (parseOnly)
-    {
-        if (!anyParsed)
-        {
-            std::cerr << "No valid JSON documents provided." << std::endl;
-            return 1;
-        }
-        return 0;
-    }
 
-    // Mark last child among roots so that prefixes are drawn properly
-    for (size_t i = 0; i < roots.size(); ++i)
+    // Give small inputs a moment so they appear without a loading screen
+    // and so an input that fails outright is reported before curses starts.
+    if (loader.waitReady(std::chrono::milliseconds(kLoadPollMs)))
     {
-        roots[i]->isLastChild = (i == roots.size() - 1);
+        for (LoadedDocument &loaded : loader.takeFinished())
+            adoptDocument(loaded);
     }
-    // If nothing was parsed there is nothing to display
-    if (roots.empty())
+    if (loader.done() && roots.empty())
     {
         std::cerr << "No valid JSON documents provided." << std::endl;
         return 1;
     }
+
     // Initialise curses
     initscr();
     raw();
     noecho();
     keypad(stdscr, TRUE);
+    // Esc cancels a running search; don't wait a full second to tell it
+    // apart from the start of an escape sequence.
+    set_escdelay(100);
     curs_set(0);
     if (enableMouse)
     {
         mousemask(ALL_MOUSE_EVENTS, NULL);
     }
 
+    cursesActive = true;
+
     bool colours = false;
     applyColorScheme(currentScheme, colours);
 
@@ -1003,7 +1481,7 @@ int main(int argc, char **argv)
 
     // State variables
     SearchState search;
-    std::vector<const Node *> visible;
+    VisibleRows visible(roots);
     // Start with first visible node selected
     size_t selected = 0;
     size_t previousSelected = SIZE_MAX; // Track previous selection for efficient updates
@@ -1011,29 +1489,315 @@ int main(int argc, char **argv)
     int previousScrollOffset = -1;  // Track previous scroll offset
     bool needFullRedraw = true;     // Flag to force full redraw when needed
     bool needPartialRedraw = false; // Flag for partial redraw from current line downwards
+    uint64_t frame = 0;             // frames drawn, for --max-memory
+
+    // Searches run in the background; matches stream into `search` and the
+    // selection jumps to the first one as soon as it is found.
+    std::unique_ptr<SearchJob> searchJob;
+    // Subtree figures are counted for the selected node in the background
+    // and kept per node.  statsDone is the last finished count, whose
+    // children the panel lists; the panel opens once the count for
+    // statsPanelFor is done.
+    SubtreeStatsCache subtreeStats;
+    std::unique_ptr<StatsJob> statsJob;
+    std::unique_ptr<StatsJob> statsDone;
+    const Node *statsPanelFor = nullptr;
+    auto finishStats = [&]() {
+        if (!statsJob || !statsJob->finished())
+            return;
+        statsJob->store(subtreeStats);
+        statsDone = std::move(statsJob);
+        if (statsPanelFor == statsDone->node())
+        {
+            statsPanelFor = nullptr;
+            showStatsPanel(nodeKey(statsDone->node()), *statsDone);
+            needFullRedraw = true;
+        }
+    };
+    // Expansion stopped at its row budget, continued by the key
+    // (expansionKey) that started it.
+    std::unique_ptr<Expansion> expansion;
+    int expansionKey = 0;
+    bool jumpToFirstMatch = false;
+    // One press of an expansion key opens at most kExpandRowBudget rows,
+    // so that it never holds up the terminal for long.
+    auto runExpansion = [&]() {
+        if (expansion->step(kExpandRowBudget))
+        {
+            expansion.reset();
+            return;
+        }
+        showTransientStatus("Expanded " + std::to_string(expansion->rowsAdded()) + " rows so far; press " +
+                                std::string(1, static_cast<char>(expansionKey)) + " again for more",
+                            5000);
+    };
+    auto startSearch = [&](const std::string &term, bool keys, bool values) {
+        searchJob.reset();
+        // Lowercase the term for case‑insensitive comparison
+        std::string lower = term;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        search.term = lower;
+        search.mode = SearchState::Mode::Text;
+        search.searchKeys = keys;
+        search.searchValues = values;
+        search.clearMatches();
+        search.currentIndex = 0;
+        search.inProgress = !lower.empty();
+        jumpToFirstMatch = true;
+        invalidateRowCache();
+        if (search.inProgress)
+            searchJob = std::make_unique<SearchJob>(std::vector<const Node *>(roots.begin(), roots.end()),
+                                                    lower, keys, values);
+    };
+    // Queries select their matches like searches do.  False, with the
+    // reason in error, when the text does not compile.
+    auto startQuery = [&](const std::string &text, std::string &error) {
+        Query query;
+        if (!query.compile(text, error))
+            return false;
+        searchJob.reset();
+        search.term = text;
+        search.mode = SearchState::Mode::Query;
+        search.clearMatches();
+        search.currentIndex = 0;
+        search.inProgress = true;
+        jumpToFirstMatch = true;
+        invalidateRowCache();
+        searchJob = std::make_unique<SearchJob>(std::vector<const Node *>(roots.begin(), roots.end()),
+                                                std::move(query));
+        return true;
+    };
+    // Diffs select the differences between two documents as matches.
+    const Node *diffLeft = nullptr;
+    const Node *diffRight = nullptr;
+    auto startDiff = [&](const Node *left, const Node *right) {
+        auto fileName = [](const Node *root) {
+            std::string label = nodeKey(root);
+            return label.substr(label.find_last_of('/') + 1);
+        };
+        searchJob.reset();
+        diffLeft = left;
+        diffRight = right;
+        search.term = fileName(left) + " vs " + fileName(right);
+        search.mode = SearchState::Mode::Diff;
+        search.clearMatches();
+        search.currentIndex = 0;
+        search.inProgress = true;
+        jumpToFirstMatch = true;
+        invalidateRowCache();
+        searchJob = std::make_unique<SearchJob>(left, right);
+    };
+
+    // Keys that do nothing but move the selection.  False for other keys.
+    auto moveSelection = [&](int key) {
+        size_t pageSize = static_cast<size_t>(std::max(getmaxy(stdscr) - 2, 1)); // less the status bar
+        switch (key)
+        {
+        case KEY_UP:
+        case 'k':
+            if (selected > 0)
+                --selected;
+            return true;
+        case KEY_DOWN:
+        case 'j':
+            if (selected + 1 < visible.size())
+                ++selected;
+            return true;
+        case KEY_NPAGE:
+            selected = std::min(selected + pageSize, visible.size() - 1);
+            return true;
+        case KEY_PPAGE:
+            selected -= std::min(selected, pageSize);
+            return true;
+        case KEY_HOME:
+            selected = 0;
+            return true;
+        case KEY_END:
+            selected = visible.size() - 1;
+            return true;
+        default:
+            return false;
+        }
+    };
+    auto moveByRows = [&](long rows) {
+        if (rows < 0)
+            selected -= std::min(selected, static_cast<size_t>(-rows));
+        else
+            selected = std::min(selected + static_cast<size_t>(rows), visible.size() - 1);
+    };
+    // After a movement key, apply the movement keys and wheel events that
+    // are already waiting or arrive before the next frame is due, so a
+    // held key or a spun wheel draws at most one frame per
+    // kFrameIntervalMs however slowly frames draw, and that frame shows
+    // where the selection ended up.  Any other key is left for the next
+    // pass of the loop, after the frame.
+    std::chrono::steady_clock::time_point lastFrame;
+    auto coalesceMoves = [&]() {
+        for (;;)
+        {
+            auto due = lastFrame + std::chrono::milliseconds(kFrameIntervalMs) - std::chrono::steady_clock::now();
+            timeout(std::max(0, static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(due).count())));
+            int next = getch();
+            if (next == ERR)
+                return;
+            if (next == KEY_MOUSE)
+            {
+                MEVENT ev;
+                if (getmouse(&ev) != OK)
+                    continue;
+                if (long wheel = wheelRows(ev))
+                {
+                    moveByRows(wheel);
+                    continue;
+                }
+                ungetmouse(&ev);
+                return;
+            }
+            if (!moveSelection(next))
+            {
+                ungetch(next);
+                return;
+            }
+        }
+    };
 
     // Main loop
     bool running = true;
+    bool quitRequested = false;
     while (running)
     {
-        // Collect visible nodes
-        visible.clear();
-        for (auto &r : roots)
+        // Show documents as soon as the loader has finished them
+        if (!loader.done())
+        {
+            for (LoadedDocument &loaded : loader.takeFinished())
+            {
+                adoptDocument(loaded);
+                needFullRedraw = true;
+            }
+            loadStatusMessage = loader.done() ? std::string() : formatLoadProgress(loader);
+        }
+        if (searchJob)
+        {
+            if (searchJob->collect(search))
+            {
+                if (jumpToFirstMatch)
+                {
+                    // Jump to first match
+                    Node *match = const_cast<Node *>(search.matches[0]);
+                    expandPath(match);
+                    selected = visible.indexOf(match);
+                    jumpToFirstMatch = false;
+                }
+                invalidateRowCache(); // root labels show match counts
+                needFullRedraw = true; // New matches need highlighting
+            }
+            if (searchJob->finished())
+            {
+                searchJob.reset();
+                search.inProgress = false;
+                needFullRedraw = true;
+            }
+        }
+        finishStats();
+        // Add the records appended to followed files.  The trees are left
+        // alone while a search or count reads them; the watchers keep their
+        // events.
+        size_t appendedFrom = SIZE_MAX; // first row that changed
+        std::vector<size_t> relabelledRows; // roots whose record count changed
+        if (!searchJob && !statsJob)
         {
-            collectVisible(r.get(), visible);
+            for (FollowedFile &file : followed)
+            {
+                if (!file.watcher->changed() && !file.recheck)
+                    continue;
+                file.recheck = false;
+                NodeTree &tree = *file.tree;
+                InputBuffer grown;
+                std::string error;
+                if (!grown.openFile(file.watcher->path(), error) || grown.size() <= tree.text().size())
+                    continue;
+                Node *root = tree.root();
+                bool atEnd = selected + 1 == visible.size();
+                size_t rootRow = visible.indexOf(root);
+                // The last row of the root may be a record still being written
+                size_t firstRow = rootRow + root->visibleCount - 1;
+                // Only the root and the last record, which may be read
+                // again, need counting anew
+                subtreeStats.forgetRecords(tree, tree.recordCount() ? tree.recordCount() - 1 : 0);
+                if (statsDone && NodeTree::owner(statsDone->node()) == &tree)
+                    statsDone.reset();
+                bool moved = false;
+                bool released = false;
+                tree.appendLines(std::move(grown), moved, released);
+                if (moved || released)
+                    expansion.reset();
+                fileSizes[tree.label()] = tree.text().size();
+                invalidateRowCache();
+                relabelledRows.push_back(rootRow);
+                appendedFrom = std::min(appendedFrom, firstRow);
+                if ((moved || released) && !search.term.empty())
+                {
+                    // Matches pointed into the old records or the one read
+                    // again; find them again without moving the selection.
+                    std::string error;
+                    if (search.mode == SearchState::Mode::Diff)
+                        startDiff(diffLeft, diffRight);
+                    else if (search.mode == SearchState::Mode::Query)
+                        startQuery(search.term, error);
+                    else
+                        startSearch(search.term, search.searchKeys, search.searchValues);
+                    jumpToFirstMatch = false;
+                }
+                // Like tail -f, a selection on the last row stays there
+                if (atEnd)
+                    selected = visible.size() - 1;
+            }
         }
         if (visible.empty())
         {
-            // Should never happen
-            mvprintw(0, 0, "No data to display");
+            // Nothing to browse yet: show progress until the first document
+            // arrives, or give up once every input has failed.
+            if (loader.done())
+                break;
+            int rows, cols;
+            getmaxyx(stdscr, rows, cols);
+            erase();
+            drawStatusBar(rows - 1, 0, visible, search, cols, colours);
             refresh();
-            getch();
-            break;
+            loader.waitReady(std::chrono::milliseconds(kLoadPollMs));
+            timeout(0);
+            int ch = getch();
+            if (ch == 'q' || ch == 'Q')
+            {
+                quitRequested = true;
+                running = false;
+            }
+            needFullRedraw = true;
+            continue;
         }
         // Constrain selected index
         if (selected >= visible.size())
             selected = visible.size() - 1;
 
+        // Count the selected subtree when its figures are wanted and not
+        // known yet; moving on cancels a count nobody waits for.
+        const Node *current = visible[selected];
+        bool statsWanted = subtreeStatsShown && !subtreeStats.find(current);
+        bool panelWanted = statsPanelFor == current && !(statsDone && statsDone->node() == current);
+        if (!statsWanted && !panelWanted)
+            statsJob.reset();
+        else if (!statsJob || statsJob->node() != current)
+        {
+            statsJob = std::make_unique<StatsJob>(current, subtreeStats);
+            finishStats();
+        }
+        if (!subtreeStatsShown)
+            subtreeStatsMessage.clear();
+        else if (const SubtreeStats *found = subtreeStats.find(current))
+            subtreeStatsMessage = formatSubtreeStats(*found);
+        else
+            subtreeStatsMessage = "[counting " + std::to_string(static_cast<int>(statsJob->progress() * 100)) + "%]";
+
         // Get screen dimensions
         int rows, cols;
         getmaxyx(stdscr, rows, cols);
@@ -1056,7 +1820,11 @@ int main(int argc, char **argv)
             scrollDirection = (scrollAmount > 0) ? 1 : -1;
         }
         scrollOffset = newScrollOffset;
+        // Appended rows are drawn on their own only when nothing else moved
+        if (appendedFrom != SIZE_MAX && (scrollChanged || needPartialRedraw || selected != previousSelected))
+            needFullRedraw = true;
 
+        PerfTimer frameTimer(PerfPhase::Draw);
         // Determine what kind of update we need
         if (needFullRedraw || (scrollChanged && previousScrollOffset == -1))
         {
@@ -1095,6 +1863,22 @@ int main(int argc, char **argv)
             }
             needPartialRedraw = false;
         }
+        else if (appendedFrom != SIZE_MAX)
+        {
+            // Records were appended: redraw the record counts in the root
+            // labels and every row from the first new record downwards.
+            int startRow = std::max(0, (int)appendedFrom - scrollOffset);
+            for (size_t row : relabelledRows)
+            {
+                int screenRow = (int)row - scrollOffset;
+                if (screenRow >= 0 && screenRow < startRow && screenRow < displayRows)
+                    drawLine(screenRow, row, visible[row], selected, search, cols, colours);
+            }
+            if (startRow < displayRows)
+                drawFromRowDownwards(startRow, scrollOffset, visible, selected, search, rows, cols, colours);
+            else
+                drawStatusBar(rows - 1, selected, visible, search, cols, colours);
+        }
         else if (scrollChanged && abs(scrollAmount) < displayRows)
         {
             // Optimized scrolling - scroll existing content and draw new lines
@@ -1223,6 +2007,38 @@ int main(int argc, char **argv)
         previousScrollOffset = scrollOffset;
 
         refresh();
+        frameTimer.stop();
+        lastFrame = std::chrono::steady_clock::now();
+
+        // Under --max-memory, values parsed for rows that are no longer on
+        // screen are dropped again, least recently shown first, once the
+        // trees outgrow the budget.  A quarter is kept free so this does
+        // not run on every frame.
+        if (memoryBudget)
+        {
+            ++frame;
+            for (int i = 0; i < displayRows && scrollOffset + i < (int)visible.size(); ++i)
+            {
+                const Node *node = visible[scrollOffset + i];
+                NodeTree::owner(node)->touch(node, frame);
+            }
+            std::vector<NodeTree *> budgeted;
+            size_t used = 0;
+            for (const auto &tree : trees)
+            {
+                budgeted.push_back(tree.get());
+                used += tree->memoryUse();
+            }
+            if (used > memoryBudget && !searchJob && !statsJob &&
+                NodeTree::evictCold(budgeted, memoryBudget / 4 * 3, frame, search) > 0)
+            {
+                invalidateRowCache();
+                // Released nodes may come back as different ones
+                subtreeStats.nodes.clear();
+                statsDone.reset();
+                statsPanelFor = nullptr;
+            }
+        }
 
         // Use non-blocking input when a transient status is active so it can expire
         if (hasTransientStatus())
@@ -1232,8 +2048,20 @@ int main(int argc, char **argv)
             int wait_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
             if (wait_ms < 1)
                 wait_ms = 1;
+            if ((!loader.done() || searchJob || statsJob) && wait_ms > kLoadPollMs)
+                wait_ms = kLoadPollMs;
+            if (!followed.empty() && wait_ms > kFollowPollMs)
+                wait_ms = kFollowPollMs;
             timeout(wait_ms);
         }
+        else if (!loader.done() || searchJob || statsJob)
+        {
+            timeout(kLoadPollMs); // wake up to refresh load, search or count progress
+        }
+        else if (!followed.empty())
+        {
+            timeout(kFollowPollMs); // wake up to look at followed files
+        }
         else
         {
             timeout(-1); // blocking
@@ -1241,6 +2069,11 @@ int main(int argc, char **argv)
 
         // Process input
         int ch = getch();
+        // Moving around keeps a stopped expansion; anything else might
+        // collapse what it still has to visit.
+        if (expansion && ch != expansionKey && ch != ERR && ch != KEY_UP && ch != KEY_DOWN && ch != KEY_PPAGE &&
+            ch != KEY_NPAGE && ch != KEY_HOME && ch != KEY_END && ch != KEY_RESIZE && ch != 'j' && ch != 'k')
+            expansion.reset();
         switch (ch)
         {
         case KEY_MOUSE:
@@ -1251,7 +2084,12 @@ int main(int argc, char **argv)
                 int rows, cols;
                 getmaxyx(stdscr, rows, cols);
                 int displayRows = rows - 1;
-                if (ev.bstate & BUTTON1_DOUBLE_CLICKED)
+                if (long wheel = wheelRows(ev))
+                {
+                    moveByRows(wheel);
+                    coalesceMoves();
+                }
+                else if (ev.bstate & BUTTON1_DOUBLE_CLICKED)
                 {
                     if (ev.y < displayRows)
                     {
@@ -1260,9 +2098,9 @@ int main(int argc, char **argv)
                         {
                             selected = idx;
                             Node *n = const_cast<Node *>(visible[selected]);
-                            if (!n->children.empty())
+                            if (hasChildren(n))
                             {
-                                n->expanded = !n->expanded;
+                                setExpanded(n, !n->expanded);
                                 needPartialRedraw = true;
                             }
                         }
@@ -1278,9 +2116,9 @@ int main(int argc, char **argv)
                             selected = idx;
                             Node *n = const_cast<Node *>(visible[selected]);
                             int prefixClick = getDisplayWidth(buildPrefix(n)) + 2;
-                            if (ev.x < prefixClick && !n->children.empty())
+                            if (ev.x < prefixClick && hasChildren(n))
                             {
-                                n->expanded = !n->expanded;
+                                setExpanded(n, !n->expanded);
                                 needPartialRedraw = true;
                             }
                         }
@@ -1302,58 +2140,28 @@ int main(int argc, char **argv)
         break;
         case KEY_UP:
         case 'k':
-            if (selected > 0)
-                --selected;
-            break;
         case KEY_DOWN:
         case 'j':
-            if (selected + 1 < visible.size())
-                ++selected;
-            break;
         case KEY_NPAGE: // Page Down
-        {
-            int rows, cols;
-            getmaxyx(stdscr, rows, cols);
-            int pageSize = rows - 2; // Reserve space for status bar
-            selected = std::min(selected + static_cast<size_t>(pageSize), visible.size() - 1);
-        }
-        break;
         case KEY_PPAGE: // Page Up
-        {
-            int rows, cols;
-            getmaxyx(stdscr, rows, cols);
-            int pageSize = rows - 2; // Reserve space for status bar
-            selected = (selected >= static_cast<size_t>(pageSize)) ? selected - pageSize : 0;
-        }
-        break;
-        case KEY_HOME: // Home/Pos1
-            selected = 0;
-            break;
-        case KEY_END: // End
-            selected = visible.size() - 1;
+        case KEY_HOME:  // Home/Pos1
+        case KEY_END:   // End
+            moveSelection(ch);
+            coalesceMoves();
             break;
         case KEY_LEFT:
         case 'h':
         {
             Node *n = const_cast<Node *>(visible[selected]);
-            if (n->expanded && !n->children.empty())
+            if (n->expanded && hasChildren(n))
             {
-                n->expanded = false;
+                setExpanded(n, false);
                 needPartialRedraw = true; // Only redraw from current line downwards
             }
             else if (n->parent != nullptr)
             {
                 // Move to parent
-                const Node *parent = n->parent;
-                // Find parent index in visible list
-                for (size_t i = 0; i < visible.size(); ++i)
-                {
-                    if (visible[i] == parent)
-                    {
-                        selected = i;
-                        break;
-                    }
-                }
+                selected = visible.indexOf(n->parent);
             }
         }
         break;
@@ -1361,19 +2169,21 @@ int main(int argc, char **argv)
         case 'l':
         {
             Node *n = const_cast<Node *>(visible[selected]);
-            if (!n->children.empty())
+            if (hasChildren(n))
             {
-                n->expanded = true;
+                setExpanded(n, true);
                 needPartialRedraw = true; // Only redraw from current line downwards
             }
         }
         break;
         case '+':
         case '=':
-            for (auto &r : roots)
+            if (!expansion || ch != expansionKey)
             {
-                expandAll(r.get());
+                expansion = std::make_unique<Expansion>(roots);
+                expansionKey = ch;
             }
+            runExpansion();
             needFullRedraw = true; // Tree structure changed significantly
             break;
         case '-':
@@ -1389,7 +2199,7 @@ int main(int argc, char **argv)
             // Collapse all nodes but preserve path to selected node
             for (auto &r : roots)
             {
-                collapseAll(r.get(), true);
+                collapseAll(r, true);
             }
 
             // Ensure the path to the selected node remains expanded
@@ -1397,22 +2207,7 @@ int main(int argc, char **argv)
             {
                 expandPath(const_cast<Node *>(selectedNode));
 
-                // Rebuild visible list and find new selection index
-                visible.clear();
-                for (auto &r : roots)
-                {
-                    collectVisible(r.get(), visible);
-                }
-
-                // Find the selected node in the new visible list
-                for (size_t i = 0; i < visible.size(); ++i)
-                {
-                    if (visible[i] == selectedNode)
-                    {
-                        selected = i;
-                        break;
-                    }
-                }
+                selected = visible.indexOf(selectedNode);
             }
             needFullRedraw = true; // Tree structure changed significantly
         }
@@ -1439,10 +2234,12 @@ int main(int argc, char **argv)
             }
 
             // Apply expansion level to all roots
-            for (auto &r : roots)
+            if (!expansion || ch != expansionKey)
             {
-                expandToLevel(r.get(), level, 0);
+                expansion = std::make_unique<Expansion>(roots, level);
+                expansionKey = ch;
             }
+            runExpansion();
 
             // Ensure the path to the selected node remains visible if possible
             if (selectedNode != nullptr)
@@ -1464,23 +2261,10 @@ int main(int argc, char **argv)
                     expandPath(const_cast<Node *>(selectedNode));
                 }
 
-                // Rebuild visible list and find new selection index
-                visible.clear();
-                for (auto &r : roots)
-                {
-                    collectVisible(r.get(), visible);
-                }
-
-                // Find the selected node in the new visible list, or keep it at 0 if not found
-                selected = 0;
-                for (size_t i = 0; i < visible.size(); ++i)
-                {
-                    if (visible[i] == selectedNode)
-                    {
-                        selected = i;
-                        break;
-                    }
-                }
+                // Find the selected node's new row, or fall back to 0 if it is hidden
+                selected = visible.indexOf(selectedNode);
+                if (selected == VisibleRows::npos)
+                    selected = 0;
             }
             needFullRedraw = true; // Tree structure changed significantly
         }
@@ -1489,95 +2273,76 @@ int main(int argc, char **argv)
         case '/':
         {
             std::string term = promptSearch("Search key: ");
-            // Lowercase the term for case‑insensitive comparison
-            std::string lower = term;
-            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-            search.term = lower;
-            search.searchKeys = true;
-            search.searchValues = false;
-            search.matches.clear();
-            search.currentIndex = 0;
-            for (auto &r : roots)
-            {
-                searchTree(r.get(), lower, true, false, search.matches);
-            }
-            if (!search.matches.empty())
-            {
-                // Jump to first match
-                Node *match = const_cast<Node *>(search.matches[0]);
-                expandPath(match);
-                // Update visible list and selected index
-                visible.clear();
-                for (auto &r : roots)
-                    collectVisible(r.get(), visible);
-                for (size_t i = 0; i < visible.size(); ++i)
-                {
-                    if (visible[i] == match)
-                    {
-                        selected = i;
-                        break;
-                    }
-                }
-            }
+            startSearch(term, true, false);
             needFullRedraw = true; // Search changed display state
         }
         break;
         case 'S':
         {
             std::string term = promptSearch("Search value: ");
-            std::string lower = term;
-            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-            search.term = lower;
-            search.searchKeys = false;
-            search.searchValues = true;
-            search.matches.clear();
-            search.currentIndex = 0;
-            for (auto &r : roots)
+            startSearch(term, false, true);
+            needFullRedraw = true; // Search changed display state
+        }
+        break;
+        case 'f':
+        {
+            // A JSON Pointer jumps within the selected document; a JSONPath
+            // query selects matches in all of them.
+            std::string text = promptSearch("Query ($.path or /pointer): ");
+            std::string error;
+            if (text.empty())
             {
-                searchTree(r.get(), lower, false, true, search.matches);
+                // Cancelled
             }
-            if (!search.matches.empty())
+            else if (text[0] == '/' && selected < visible.size())
             {
-                Node *match = const_cast<Node *>(search.matches[0]);
-                expandPath(match);
-                visible.clear();
-                for (auto &r : roots)
-                    collectVisible(r.get(), visible);
-                for (size_t i = 0; i < visible.size(); ++i)
+                const Node *root = visible[selected];
+                while (root->parent)
+                    root = root->parent;
+                if (const Node *target = resolvePointer(root, text, error))
                 {
-                    if (visible[i] == match)
-                    {
-                        selected = i;
-                        break;
-                    }
+                    expandPath(const_cast<Node *>(target));
+                    selected = visible.indexOf(target);
                 }
+                else
+                    showTransientStatus(error, 3000);
             }
-            needFullRedraw = true; // Search changed display state
+            else if (!startQuery(text, error))
+                showTransientStatus("Invalid query: " + error, 5000);
+            needFullRedraw = true;
         }
         break;
+        case 'd':
+            // Compare the selected document with the next one (or, for the
+            // last, the one before it)
+            if (roots.size() < 2)
+                showTransientStatus("Open two documents to compare them", 3000);
+            else if (selected < visible.size())
+            {
+                const Node *root = visible[selected];
+                while (root->parent)
+                    root = root->parent;
+                size_t index = std::find(roots.begin(), roots.end(), root) - roots.begin();
+                if (index + 1 < roots.size())
+                    startDiff(roots[index], roots[index + 1]);
+                else
+                    startDiff(roots[index - 1], roots[index]);
+            }
+            needFullRedraw = true;
+            break;
         case 'n':
             if (!search.term.empty() && !search.matches.empty())
             {
                 const Node *currentNode = visible[selected];
-                auto it = std::find(search.matches.begin(), search.matches.end(), currentNode);
-                if (it != search.matches.end())
+                size_t position = search.matchPosition(currentNode);
+                if (position != SearchState::npos)
                 {
-                    search.currentIndex = std::distance(search.matches.begin(), it);
+                    search.currentIndex = static_cast<int>(position);
                 }
                 search.currentIndex = (search.currentIndex + 1) % search.matches.size();
                 Node *nextMatch = const_cast<Node *>(search.matches[search.currentIndex]);
                 expandPath(nextMatch);
-                visible.clear();
-                for (auto &r : roots)
-                    collectVisible(r.get(), visible);
-                for (size_t i = 0; i < visible.size(); ++i)
-                {
-                    if (visible[i] == nextMatch)
-                    {
-                        selected = i;
-                        break;
-                    }
-                }
+                selected = visible.indexOf(nextMatch);
                 needFullRedraw = true; // Tree expansion may have changed
             }
             break;
@@ -1585,35 +2350,66 @@ int main(int argc, char **argv)
             if (!search.term.empty() && !search.matches.empty())
             {
                 const Node *currentNode = visible[selected];
-                auto it = std::find(search.matches.begin(), search.matches.end(), currentNode);
-                if (it != search.matches.end())
+                size_t position = search.matchPosition(currentNode);
+                if (position != SearchState::npos)
                 {
-                    search.currentIndex = std::distance(search.matches.begin(), it);
+                    search.currentIndex = static_cast<int>(position);
                 }
                 search.currentIndex = (search.currentIndex - 1 + search.matches.size()) % search.matches.size();
                 Node *prevMatch = const_cast<Node *>(search.matches[search.currentIndex]);
                 expandPath(prevMatch);
-                visible.clear();
-                for (auto &r : roots)
-                    collectVisible(r.get(), visible);
-                for (size_t i = 0; i < visible.size(); ++i)
-                {
-                    if (visible[i] == prevMatch)
-                    {
-                        selected = i;
-                        break;
-                    }
-                }
+                selected = visible.indexOf(prevMatch);
                 needFullRedraw = true; // Tree expansion may have changed
             }
             break;
+        case 27: // Esc
+            // Stop a running search, keeping the matches found so far
+            if (searchJob)
+            {
+                searchJob->cancel();
+                searchJob.reset();
+                search.inProgress = false;
+                needFullRedraw = true;
+            }
+            break;
         case 'c':
             // Clear search
+            searchJob.reset();
+            search.inProgress = false;
             search.term.clear();
-            search.matches.clear();
+            search.clearMatches();
+            invalidateRowCache();
             search.currentIndex = 0;
             needFullRedraw = true; // Search highlights need to be cleared
             break;
+        case 'g':
+            // Jump to a top-level item by its index; the records of a
+            // line-delimited document are indexed, so any one is a direct hop
+            if (selected < visible.size())
+            {
+                std::string answer = promptSearch("Go to item: ");
+                Node *root = const_cast<Node *>(visible[selected]);
+                while (root->parent)
+                    root = root->parent;
+                size_t index = 0;
+                auto [end, ec] = std::from_chars(answer.data(), answer.data() + answer.size(), index);
+                if (answer.empty())
+                {
+                    // Cancelled
+                }
+                else if (ec != std::errc() || end != answer.data() + answer.size() || !hasChildren(root) ||
+                         index >= ensureChildren(root).size())
+                {
+                    showTransientStatus("No item " + answer + " in " + nodeKey(root), 3000);
+                }
+                else
+                {
+                    setExpanded(root, true);
+                    selected = visible.indexOf(&ensureChildren(root)[index]);
+                }
+                needFullRedraw = true;
+            }
+            break;
         case 't':
         {
             currentScheme = static_cast<ColorScheme::SchemeId>((static_cast<int>(currentScheme) + 1) % ColorScheme::COUNT);
@@ -1630,17 +2426,59 @@ int main(int argc, char **argv)
             if (selected < visible.size())
             {
                 const Node *selectedNode = visible[selected];
-                json jsonData = reconstructJson(selectedNode);
-                std::string jsonStr = jsonData.dump(2); // Pretty-print with 2-space indentation
-
-                copyToClipboard(jsonStr);
-
-                // Queue a transient status message (3s) without blocking input
-                std::string message = getClipboardStatusMessage();
+                // Serialized straight into the clipboard, with progress
+                // for large selections
+                std::string message = copyToClipboard(selectedNode, [](size_t bytes) {
+                    std::string status = "[copying " + formatFileSize(bytes) + "]";
+                    mvaddnstr(getmaxy(stdscr) - 1, 0, status.c_str(), static_cast<int>(status.size()));
+                    clrtoeol();
+                    refresh();
+                });
                 showTransientStatus(message, 3000);
                 needFullRedraw = true;
             }
             break;
+        case 'v':
+            if (selected < visible.size())
+            {
+                const Node *node = visible[selected];
+                const json *v = hasChildren(node) ? nullptr : nodeValue(node);
+                if (v)
+                {
+                    std::string dumped = v->is_string() ? std::string() : v->dump();
+                    std::string_view text = v->is_string() ? std::string_view(v->get_ref<const std::string &>()) : dumped;
+                    showValuePager(nodeKey(node) + " (" + formatFileSize(text.size()) + ")", text);
+                }
+                else
+                    showTransientStatus("Only values can be viewed; expand containers with →", 3000);
+                needFullRedraw = true;
+            }
+            break;
+        case 'i':
+            subtreeStatsShown = !subtreeStatsShown;
+            break;
+        case 'I':
+            if (selected < visible.size())
+            {
+                const Node *node = visible[selected];
+                if (statsDone && statsDone->node() == node)
+                    showStatsPanel(nodeKey(node), *statsDone);
+                else
+                {
+                    // Opens by itself once counted
+                    statsPanelFor = node;
+                    subtreeStatsShown = true;
+                }
+                needFullRedraw = true;
+            }
+            break;
+        case 'P':
+            // Collecting starts with the first look at the figures
+            statsOverlay = !statsOverlay;
+            if (statsOverlay)
+                perfStats.enable();
+            needFullRedraw = true;
+            break;
         case '?':
             showHelp();
             needFullRedraw = true; // Help dialog changed the screen
@@ -1654,6 +2492,7 @@ int main(int argc, char **argv)
             break;
         case 'q':
         case 'Q':
+            quitRequested = true;
             running = false;
             break;
         default:
@@ -1662,7 +2501,17 @@ int main(int argc, char **argv)
     }
     // End curses mode
     endwin();
+    for (const std::string &message : loadErrors)
+    {
+        std::cerr << message << std::endl;
+    }
+    // If nothing was parsed there is nothing to display
+    if (roots.empty() && !quitRequested)
+    {
+        std::cerr << "No valid JSON documents provided." << std::endl;
+        return 1;
+    }
     // Free nodes
-    // unique_ptr takes care of cleanup of the entire tree
+    // Each NodeTree releases its arena in one go
     return 0;
 }
@@ -3,6 +3,8 @@
 
 #include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -11,812 +13,6548 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <optional>
 #include <deque>
 #include <cmath>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <wchar.h>
+#include <wctype.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#include <sys/event.h>
+#define JSON_VIEW_KQUEUE 1
+#endif
+#ifdef JSON_VIEW_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef JSON_VIEW_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 std::map<std::string, size_t> fileSizes;
+KeyTable keyTable;
 
-// Calculate the display width of a UTF-8 string (handles Unicode properly)
-int getDisplayWidth(const std::string &str)
+// Calculate the display width of a UTF-8 string (handles Unicode properly).
+// Pure ASCII text is one column per byte and is answered without decoding;
+// anything else is decoded one character at a time, without allocating.
+int getDisplayWidth(std::string_view str)
 {
-    // Convert UTF-8 string to wide character string
-    size_t len = str.length();
-    wchar_t *wstr = new wchar_t[len + 1];
+    size_t i = 0;
+    const size_t len = str.length();
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, str.data() + i, sizeof(word));
+        // Stop at the first word holding a non-ASCII or NUL byte.
+        uint64_t zeroBytes = (word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL;
+        if ((word & 0x8080808080808080ULL) || zeroBytes)
+            break;
+    }
+    while (i < len && str[i] != '\0' && !(static_cast<unsigned char>(str[i]) & 0x80))
+        ++i;
+    if (i == len)
+        return static_cast<int>(len);
 
-    // Convert UTF-8 to wide characters
-    size_t result = mbstowcs(wstr, str.c_str(), len);
-    if (result == (size_t)-1)
+    // Convert UTF-8 to wide characters and sum their display widths
+    std::mbstate_t state{};
+    int width = 0;
+    const char *p = str.data();
+    const char *end = p + len;
+    while (p < end)
     {
-        // Conversion failed, fall back to byte length
-        delete[] wstr;
-        return str.length();
+        wchar_t wc;
+        size_t n = mbrtowc(&wc, p, static_cast<size_t>(end - p), &state);
+        if (n == 0)
+            break;
+        if (n == (size_t)-1 || n == (size_t)-2)
+        {
+            // Conversion failed, fall back to byte length
+            return static_cast<int>(len);
+        }
+        int w = wcwidth(wc);
+        // wcwidth returns -1 for unprintable characters, fall back to byte length
+        if (w < 0)
+            return static_cast<int>(len);
+        width += w;
+        p += n;
     }
-    wstr[result] = L'\0';
+    return width;
+}
+
+// Parsers report their position every kProgressStride bytes.
+static constexpr uintptr_t kProgressStride = 64 * 1024;
+
+// Every block of nodes is preceded by a header naming the tree that owns
+// it.  A node finds its block through its parent (or is the root block),
+// so no per-node back pointer is needed.
+namespace
+{
+struct alignas(Node) NodeBlockHeader
+{
+    NodeTree *tree;
+    // Fenwick tree over the children's visibleCount (1-based, count + 1
+    // entries) for blocks wide enough that a linear scan would hurt.
+    uint64_t *fenwick;
+    // Byte spans of the nodes of a block built from an indexed document.
+    ValueSpan *spans;
+    // Nodes allocated, which is more than the parent's childCount only for
+    // the records of a file being followed.  Unused Fenwick entries are 0.
+    size_t capacity;
+};
 
-    // Get display width
-    int width = wcswidth(wstr, result);
-    delete[] wstr;
+constexpr size_t kFenwickMinBlock = 64;
 
-    // wcswidth returns -1 for unprintable characters, fall back to byte length
-    return (width >= 0) ? width : str.length();
+NodeBlockHeader &blockHeader(const Node *block)
+{
+    return const_cast<NodeBlockHeader *>(reinterpret_cast<const NodeBlockHeader *>(block))[-1];
 }
 
-// Build a tree of Node objects mirroring the structure of a JSON
-// document.  Each Node stores a pointer to the original JSON value.
-std::unique_ptr<Node> buildTree(const json *j, const std::string &key,
-                                       Node *parent, bool dummy)
+// The span of a node of an indexed document, or null.
+ValueSpan *nodeSpan(const Node *node)
 {
-    auto node = std::make_unique<Node>();
-    node->value = j;
-    node->parent = parent;
-    node->key = key;
-    node->isDummyRoot = dummy;
-    // Root nodes are expanded by default so the top‑level structure is visible.
-    node->expanded = dummy;
-    // Recursively create children for objects and arrays.  Primitive
-    // values have no children.
-    if (j->is_object())
+    const Node *block = node->parent ? node->parent->children : node;
+    ValueSpan *spans = blockHeader(block).spans;
+    return spans ? &spans[node - block] : nullptr;
+}
+} // namespace
+
+// Structural scanning of indexed documents.  A container is split into its
+// direct members by looking only at quotes, brackets, braces, commas and
+// colons, 16 bytes at a time where the CPU allows.  The scanner trusts its
+// input; values are validated when they are parsed.
+namespace
+{
+// Values up to this size are parsed whole when first looked at; larger
+// containers are only ever scanned.
+constexpr size_t kParseWholeLimit = 64 * 1024;
+
+// A parsed DOM takes several times the size of its source text.
+constexpr size_t kDomBytesPerInputByte = 8;
+
+struct SpanMember
+{
+    std::string key;
+    ValueSpan span;
+};
+
+bool isJsonSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isStructural(char c)
+{
+    // '[' and ']' differ from '{' and '}' only in bit 5.
+    char folded = static_cast<char>(c | 0x20);
+    return c == '"' || c == ',' || c == ':' || folded == '{' || folded == '}';
+}
+
+// Position of the first structural byte at or after pos, or end.
+size_t findStructural(const char *data, size_t pos, size_t end)
+{
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i bit5 = _mm_set1_epi8(0x20);
+    for (; pos + 16 <= end; pos += 16)
     {
-        node->children.reserve(j->size());
-        for (auto it = j->begin(); it != j->end(); ++it)
-        {
-            const std::string &childKey = it.key();
-            const json &childVal = it.value();
-            auto child = buildTree(&childVal, childKey, node.get(), false);
-            node->children.push_back(std::move(child));
-        }
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+        __m128i folded = _mm_or_si128(v, bit5);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, comma)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, colon),
+                                                _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close))));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask)
+            return pos + static_cast<unsigned>(__builtin_ctz(mask));
     }
-    else if (j->is_array())
+#elif defined(__ARM_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t comma = vdupq_n_u8(',');
+    const uint8x16_t colon = vdupq_n_u8(':');
+    const uint8x16_t open = vdupq_n_u8('{');
+    const uint8x16_t close = vdupq_n_u8('}');
+    const uint8x16_t bit5 = vdupq_n_u8(0x20);
+    for (; pos + 16 <= end; pos += 16)
     {
-        node->children.reserve(j->size());
-        int idx = 0;
-        for (auto it = j->begin(); it != j->end(); ++it, ++idx)
-        {
-            std::string childKey = "[" + std::to_string(idx) + "]";
-            auto child = buildTree(&(*it), childKey, node.get(), false);
-            node->children.push_back(std::move(child));
-        }
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(data + pos));
+        uint8x16_t folded = vorrq_u8(v, bit5);
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, comma)),
+                                  vorrq_u8(vceqq_u8(v, colon), vorrq_u8(vceqq_u8(folded, open), vceqq_u8(folded, close))));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (mask)
+            return pos + (static_cast<unsigned>(__builtin_ctzll(mask)) >> 2);
     }
-    // Mark last child in the list.  This information is used to draw
-    // the tree branches correctly.
-    for (size_t i = 0; i < node->children.size(); ++i)
+#endif
+    for (; pos < end; ++pos)
     {
-        node->children[i]->isLastChild = (i == node->children.size() - 1);
+        if (isStructural(data[pos]))
+            return pos;
     }
-    return node;
+    return end;
 }
 
-// Recursively collect all nodes that are currently visible.  A node is
-// visible if it is a root or its parent is expanded.
-void collectVisible(const Node *node, std::vector<const Node *> &out)
+// Position of the first quote or backslash at or after pos, or end.
+size_t findQuoteOrEscape(const char *data, size_t pos, size_t end)
 {
-    out.push_back(node);
-    if (node->expanded)
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; pos + 16 <= end; pos += 16)
     {
-        for (const auto &child : node->children)
-        {
-            collectVisible(child.get(), out);
-        }
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash))));
+        if (mask)
+            return pos + static_cast<unsigned>(__builtin_ctz(mask));
     }
-}
-
-// Build the tree prefix for a node.  This string contains the
-// vertical bar and branch characters needed to draw a proper tree.
-std::string buildPrefix(const Node *node)
-{
-    std::string prefix;
-    const Node *cur = node;
-    while (cur->parent != nullptr)
+#elif defined(__ARM_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    for (; pos + 16 <= end; pos += 16)
     {
-        const Node *parent = cur->parent;
-        // skip the dummy root (it has no parent) so its isLastChild flag
-        // doesn’t affect vertical lines for deeper levels
-        if (parent->parent != nullptr)
-        {
-            if (!parent->isLastChild)
-            {
-                prefix = std::string("│   ") + prefix;
-            }
-            else
-            {
-                prefix = std::string("    ") + prefix;
-            }
-        }
-        cur = parent;
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(data + pos));
+        uint8x16_t hit = vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (mask)
+            return pos + (static_cast<unsigned>(__builtin_ctzll(mask)) >> 2);
     }
-    if (node->parent != nullptr)
+#endif
+    for (; pos < end; ++pos)
     {
-        prefix += node->isLastChild ? "└── " : "├── ";
+        if (data[pos] == '"' || data[pos] == '\\')
+            return pos;
     }
-    return prefix;
+    return end;
 }
 
-// Shorten a file path to fit within maxWidth by replacing middle parts with "..."
-std::string shortenPath(const std::string &path, int maxWidth)
+// Position just past the string whose opening quote is at pos.
+size_t skipString(const char *data, size_t pos, size_t end)
 {
-    if (getDisplayWidth(path) <= maxWidth)
-    {
-        return path;
-    }
-
-    // Find the filename (last component)
-    size_t lastSlash = path.find_last_of('/');
-    if (lastSlash == std::string::npos)
+    for (pos = pos + 1;;)
     {
-        // No slash found, just truncate the string
-        return path.substr(0, maxWidth - 3) + "...";
-    }
-
-    std::string filename = path.substr(lastSlash + 1);
-    std::string directory = path.substr(0, lastSlash);
-
-    // If filename alone is too long, truncate it
-    if (getDisplayWidth(filename) > maxWidth - 4)
-    { // -4 for ".../"
-        return ".../" + filename.substr(0, maxWidth - 7) + "...";
+        pos = findQuoteOrEscape(data, pos, end);
+        if (pos >= end)
+            return end;
+        if (data[pos] == '"')
+            return pos + 1;
+        pos += 2;
     }
+}
 
-    // Calculate remaining space for directory
-    int remainingSpace = maxWidth - getDisplayWidth(filename) - 1; // -1 for the slash
-
-    if (getDisplayWidth(directory) <= remainingSpace)
+// Member name from its quoted text; only names with escapes need the parser.
+std::string decodeKey(std::string_view quoted)
+{
+    std::string_view raw = quoted.substr(1, quoted.size() >= 2 ? quoted.size() - 2 : 0);
+    if (raw.find('\\') == std::string_view::npos)
+        return std::string(raw);
+    try
     {
-        return path; // Original fits
+        return json::parse(quoted).get<std::string>();
     }
-
-    // Need to shorten directory part
-    // Strategy: keep start and end of path, replace middle with "..."
-    int prefixLen = std::max(1, remainingSpace / 3);
-    int suffixLen = std::max(1, remainingSpace - prefixLen - 3); // -3 for "..."
-
-    if (prefixLen + suffixLen + 3 >= getDisplayWidth(directory))
+    catch (const json::exception &)
     {
-        return path; // Would not actually shorten
+        return std::string(raw);
     }
-
-    std::string prefix = directory.substr(0, prefixLen);
-    std::string suffix = directory.substr(directory.length() - suffixLen);
-
-    return prefix + "..." + suffix + "/" + filename;
 }
 
-// Get the type icon for a node
-std::string getTypeIcon(const Node *node)
+bool isSpaceRun(const char *data, size_t begin, size_t end)
 {
-    const json *v = node->value;
-    if (node->isDummyRoot)
+    for (; begin < end; ++begin)
     {
-        return ""; // No icons for dummy roots
+        if (!isJsonSpace(data[begin]))
+            return false;
     }
-
-    if (v->is_string())
-        return "℀ ";
-    else if (v->is_boolean())
-        return v->get<bool>() ? "☒ " : "☐ ";
-    else if (v->is_number())
-        return "⅑ ";
-    else if (v->is_null())
-        return "⊘ ";
-    else if (v->is_object() && v->empty())
-        return "⁞ "; // Only for empty dictionaries
-    else if (v->is_array())
-        return ""; // No icon for arrays
-    else if (v->is_object())
-        return ""; // No icon for non-empty objects
-    return "";
+    return true;
 }
 
-// Get the content without type icon
-std::string getContentLabel(const Node *node, int maxWidth)
+// Walk the direct members of the container at span, calling
+// visit(quotedKey, valueSpan) for each in document order; quotedKey is
+// empty for array elements.  Returns false when the container is not
+// closed where the span ends.  When strictError is given, anything but
+// whitespace around the names, colons and commas (a missing name, an
+// empty element, a mismatched bracket) also fails, and the offset of the
+// problem is stored there; the values themselves are left to the parser.
+template <typename Visit>
+bool forEachMember(std::string_view text, const ValueSpan &span, Visit &&visit, ParseProgress *progress = nullptr,
+                   size_t *strictError = nullptr)
 {
-    const json *v = node->value;
-    if (node->isDummyRoot)
+    const char *data = text.data();
+    const size_t end = span.end;
+    const bool object = data[span.begin] == '{';
+    size_t depth = 0;
+    size_t valueStart = span.begin + 1;
+    size_t nextReport = span.begin + kProgressStride;
+    std::string_view key;
+    bool haveKey = false;
+    bool inValue = !object;
+    bool any = false;
+    auto fail = [&](size_t pos) {
+        if (strictError)
+            *strictError = pos;
+        return false;
+    };
+    for (size_t pos = span.begin + 1;;)
     {
-        std::string type;
-        if (v->is_object())
+        pos = findStructural(data, pos, end);
+        if (pos >= end)
+            return fail(end);
+        if (progress && pos >= nextReport)
         {
-            size_t count = v->size();
-            type = "📦 dictionary, " + std::to_string(count) + (count == 1 ? " key" : " keys");
+            progress->update(pos);
+            nextReport = pos + kProgressStride;
         }
-        else if (v->is_array())
+        char c = data[pos];
+        if (c == '"')
         {
-            size_t count = v->size();
-            type = "🗂️ list, " + std::to_string(count) + (count == 1 ? " item" : " items");
+            size_t after = skipString(data, pos, end);
+            if (depth == 0 && !inValue)
+            {
+                if (strictError && (haveKey || !isSpaceRun(data, valueStart, pos)))
+                    return fail(pos);
+                if (!haveKey)
+                    key = text.substr(pos, after - pos);
+                haveKey = true;
+                valueStart = after;
+            }
+            pos = after;
+            continue;
         }
-        else if (v->is_string())
-            type = "℀ string";
-        else if (v->is_number())
-            type = "⅑ number";
-        else if (v->is_boolean())
-            type = "☒ boolean";
-        else if (v->is_null())
-            type = "⊘ null";
-        else
-            type = "📄 value";
-
-        // Add file size information from stored file sizes
-        auto it = fileSizes.find(node->key);
-        if (it != fileSizes.end())
+        if (c == '{' || c == '[')
         {
-            std::string fileSizeStr = formatFileSize(it->second);
-            type += ", " + fileSizeStr;
+            if (strictError && depth == 0 && !inValue)
+                return fail(pos);
+            ++depth;
+            ++pos;
+            continue;
         }
-
-        // Shorten the filename for display
-        std::string shortKey = shortenPath(node->key, maxWidth - getDisplayWidth(type) - 4); // -4 for " ()"
-        return shortKey + " (" + type + ")";
+        if (depth > 0)
+        {
+            if (c == '}' || c == ']')
+                --depth;
+            ++pos;
+            continue;
+        }
+        if (c == ':')
+        {
+            if (strictError && (inValue || !haveKey || !isSpaceRun(data, valueStart, pos)))
+                return fail(pos);
+            inValue = true;
+            valueStart = ++pos;
+            continue;
+        }
+        // A comma or the closing bracket ends the current member.
+        size_t valueEnd = pos;
+        while (valueStart < valueEnd && isJsonSpace(data[valueStart]))
+            ++valueStart;
+        while (valueEnd > valueStart && isJsonSpace(data[valueEnd - 1]))
+            --valueEnd;
+        bool closing = c == '}' || c == ']';
+        if (strictError)
+        {
+            // Only an empty container may close without a member.
+            bool empty = valueStart == valueEnd && !haveKey;
+            if ((closing && (c == '}') != object) || (object && haveKey != inValue) ||
+                (object && !haveKey && valueStart < valueEnd) ||
+                (valueStart == valueEnd && !(closing && empty && !any)))
+                return fail(valueStart < valueEnd && !haveKey ? valueStart : pos);
+        }
+        if (valueStart < valueEnd && (haveKey || !object))
+        {
+            visit(key, ValueSpan{valueStart, valueEnd});
+            any = true;
+        }
+        key = {};
+        haveKey = false;
+        inValue = !object;
+        valueStart = pos + 1;
+        if (closing)
+        {
+            if (pos + 1 == end)
+                return true;
+            while (++pos < end && isJsonSpace(data[pos]))
+                ;
+            return fail(pos);
+        }
+        ++pos;
     }
+}
 
-    // For objects and arrays, no icons for expandable items
-    if (v->is_object())
-    {
-        size_t count = v->size();
-        return node->key + " (dictionary, " + std::to_string(count) + (count == 1 ? " key)" : " keys)");
-    }
-    else if (v->is_array())
-    {
-        size_t count = v->size();
-        std::string baseLabel = node->key + " (list, " + std::to_string(count) + (count == 1 ? " item)" : " items)");
+// Object members in the order the parsed DOM keeps them: sorted by name,
+// with the last of any duplicates winning.
+void sortMembers(std::vector<SpanMember> &members)
+{
+    std::stable_sort(members.begin(), members.end(),
+                     [](const SpanMember &a, const SpanMember &b) { return a.key < b.key; });
+    auto last = std::unique(members.rbegin(), members.rend(),
+                            [](const SpanMember &a, const SpanMember &b) { return a.key == b.key; });
+    members.erase(members.begin(), last.base());
+}
 
-        // Array previews are rendered directly in drawLine; return base label only
-        return baseLabel;
-    }
-    else if (v->is_string())
-    {
-        // Escape quotes in string for readability
-        std::string s = v->get<std::string>();
-        // Replace control characters with escapes
-        std::string out;
-        for (char c : s)
-        {
-            if (c == '\\')
-                out += "\\\\";
-            else if (c == '\"')
-                out += "\\\"";
-            else if (c == '\n')
-                out += "\\n";
-            else if (c == '\r')
-                out += "\\r";
-            else if (c == '\t')
-                out += "\\t";
-            else if (static_cast<unsigned char>(c) < 0x20)
-            {
-                char buf[7];
-                std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
-                out += buf;
-            }
-            else
-                out += c;
-        }
-        return node->key + ": \"" + out + "\"";
-    }
-    else if (v->is_boolean())
+// Split the container at span into its direct members.  Object members
+// come out sorted as by sortMembers().  Returns false when the container
+// is not closed where the span ends.
+bool scanMembers(std::string_view text, const ValueSpan &span, std::vector<SpanMember> &out,
+                 ParseProgress *progress = nullptr)
+{
+    out.clear();
+    bool closed = forEachMember(
+        text, span,
+        [&](std::string_view key, const ValueSpan &value) {
+            out.push_back(SpanMember{key.empty() ? std::string() : decodeKey(key), value});
+        },
+        progress);
+    if (text[span.begin] == '{')
+        sortMembers(out);
+    return closed;
+}
+
+bool isLargeContainer(std::string_view text, const ValueSpan &span)
+{
+    char first = text[span.begin];
+    return span.end - span.begin > kParseWholeLimit && (first == '{' || first == '[');
+}
+} // namespace
+
+NodeTree::NodeTree(const json *doc, std::string label)
+    : rootLabel(std::move(label))
+{
+    PerfTimer timer(PerfPhase::BuildTree);
+    rootNode = allocateBlock(1);
+    rootNode->value = doc;
+    rootNode->name = &rootLabel;
+    rootNode->isDummyRoot = true;
+    // Root nodes are expanded by default so the top‑level structure is visible.
+    rootNode->expanded = true;
+    if (hasChildren(rootNode))
+        rootNode->visibleCount = 1 + doc->size();
+}
+
+// A record whose line is not valid JSON is shown as its raw text.
+static json parseRecordText(std::string_view text)
+{
+    try
     {
-        return node->key + ": " + std::string(v->get<bool>() ? "true" : "false");
+        return parseJsonWithSpecialNumbers(text);
     }
-    else if (v->is_number())
+    catch (const json::exception &)
     {
-        return node->key + ": " + v->dump();
+        return json(std::string(text));
     }
-    else if (v->is_null())
+}
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void buildSpanChildren(const Node *node, ValueSpan &span, ParseProgress *progress);
+static void attachSpanChildren(const Node *node, ValueSpan &span, std::vector<SpanMember> &members);
+
+NodeTree::NodeTree(InputBuffer input, std::string label, Layout layout, ParseProgress *progress,
+                   std::string_view savedIndex)
+    : rootLabel(std::move(label)), source(std::move(input)), records(layout == Layout::Lines)
+{
+    PerfTimer timer(PerfPhase::BuildTree);
+    rootNode = allocateBlock(1, !records);
+    rootNode->name = &rootLabel;
+    rootNode->isDummyRoot = true;
+    rootNode->expanded = true;
+    if (!savedIndex.empty() && restoreIndex(savedIndex))
     {
-        return node->key + ": null";
+        restored = true;
+        if (progress)
+            progress->consumed.store(source.size(), std::memory_order_relaxed);
     }
+    else if (records)
+        indexLines(progress);
     else
-    {
-        // Fallback for other types
-        return node->key;
-    }
+        indexDocument(progress);
 }
 
-// Get the content label with search match information
-std::string getContentLabelWithSearch(const Node *node, const SearchState &search, int maxWidth)
+// Saved indexes: a header naming the layout and input size, then either
+// the record starts or the root span and its top-level members.  Integers
+// are stored in native byte order; the magic number rejects foreign ones.
+namespace
 {
-    // For non-dummy root nodes, just use the original function
-    if (!node->isDummyRoot)
-    {
-        return getContentLabel(node, maxWidth);
-    }
+constexpr uint32_t kIndexMagic = 0x4a564931; // "JVI1"
 
-    // For dummy root nodes, add search match count if search is active
-    std::string baseLabel = getContentLabel(node, maxWidth);
+template <typename T>
+void putIndexField(std::string &out, T value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
 
-    if (!search.term.empty() && !search.matches.empty())
+struct IndexReader
+{
+    std::string_view data;
+    bool ok = true;
+
+    template <typename T>
+    T get()
     {
-        // Count matches that belong to this dummy root's subtree
-        int matchCount = 0;
-        for (const Node *match : search.matches)
+        T value{};
+        if (data.size() < sizeof(T))
         {
-            // Walk up the tree to find the root
-            const Node *current = match;
-            while (current->parent != nullptr)
-            {
-                current = current->parent;
-            }
-            if (current == node)
-            {
-                matchCount++;
-            }
+            ok = false;
+            return value;
         }
+        std::memcpy(&value, data.data(), sizeof(T));
+        data.remove_prefix(sizeof(T));
+        return value;
+    }
 
-        if (matchCount > 0)
+    std::string_view bytes(size_t count)
+    {
+        if (data.size() < count)
         {
-            // Find the closing parenthesis in the base label
-            size_t closeParenPos = baseLabel.rfind(')');
-            if (closeParenPos != std::string::npos)
-            {
-                // Insert the match count before the closing parenthesis
-                std::string matchInfo = ", 🔍 " + std::to_string(matchCount) + (matchCount == 1 ? " match" : " matches");
-                baseLabel.insert(closeParenPos, matchInfo);
-            }
+            ok = false;
+            return {};
         }
+        std::string_view out = data.substr(0, count);
+        data.remove_prefix(count);
+        return out;
     }
+};
+} // namespace
 
-    return baseLabel;
-}
-
-// Generate a preview of array values for inline display
-// (arrayPreview removed; previews are rendered directly in drawLine)
-
-// Expand every branch of the given node.  Primitive leaves remain
-// unchanged.  This function recurses through all descendants.
-void expandAll(Node *node)
+std::string NodeTree::saveIndex() const
 {
-    node->expanded = true;
-    for (auto &child : node->children)
+    std::string out;
+    if (!records && rootNode->value)
+        return out; // parsed whole, nothing was scanned
+    putIndexField(out, kIndexMagic);
+    putIndexField(out, static_cast<uint8_t>(records ? Layout::Lines : Layout::Indexed));
+    putIndexField(out, static_cast<uint64_t>(source.size()));
+    if (records)
+    {
+        putIndexField(out, static_cast<uint64_t>(recordStarts.size()));
+        out.append(reinterpret_cast<const char *>(recordStarts.data()), recordStarts.size() * sizeof(uint64_t));
+        return out;
+    }
+    const ValueSpan &span = blockHeader(rootNode).spans[0];
+    putIndexField(out, span.begin);
+    putIndexField(out, span.end);
+    putIndexField(out, static_cast<uint64_t>(rootNode->childCount));
+    const ValueSpan *spans = rootNode->childCount ? blockHeader(rootNode->children).spans : nullptr;
+    for (size_t i = 0; i < rootNode->childCount; ++i)
     {
-        expandAll(child.get());
+        const std::string *name = rootNode->children[i].name;
+        putIndexField(out, spans[i].begin);
+        putIndexField(out, spans[i].end);
+        putIndexField(out, spans[i].count);
+        putIndexField(out, static_cast<uint32_t>(name ? name->size() : 0));
+        if (name)
+            out += *name;
     }
+    return out;
 }
 
-// Collapse every branch of the given node.  When keepRoot is true the
-// top‑level node remains expanded so the structure of the document is
-// still visible.
-void collapseAll(Node *node, bool keepRoot)
+// Adopt a saved index, or leave the tree untouched when it does not fit.
+bool NodeTree::restoreIndex(std::string_view index)
 {
-    if (!node->isDummyRoot || !keepRoot)
+    IndexReader in{index};
+    uint64_t size = source.size();
+    if (in.get<uint32_t>() != kIndexMagic || in.get<uint8_t>() != static_cast<uint8_t>(records ? Layout::Lines : Layout::Indexed) ||
+        in.get<uint64_t>() != size || !in.ok)
+        return false;
+    if (records)
     {
-        node->expanded = false;
+        uint64_t count = in.get<uint64_t>();
+        if (!in.ok || count > in.data.size() / sizeof(uint64_t))
+            return false;
+        std::vector<uint64_t> starts(count);
+        if (count)
+            std::memcpy(starts.data(), in.bytes(count * sizeof(uint64_t)).data(), count * sizeof(uint64_t));
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (starts[i] >= size || (i > 0 && starts[i] <= starts[i - 1]))
+                return false;
+        }
+        recordStarts = std::move(starts);
+        if (!recordStarts.empty())
+            rootNode->visibleCount = 1 + recordStarts.size();
+        return true;
     }
-    for (auto &child : node->children)
+
+    ValueSpan root;
+    root.begin = in.get<uint64_t>();
+    root.end = in.get<uint64_t>();
+    uint64_t count = in.get<uint64_t>();
+    if (!in.ok || root.begin >= root.end || root.end > size || count >= ValueSpan::unknownCount)
+        return false;
+    std::string_view doc = source.view();
+    if (doc[root.begin] != '{' && doc[root.begin] != '[')
+        return false;
+    bool object = doc[root.begin] == '{';
+    std::vector<SpanMember> members(count);
+    for (SpanMember &member : members)
     {
-        collapseAll(child.get(), false);
+        member.span.begin = in.get<uint64_t>();
+        member.span.end = in.get<uint64_t>();
+        member.span.count = in.get<uint32_t>();
+        uint32_t keyLength = in.get<uint32_t>();
+        member.key = std::string(in.bytes(keyLength));
+        if (!in.ok || member.span.begin <= root.begin || member.span.begin >= member.span.end ||
+            member.span.end >= root.end || (keyLength && !object))
+            return false;
     }
+    ValueSpan &span = blockHeader(rootNode).spans[0];
+    span = root;
+    attachSpanChildren(rootNode, span, members);
+    rootNode->visibleCount = 1 + rootNode->childCount;
+    return true;
 }
 
-// Expand nodes up to a specific nesting level.
-// Level 0 means collapse all, level 1 means show only first level, etc.
-void expandToLevel(Node *node, int targetLevel, int currentLevel)
+// Scan the top level of an indexed document.  Documents that are small or
+// not a container are simply parsed.
+void NodeTree::indexDocument(ParseProgress *progress)
 {
-    // Special handling for level 0 - collapse everything
-    if (targetLevel == 0)
+    std::string_view doc = source.view();
+    ValueSpan &span = blockHeader(rootNode).spans[0];
+    span.begin = 0;
+    span.end = doc.size();
+    while (span.begin < span.end && isJsonSpace(doc[span.begin]))
+        ++span.begin;
+    while (span.end > span.begin && isJsonSpace(doc[span.end - 1]))
+        --span.end;
+    if (span.begin == span.end || !isLargeContainer(doc, span))
     {
-        // Collapse everything, including root nodes
-        node->expanded = false;
-        for (auto &child : node->children)
-        {
-            collapseAll(child.get(), false);
-        }
+        rootNode->value = adopt(parseJsonWithSpecialNumbers(doc, progress));
+        if (hasChildren(rootNode))
+            rootNode->visibleCount = 1 + rootNode->value->size();
         return;
     }
+    buildSpanChildren(rootNode, span, progress);
+    if (progress)
+        progress->consumed.store(doc.size(), std::memory_order_relaxed);
+    rootNode->visibleCount = 1 + rootNode->childCount;
+}
 
-    // For dummy roots, don't change their expansion state, just process children
-    if (node->isDummyRoot)
+// One pass over the input recording where each non-blank line starts.
+void NodeTree::indexLines(ParseProgress *progress, size_t from)
+{
+    const char *data = source.data();
+    size_t size = source.size();
+    size_t nextReport = kProgressStride;
+    for (size_t pos = from; pos < size;)
     {
-        node->expanded = true; // Always expand dummy roots when target > 0
-        for (auto &child : node->children)
+        const char *newline = static_cast<const char *>(std::memchr(data + pos, '\n', size - pos));
+        size_t lineEnd = newline ? static_cast<size_t>(newline - data) : size;
+        while (pos < lineEnd && isBlank(data[pos]))
+            ++pos;
+        if (pos < lineEnd)
+            recordStarts.push_back(pos);
+        pos = lineEnd + 1;
+        if (progress && pos >= nextReport)
         {
-            expandToLevel(child.get(), targetLevel, 1); // Children of dummy root are at level 1
+            progress->update(pos);
+            nextReport = pos + kProgressStride;
         }
-        return;
     }
+    if (progress)
+        progress->consumed.store(size, std::memory_order_relaxed);
+    if (!recordStarts.empty())
+        rootNode->visibleCount = 1 + recordStarts.size();
+}
 
-    // For regular nodes:
-    if (currentLevel < targetLevel)
-    {
-        // We haven't reached the target depth yet - expand and recurse
-        node->expanded = true;
-        for (auto &child : node->children)
-        {
-            expandToLevel(child.get(), targetLevel, currentLevel + 1);
-        }
+std::string_view NodeTree::recordText(size_t index) const
+{
+    const char *data = source.data();
+    size_t begin = recordStarts[index];
+    size_t limit = index + 1 < recordStarts.size() ? recordStarts[index + 1] : source.size();
+    const char *newline = static_cast<const char *>(std::memchr(data + begin, '\n', limit - begin));
+    size_t end = newline ? static_cast<size_t>(newline - data) : limit;
+    while (end > begin && isBlank(data[end - 1]))
+        --end;
+    return std::string_view(data + begin, end - begin);
+}
+
+// One-based line number of a record, counting blank lines too.
+size_t NodeTree::recordLine(size_t index) const
+{
+    const char *data = source.data();
+    return 1 + static_cast<size_t>(std::count(data, data + recordStarts[index], '\n'));
+}
+
+const json *NodeTree::parseRecord(size_t index)
+{
+    return adopt(parseRecordText(recordText(index)));
+}
+
+const json *NodeTree::adopt(json value)
+{
+    if (!freeValues.empty())
+    {
+        json *slot = freeValues.back();
+        freeValues.pop_back();
+        *slot = std::move(value);
+        return slot;
+    }
+    parsedValues.push_back(std::move(value));
+    return &parsedValues.back();
+}
+
+const std::string *KeyTable::intern(std::string_view key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end())
+        return it->second;
+    const std::string &stored = keys.emplace_back(key);
+    keyBytes += sizeof(std::string) + stored.size();
+    index.emplace(stored, &stored);
+    return &stored;
+}
+
+size_t KeyTable::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return keys.size();
+}
+
+size_t KeyTable::bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return keyBytes;
+}
+
+static size_t blockSize(size_t count, bool withSpans)
+{
+    return sizeof(NodeBlockHeader) + count * sizeof(Node) + (withSpans ? count * sizeof(ValueSpan) : 0) +
+           (count >= kFenwickMinBlock ? (count + 1) * sizeof(uint64_t) : 0);
+}
+
+// Allocate a contiguous, default-initialised block of nodes.  Blocks given
+// back by evictCold() are reused when one of the same size is free.
+Node *NodeTree::allocateBlock(size_t count, bool withSpans)
+{
+    perfStats.add(PerfCounter::NodesBuilt, count);
+    blockBytes += blockSize(count, withSpans);
+    NodeBlockHeader *header = nullptr;
+    auto reusable = freeBlocks.find({count, withSpans});
+    if (reusable != freeBlocks.end() && !reusable->second.empty())
+    {
+        header = &blockHeader(reusable->second.back());
+        reusable->second.pop_back();
     }
     else
     {
-        // We're at or beyond the target depth - collapse
-        node->expanded = false;
-        for (auto &child : node->children)
-        {
-            collapseAll(child.get(), false);
-        }
+        void *mem = arena.allocate(sizeof(NodeBlockHeader) + count * sizeof(Node), alignof(Node));
+        header = new (mem) NodeBlockHeader{this, nullptr, nullptr, count};
+        if (withSpans)
+            header->spans = static_cast<ValueSpan *>(arena.allocate(count * sizeof(ValueSpan), alignof(ValueSpan)));
+        if (count >= kFenwickMinBlock)
+            header->fenwick =
+                static_cast<uint64_t *>(arena.allocate((count + 1) * sizeof(uint64_t), alignof(uint64_t)));
+    }
+    Node *block = reinterpret_cast<Node *>(header + 1);
+    for (size_t i = 0; i < count; ++i)
+        new (block + i) Node();
+    if (withSpans)
+    {
+        for (size_t i = 0; i < count; ++i)
+            new (header->spans + i) ValueSpan();
+    }
+    if (header->fenwick)
+    {
+        // Every new node is a single collapsed row, so entry i covers
+        // exactly lowbit(i) rows.
+        header->fenwick[0] = 0;
+        for (size_t i = 1; i <= count; ++i)
+            header->fenwick[i] = i & (~i + 1);
     }
+    return block;
 }
 
-// Recursively search for nodes matching the given search term.  Both
-// keys and values can be searched.  The search term and the
-// candidates are compared in lowercase to achieve case‑insensitive
-// matching.  When searching values, primitive values are converted to
-// their JSON string representation.
-void searchTree(const Node *node, const std::string &term,
-                       bool searchKeys, bool searchValues,
-                       std::vector<const Node *> &out)
+NodeTree *NodeTree::owner(const Node *node)
+{
+    const Node *block = node->parent ? node->parent->children : node;
+    return blockHeader(block).tree;
+}
+
+void NodeTree::noteParsed(const Node *node, size_t textSize)
+{
+    if (!tracking)
+        return;
+    ParsedValue &value = tracked[node];
+    parsedBytes += textSize * kDomBytesPerInputByte - value.bytes;
+    value.bytes = textSize * kDomBytesPerInputByte;
+    value.lastUsed = lastFrame;
+}
+
+// Values parsed from the text belong to the nodes they were parsed for,
+// and everything below such a node points into its value, so the nearest
+// tracked ancestor is the one in use.
+void NodeTree::touch(const Node *node, uint64_t frame)
 {
-    // Convert the node's key and value to lowercase strings
-    if (!term.empty())
+    lastFrame = std::max(lastFrame, frame);
+    if (!tracking)
+        return;
+    for (const Node *cur = node; cur; cur = cur->parent)
     {
-        bool matched = false;
-        if (searchKeys)
-        {
-            std::string keyLower = node->key;
-            std::transform(keyLower.begin(), keyLower.end(), keyLower.begin(), ::tolower);
-            if (keyLower.find(term) != std::string::npos)
-            {
-                matched = true;
-            }
-        }
-        if (searchValues)
-        {
-            // Convert value to a displayable string
-            std::string val;
-            const json *v = node->value;
-            if (v->is_string())
-                val = v->get<std::string>();
-            else if (v->is_boolean())
-                val = (v->get<bool>() ? "true" : "false");
-            else if (v->is_number())
-                val = v->dump();
-            else if (v->is_null())
-                val = "null";
-            else if (v->is_object())
-                val = "dictionary";
-            else if (v->is_array())
-                val = "list";
-            else
-                val = v->dump();
-            std::string valLower = val;
-            std::transform(valLower.begin(), valLower.end(), valLower.begin(), ::tolower);
-            if (valLower.find(term) != std::string::npos)
-            {
-                matched = true;
-            }
-        }
-        if (matched)
+        auto it = tracked.find(cur);
+        if (it != tracked.end())
         {
-            out.push_back(node);
+            it->second.lastUsed = frame;
+            return;
         }
     }
-    // Continue search through children
-    for (const auto &child : node->children)
+}
+
+// Give the blocks below a node back for reuse.
+void NodeTree::releaseChildren(Node *node)
+{
+    if (!node->childrenBuilt)
+        return;
+    for (Node &child : builtChildren(node))
+        releaseChildren(&child);
+    if (node->children)
     {
-        searchTree(child.get(), term, searchKeys, searchValues, out);
+        NodeBlockHeader &header = blockHeader(node->children);
+        bool withSpans = header.spans != nullptr;
+        freeBlocks[{header.capacity, withSpans}].push_back(node->children);
+        blockBytes -= blockSize(header.capacity, withSpans);
     }
+    node->children = nullptr;
+    node->childCount = 0;
+    node->childrenBuilt = false;
 }
 
-// Expand all ancestors of the given node so that it becomes visible.
-void expandPath(Node *node)
+// Drop the value parsed for a node, and the nodes built from it.
+void NodeTree::release(Node *node)
 {
-    Node *cur = node->parent;
-    while (cur)
+    releaseChildren(node);
+    if (json *value = const_cast<json *>(node->value))
     {
-        cur->expanded = true;
-        cur = cur->parent;
+        *value = json();
+        freeValues.push_back(value);
+        node->value = nullptr;
+    }
+    auto it = tracked.find(node);
+    if (it != tracked.end())
+    {
+        parsedBytes -= it->second.bytes;
+        tracked.erase(it);
     }
 }
 
-// Base64 encoding for OSC 52 clipboard support
-static std::string base64Encode(const std::string &input)
+static bool containsMatch(const Node *node, const SearchState &search)
 {
-    static const char base64_chars[] =
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
+    if (search.isMatch(node))
+        return true;
+    for (const Node &child : builtChildren(node))
+    {
+        if (containsMatch(&child, search))
+            return true;
+    }
+    return false;
+}
 
-    std::string encoded;
-    int val = 0, valb = -6;
-    for (unsigned char c : input)
+size_t NodeTree::evictCold(const std::vector<NodeTree *> &trees, size_t target, uint64_t frame,
+                           const SearchState &search)
+{
+    struct Candidate
     {
-        val = (val << 8) + c;
-        valb += 8;
-        while (valb >= 0)
+        uint64_t lastUsed;
+        NodeTree *tree;
+        const Node *node;
+    };
+    size_t total = 0;
+    std::vector<Candidate> candidates;
+    for (NodeTree *tree : trees)
+    {
+        total += tree->memoryUse();
+        for (const auto &[node, value] : tree->tracked)
         {
-            encoded.push_back(base64_chars[(val >> valb) & 0x3F]);
-            valb -= 6;
+            if (value.lastUsed < frame)
+                candidates.push_back({value.lastUsed, tree, node});
         }
     }
-    if (valb > -6)
-        encoded.push_back(base64_chars[((val << 8) >> (valb + 8)) & 0x3F]);
-    while (encoded.size() % 4)
-        encoded.push_back('=');
-    return encoded;
+    if (total <= target)
+        return 0;
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) { return a.lastUsed < b.lastUsed; });
+
+    size_t released = 0;
+    for (const Candidate &candidate : candidates)
+    {
+        if (total - released <= target)
+            break;
+        Node *node = const_cast<Node *>(candidate.node);
+        // Dropping an open node would take its rows off the screen
+        bool hidden = !node->expanded;
+        for (const Node *p = node->parent; p && !hidden; p = p->parent)
+            hidden = !p->expanded;
+        if (!hidden || (!search.matches.empty() && containsMatch(node, search)))
+            continue;
+        size_t before = candidate.tree->memoryUse();
+        setExpanded(node, false);
+        candidate.tree->release(node);
+        released += before - candidate.tree->memoryUse();
+    }
+    return released;
 }
 
-// Check if an executable exists in PATH
-// Check if OSC 52 clipboard sequences are likely to be supported
-bool osc52Likely()
+// Create the tree for a document.  Only the root node is allocated; its
+// descendants are created on demand by ensureChildren() so the cost of
+// opening a document does not depend on its size.
+std::unique_ptr<NodeTree> buildTree(const json *j, const std::string &label)
 {
-    // Check for explicit opt-out
-    const char *noOsc52 = std::getenv("NO_OSC52");
-    if (noOsc52 && *noOsc52)
-        return false;
-
-    const char *term = std::getenv("TERM");
-    if (!term)
-        return false;
-
-    std::string termStr(term);
-
-    // Terminals that definitely don't support OSC 52
-    if (termStr == "dumb" || termStr == "linux")
-        return false;
+    return std::make_unique<NodeTree>(j, label);
+}
 
-    // Common terminals/muxers that support OSC 52 (including tmux!)
-    return termStr.find("xterm") != std::string::npos ||
-           termStr.find("tmux") != std::string::npos ||
-           termStr.find("screen") != std::string::npos ||
-           termStr.find("rxvt") != std::string::npos ||
-           termStr.find("alacritty") != std::string::npos ||
-           termStr.find("foot") != std::string::npos ||
-           termStr.find("kitty") != std::string::npos ||
-           termStr.find("wezterm") != std::string::npos;
+// A member whose value cannot be parsed is shown as its raw text.
+static json parseSpanText(std::string_view text, const ValueSpan &span)
+{
+    return parseRecordText(text.substr(span.begin, span.end - span.begin));
 }
 
-// Check if the current terminal supports clipboard operations via OSC 52
-// Get a descriptive message about clipboard support status
-std::string getClipboardStatusMessage()
+// The JSON value of a node.  Records of a line-delimited document and the
+// values of an indexed one are parsed here the first time they are needed.
+// The root of a line-delimited document and containers of an indexed one
+// too large to parse whole have no value and yield null.
+const json *nodeValue(const Node *node)
 {
-    if (osc52Likely())
+    if (node->value)
+        return node->value;
+    if (ValueSpan *span = nodeSpan(node))
     {
-        return "JSON copied to clipboard!";
+        NodeTree *tree = NodeTree::owner(node);
+        if (!isLargeContainer(tree->text(), *span))
+        {
+            node->value = tree->adopt(parseSpanText(tree->text(), *span));
+            tree->noteParsed(node, span->end - span->begin);
+        }
     }
-    if (std::getenv("TMUX") && !osc52Likely())
+    else if (node->parent)
     {
-        return "Clipboard not supported - tmux needs OSC 52 configuration";
+        NodeTree *tree = NodeTree::owner(node);
+        size_t index = childIndex(node);
+        node->value = tree->parseRecord(index);
+        tree->noteParsed(node, tree->recordText(index).size());
     }
-    return "Clipboard not supported by this terminal";
+    if (node->value)
+        perfStats.add(PerfCounter::ValuesParsed);
+    return node->value;
 }
 
-// Copy text to clipboard using OSC 52 escape sequence
-void copyToClipboard(const std::string &text)
+// Number of children of a node that has any, built or not.  Unparsed
+// containers are scanned for it once.
+static size_t nodeSize(const Node *node)
 {
-    if (!osc52Likely())
+    if (const json *v = nodeValue(node))
+        return v->size();
+    if (node->childrenBuilt)
+        return node->childCount;
+    ValueSpan *span = nodeSpan(node);
+    if (!span)
+        return NodeTree::owner(node)->recordCount();
+    if (span->count == ValueSpan::unknownCount)
+    {
+        std::vector<SpanMember> members;
+        scanMembers(NodeTree::owner(node)->text(), *span, members);
+        if (members.size() >= ValueSpan::unknownCount)
+            throw std::length_error("container has too many elements to display");
+        span->count = static_cast<uint32_t>(members.size());
+    }
+    return span->count;
+}
+
+// True when a node without a value is an object rather than a list.
+static bool isUnparsedObject(const Node *node)
+{
+    const ValueSpan *span = nodeSpan(node);
+    return span && NodeTree::owner(node)->text()[span->begin] == '{';
+}
+
+// True when the node is a non-empty object or array, whether or not its
+// children have been materialised yet.
+bool hasChildren(const Node *node)
+{
+    const json *v = nodeValue(node);
+    if (!v)
+        return nodeSize(node) > 0;
+    return (v->is_object() || v->is_array()) && !v->empty();
+}
+
+// Give an unparsed container the children found by scanning its span.
+static void attachSpanChildren(const Node *node, ValueSpan &span, std::vector<SpanMember> &members)
+{
+    NodeTree *tree = NodeTree::owner(node);
+    if (members.size() >= ValueSpan::unknownCount)
+        throw std::length_error("container has too many elements to display");
+    bool object = tree->text()[span.begin] == '{';
+    Node *self = const_cast<Node *>(node);
+    node->childrenBuilt = true;
+    span.count = static_cast<uint32_t>(members.size());
+    if (members.empty())
         return;
+    Node *block = tree->allocateBlock(members.size(), true);
+    ValueSpan *spans = blockHeader(block).spans;
+    for (size_t i = 0; i < members.size(); ++i)
+    {
+        block[i].parent = self;
+        if (object)
+            block[i].name = keyTable.intern(members[i].key);
+        spans[i] = members[i].span;
+    }
+    block[members.size() - 1].isLastChild = true;
+    node->children = block;
+    node->childCount = span.count;
+}
 
-    // Limit payload size to prevent issues with muxers/terminals
-    constexpr size_t maxOsc52Payload = 100000;
-    std::string encoded = base64Encode(text);
+// Build the children of an unparsed container from a scan of its span.
+static void buildSpanChildren(const Node *node, ValueSpan &span, ParseProgress *progress)
+{
+    std::vector<SpanMember> members;
+    if (!scanMembers(NodeTree::owner(node)->text(), span, members, progress) && node->isDummyRoot)
+        throw std::runtime_error("unexpected end of input: the document is not closed");
+    attachSpanChildren(node, span, members);
+}
 
-    if (encoded.size() <= maxOsc52Payload)
+// Materialise the direct children of a node the first time they are
+// needed.  Primitive values never have children.
+std::span<Node> ensureChildren(const Node *node)
+{
+    if (node->childrenBuilt)
+        return builtChildren(node);
+    PerfTimer timer(PerfPhase::BuildTree);
+    const json *j = nodeValue(node);
+    if (!j)
     {
-        // Try to write to /dev/tty first, fall back to stdout
-        FILE *out = std::fopen("/dev/tty", "w");
-        if (!out && isatty(fileno(stdout)))
+        if (ValueSpan *span = nodeSpan(node))
         {
-            out = stdout;
+            buildSpanChildren(node, *span, nullptr);
+            return builtChildren(node);
         }
-
-        if (out)
+    }
+    // Size the block before marking it built: nodeSize() answers from the
+    // built children once there are any.
+    size_t count = hasChildren(node) ? nodeSize(node) : 0;
+    node->childrenBuilt = true;
+    if (count == 0)
+        return {};
+    if (count > UINT32_MAX)
+        throw std::length_error("container has too many elements to display");
+    Node *self = const_cast<Node *>(node);
+    Node *block = NodeTree::owner(node)->allocateBlock(count);
+    Node *child = block;
+    if (!j)
+    {
+        // Records get their values when first looked at.
+        for (size_t i = 0; i < count; ++i, ++child)
+            child->parent = self;
+    }
+    else if (j->is_object())
+    {
+        for (auto it = j->begin(); it != j->end(); ++it, ++child)
         {
-            // Use BEL terminator instead of ST for better compatibility
-            std::fprintf(out, "\033]52;c;%s\a", encoded.c_str());
-            std::fflush(out);
-            if (out != stdout)
-            {
-                std::fclose(out);
-            }
+            child->value = &it.value();
+            child->name = &it.key();
+            child->parent = self;
         }
     }
-}
-
-// Reconstruct JSON from a node and its children
-json reconstructJson(const Node *node)
-{
-    if (node->isDummyRoot)
+    else
     {
-        // For dummy root, return the actual JSON value
-        return *node->value;
+        for (auto it = j->begin(); it != j->end(); ++it, ++child)
+        {
+            child->value = &(*it);
+            child->parent = self;
+        }
     }
+    // Mark last child in the list.  This information is used to draw
+    // the tree branches correctly.
+    (child - 1)->isLastChild = true;
+    node->children = block;
+    node->childCount = static_cast<uint32_t>(count);
+    return builtChildren(node);
+}
 
-    // Return the JSON value of this node
-    return *node->value;
+// The children that exist already, without materialising anything.
+std::span<Node> builtChildren(const Node *node)
+{
+    return std::span<Node>(node->children, node->childCount);
 }
 
-// Format file size in human-readable units
-std::string formatFileSize(size_t size)
+// Position of a node within its parent's children.
+size_t childIndex(const Node *node)
 {
-    const char *units[] = {"Bytes", "KB", "MB", "GB", "TB"};
-    const size_t unitCount = sizeof(units) / sizeof(units[0]);
+    return node->parent ? static_cast<size_t>(node - node->parent->children) : 0;
+}
 
-    double fileSize = static_cast<double>(size);
-    size_t unitIndex = 0;
+// The label shown for a node: member name, document label or "[index]".
+std::string nodeKey(const Node *node)
+{
+    if (node->name)
+        return *node->name;
+    return "[" + std::to_string(childIndex(node)) + "]";
+}
 
-    while (fileSize >= 1024.0 && unitIndex < unitCount - 1)
+// Rows contributed by the children of an expanded node.  Children that
+// have not been built yet are all collapsed, one row each.
+static uint64_t childRows(const Node *node)
+{
+    if (!hasChildren(node))
+        return 0;
+    if (!node->childrenBuilt)
+        return nodeSize(node);
+    const NodeBlockHeader &header = blockHeader(node->children);
+    if (header.fenwick)
     {
-        fileSize /= 1024.0;
-        unitIndex++;
+        uint64_t total = 0;
+        for (size_t i = node->childCount; i > 0; i &= i - 1)
+            total += header.fenwick[i];
+        return total;
     }
+    uint64_t total = 0;
+    for (const Node &child : builtChildren(node))
+        total += child.visibleCount;
+    return total;
+}
 
-    // Format with appropriate precision
-    std::ostringstream oss;
-    if (unitIndex == 0)
+// Rows occupied by the first `index` children of a built node.
+static uint64_t rowsBefore(const Node *parent, size_t index)
+{
+    const NodeBlockHeader &header = blockHeader(parent->children);
+    uint64_t total = 0;
+    if (header.fenwick)
     {
-        // For bytes, show exact count
-        oss << static_cast<size_t>(fileSize) << " " << units[unitIndex];
+        for (size_t i = index; i > 0; i &= i - 1)
+            total += header.fenwick[i];
+        return total;
     }
-    else if (fileSize < 10.0)
+    for (size_t i = 0; i < index; ++i)
+        total += parent->children[i].visibleCount;
+    return total;
+}
+
+// Find the child of a built, expanded node that contains the row `offset`
+// (relative to the first child) and reduce offset to be relative to it.
+static const Node *childAtRow(const Node *parent, uint64_t &offset)
+{
+    const NodeBlockHeader &header = blockHeader(parent->children);
+    size_t count = parent->childCount;
+    if (header.fenwick)
     {
-        // For smaller values, show one decimal place
-        oss.precision(1);
-        oss << std::fixed << fileSize << " " << units[unitIndex];
+        size_t pos = 0;
+        size_t step = 1;
+        while (step * 2 <= count)
+            step *= 2;
+        for (; step > 0; step /= 2)
+        {
+            if (pos + step <= count && header.fenwick[pos + step] <= offset)
+            {
+                pos += step;
+                offset -= header.fenwick[pos];
+            }
+        }
+        return pos < count ? &parent->children[pos] : nullptr;
     }
-    else
+    for (size_t i = 0; i < count; ++i)
     {
-        // For larger values, show whole numbers
-        oss << static_cast<int>(fileSize + 0.5) << " " << units[unitIndex];
+        const Node &child = parent->children[i];
+        if (offset < child.visibleCount)
+            return &child;
+        offset -= child.visibleCount;
     }
-
-    return oss.str();
+    return nullptr;
 }
 
-// Pretty-print JSON preserving NaN/Infinity literals
-void printFormattedJson(const json &j, int indent)
+// Apply a change in a node's visibleCount to the Fenwick tree of its
+// block and to every expanded ancestor.
+static void propagateVisibleDelta(const Node *node, int64_t delta)
 {
-    std::string pad(indent, ' ');
-    switch (j.type())
+    if (delta == 0)
+        return;
+    for (const Node *cur = node; cur->parent; cur = cur->parent)
     {
-    case json::value_t::object:
-        if (j.empty())
-        {
-            std::cout << "{}";
-            return;
-        }
-        std::cout << "{\n";
-        for (auto it = j.cbegin(); it != j.cend(); ++it)
-        {
-            std::cout << std::string(indent + 2, ' ')
-                      << json(it.key()).dump() << ": ";
-            printFormattedJson(it.value(), indent + 2);
-            if (std::next(it) != j.cend())
-                std::cout << ",";
-            std::cout << "\n";
-        }
-        std::cout << pad << "}";
-        break;
-    case json::value_t::array:
-        if (j.empty())
-        {
-            std::cout << "[]";
-            return;
-        }
-        std::cout << "[\n";
-        for (size_t i = 0; i < j.size(); ++i)
+        const Node *parent = cur->parent;
+        NodeBlockHeader &header = blockHeader(parent->children);
+        if (header.fenwick)
         {
-            std::cout << std::string(indent + 2, ' ');
-            printFormattedJson(j[i], indent + 2);
-            if (i + 1 < j.size())
-                std::cout << ",";
-            std::cout << "\n";
+            for (size_t i = childIndex(cur) + 1; i <= header.capacity; i += i & (~i + 1))
+                header.fenwick[i] += delta;
         }
-        std::cout << pad << "]";
-        break;
-    case json::value_t::string:
-        std::cout << j.dump();
-        break;
-    case json::value_t::boolean:
-    case json::value_t::number_integer:
-    case json::value_t::number_unsigned:
-        std::cout << j.dump();
-        break;
-    case json::value_t::number_float:
-    {
-        double d = j.get<double>();
-        if (std::isnan(d))
-            std::cout << "NaN";
-        else if (std::isinf(d))
-            std::cout << (d > 0 ? "Infinity" : "-Infinity");
-        else
-            std::cout << j.dump();
-        break;
-    }
-    case json::value_t::null:
-        std::cout << "null";
-        break;
-    default:
-        std::cout << j.dump();
-        break;
+        if (!parent->expanded)
+            break;
+        parent->visibleCount += delta;
     }
 }
 
-// Replace placeholder strings with special floating-point values
-static void replaceSpecialStrings(json &j)
+// Refill the Fenwick tree of a built node's block from its children.
+static void rebuildFenwick(const Node *node)
 {
-    if (j.is_string())
-    {
-        auto &s = j.get_ref<json::string_t &>();
-        if (s == "__JSON_VIEW_NaN__")
-            j = std::numeric_limits<double>::quiet_NaN();
-        else if (s == "__JSON_VIEW_INF__")
-            j = std::numeric_limits<double>::infinity();
-        else if (s == "__JSON_VIEW_NEG_INF__")
-            j = -std::numeric_limits<double>::infinity();
-    }
-    else if (j.is_object())
+    NodeBlockHeader &header = blockHeader(node->children);
+    if (!header.fenwick)
+        return;
+    size_t count = node->childCount;
+    for (size_t i = 1; i <= header.capacity; ++i)
+        header.fenwick[i] = i <= count ? node->children[i - 1].visibleCount : 0;
+    for (size_t i = 1; i <= header.capacity; ++i)
     {
-        for (auto &el : j.items())
-            replaceSpecialStrings(el.value());
+        size_t up = i + (i & (~i + 1));
+        if (up <= header.capacity)
+            header.fenwick[up] += header.fenwick[i];
     }
-    else if (j.is_array())
+}
+
+// Recompute visibleCount (and block Fenwick trees) for every built node
+// below and including `node`, after its expansion flags were changed in
+// bulk.  The caller propagates the root's change upward.
+static uint64_t recountVisible(const Node *node)
+{
+    if (node->childrenBuilt && node->childCount > 0)
     {
-        for (auto &el : j)
-            replaceSpecialStrings(el);
+        for (const Node &child : builtChildren(node))
+            recountVisible(&child);
+        rebuildFenwick(node);
     }
+    node->visibleCount = 1 + (node->expanded ? childRows(node) : 0);
+    return node->visibleCount;
 }
 
-// Parse JSON while preserving NaN/Infinity literals by using placeholders
-json parseJsonWithSpecialNumbers(const std::string &contents)
+// Trees with fewer bytes of nodes than this are recounted on one thread.
+static constexpr size_t kParallelRecountBytes = 16 << 20;
+// The top of a tree is split into about this many subtrees per thread,
+// from levels of at most kRecountSplitWidth nodes.
+static constexpr size_t kRecountTasksPerThread = 16;
+static constexpr size_t kRecountSplitWidth = 1 << 16;
+
+// recountVisible() spread over threads.  The top levels of the tree are
+// split into subtrees, which are recounted in parallel; each writes only
+// its own nodes and blocks.  The nodes above them are then recounted from
+// their children, deepest first.  Values of text-backed trees may still
+// be parsed along the way, which only the owning thread may do, so those
+// are recounted on one thread.
+static uint64_t recountVisibleParallel(const Node *node)
 {
-    std::string processed;
-    processed.reserve(contents.size());
-    bool inString = false;
-    for (size_t i = 0; i < contents.size();)
+    const NodeTree *tree = NodeTree::owner(node);
+    unsigned threads = std::thread::hardware_concurrency();
+    if (threads < 2 || !tree->text().empty() || tree->memoryUse() < kParallelRecountBytes)
+        return recountVisible(node);
+
+    std::vector<const Node *> upper;
+    std::vector<const Node *> subtrees{node};
+    while (subtrees.size() < threads * kRecountTasksPerThread)
     {
-        char c = contents[i];
-        if (inString)
+        size_t width = 0;
+        for (const Node *n : subtrees)
+            width += n->childrenBuilt ? n->childCount : 1;
+        if (width == subtrees.size() || width > kRecountSplitWidth)
+            break;
+        std::vector<const Node *> next;
+        next.reserve(width);
+        for (const Node *n : subtrees)
         {
-            processed.push_back(c);
-            if (c == '\\')
+            if (n->childrenBuilt && n->childCount > 0)
             {
-                ++i;
-                if (i < contents.size())
-                    processed.push_back(contents[i]);
-                ++i;
-            }
-            else if (c == '"')
-            {
-                inString = false;
-                ++i;
+                upper.push_back(n);
+                for (const Node &child : builtChildren(n))
+                    next.push_back(&child);
             }
             else
-            {
-                ++i;
-            }
+                next.push_back(n);
         }
-        else
+        subtrees.swap(next);
+    }
+
+    std::atomic<size_t> nextTask{0};
+    auto work = [&]() {
+        for (size_t i; (i = nextTask.fetch_add(1, std::memory_order_relaxed)) < subtrees.size();)
+            recountVisible(subtrees[i]);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t)
+        workers.emplace_back(work);
+    work();
+    for (std::thread &worker : workers)
+        worker.join();
+    for (auto it = upper.rbegin(); it != upper.rend(); ++it)
+    {
+        rebuildFenwick(*it);
+        (*it)->visibleCount = 1 + ((*it)->expanded ? childRows(*it) : 0);
+    }
+    return node->visibleCount;
+}
+
+static void refreshVisibleCounts(Node *node)
+{
+    uint64_t before = node->visibleCount;
+    uint64_t after = recountVisibleParallel(node);
+    propagateVisibleDelta(node, static_cast<int64_t>(after) - static_cast<int64_t>(before));
+}
+
+// Expand or collapse a single node, keeping the row counts current.
+void setExpanded(Node *node, bool expanded)
+{
+    if (node->expanded == expanded)
+        return;
+    node->expanded = expanded;
+    uint64_t before = node->visibleCount;
+    node->visibleCount = 1 + (expanded ? childRows(node) : 0);
+    propagateVisibleDelta(node, static_cast<int64_t>(node->visibleCount) - static_cast<int64_t>(before));
+}
+
+size_t NodeTree::appendLines(InputBuffer grown, bool &moved, bool &released)
+{
+    PerfTimer timer(PerfPhase::BuildTree);
+    moved = false;
+    released = false;
+    if (!records || grown.size() <= source.size())
+        return 0;
+    // Lines are scanned again from the start of the last one, which may
+    // have been cut short; its record is dropped here and found again.
+    std::string_view old = source.view();
+    size_t lastNewline = old.rfind('\n');
+    size_t resume = lastNewline == std::string_view::npos ? 0 : lastNewline + 1;
+    size_t before = recordStarts.size();
+    size_t pending = before;
+    if (before && recordStarts.back() >= resume)
+    {
+        recordStarts.pop_back();
+        pending = before - 1;
+    }
+    source = std::move(grown);
+    indexLines(nullptr, resume);
+    size_t count = recordStarts.size();
+    if (count > UINT32_MAX)
+        throw std::length_error("container has too many elements to display");
+
+    if (rootNode->childrenBuilt && count > 0)
+    {
+        Node *block = rootNode->children;
+        if (pending < before)
         {
-            if (c == '"')
+            // Parse the unfinished record again when it is next shown,
+            // unless it is open and its contents are on screen.
+            Node &node = block[pending];
+            if (!node.expanded)
             {
-                inString = true;
-                processed.push_back(c);
-                ++i;
-            }
-            else if (contents.compare(i, 3, "NaN") == 0)
-            {
-                processed += "\"__JSON_VIEW_NaN__\"";
-                i += 3;
+                released = true;
+                release(&node);
             }
-            else if (contents.compare(i, 8, "Infinity") == 0)
+        }
+        size_t capacity = block ? blockHeader(block).capacity : 0;
+        bool relocated = count > capacity;
+        if (relocated)
+        {
+            // Grow geometrically so a steadily written file moves its
+            // records only a logarithmic number of times.
+            Node *grownBlock = allocateBlock(std::max({count, 2 * capacity, kFenwickMinBlock}));
+            std::copy(block, block + before, grownBlock);
+            for (size_t i = 0; i < before; ++i)
             {
-                processed += "\"__JSON_VIEW_INF__\"";
-                i += 8;
+                for (Node &child : builtChildren(&grownBlock[i]))
+                    child.parent = &grownBlock[i];
             }
-            else if (contents.compare(i, 9, "-Infinity") == 0)
+            if (!tracked.empty())
             {
-                processed += "\"__JSON_VIEW_NEG_INF__\"";
-                i += 9;
+                std::unordered_map<const Node *, ParsedValue> rekeyed;
+                for (const auto &[node, value] : tracked)
+                    rekeyed[node >= block && node < block + before ? grownBlock + (node - block) : node] = value;
+                tracked.swap(rekeyed);
             }
-            else
+            rootNode->children = block = grownBlock;
+            moved = before > 0;
+        }
+        for (size_t i = before; i < count; ++i)
+            block[i].parent = rootNode;
+        if (before)
+            block[before - 1].isLastChild = false;
+        if (count)
+            block[count - 1].isLastChild = true;
+        rootNode->childCount = static_cast<uint32_t>(count);
+        NodeBlockHeader &header = blockHeader(block);
+        if (relocated)
+            rebuildFenwick(rootNode);
+        else if (header.fenwick)
+        {
+            // New records are one collapsed row each.
+            for (size_t index = before + 1; index <= count; ++index)
             {
-                processed.push_back(c);
-                ++i;
+                for (size_t i = index; i <= header.capacity; i += i & (~i + 1))
+                    ++header.fenwick[i];
             }
         }
     }
+    rootNode->visibleCount = 1 + (rootNode->expanded ? childRows(rootNode) : 0);
+    return count - before;
+}
 
-    json j = json::parse(processed);
-    replaceSpecialStrings(j);
-    return j;
+size_t VisibleRows::size() const
+{
+    size_t total = 0;
+    for (const Node *root : roots)
+        total += root->visibleCount;
+    return total;
+}
+
+// The node shown on a given row, building children on the way down when
+// an expanded node has not been materialised yet.
+const Node *VisibleRows::operator[](size_t row) const
+{
+    PerfTimer timer(PerfPhase::VisibleRows);
+    uint64_t offset = row;
+    const Node *cur = nullptr;
+    for (const Node *root : roots)
+    {
+        if (offset < root->visibleCount)
+        {
+            cur = root;
+            break;
+        }
+        offset -= root->visibleCount;
+    }
+    while (cur && offset > 0)
+    {
+        offset -= 1;
+        ensureChildren(cur);
+        cur = childAtRow(cur, offset);
+    }
+    return cur;
+}
+
+size_t VisibleRows::indexOf(const Node *node) const
+{
+    PerfTimer timer(PerfPhase::VisibleRows);
+    uint64_t row = 0;
+    const Node *cur = node;
+    for (; cur->parent; cur = cur->parent)
+    {
+        if (!cur->parent->expanded)
+            return npos;
+        row += 1 + rowsBefore(cur->parent, childIndex(cur));
+    }
+    for (const Node *root : roots)
+    {
+        if (root == cur)
+            return row;
+        row += root->visibleCount;
+    }
+    return npos;
+}
+
+static void collectVisibleNodes(const Node *node, std::vector<const Node *> &out)
+{
+    out.push_back(node);
+    if (node->expanded)
+    {
+        for (const Node &child : ensureChildren(node))
+        {
+            collectVisibleNodes(&child, out);
+        }
+    }
+}
+
+// Recursively collect all nodes that are currently visible.  A node is
+// visible if it is a root or its parent is expanded.
+void collectVisible(const Node *node, std::vector<const Node *> &out)
+{
+    PerfTimer timer(PerfPhase::VisibleRows);
+    collectVisibleNodes(node, out);
+}
+
+// Build the tree prefix for a node.  This string contains the
+// vertical bar and branch characters needed to draw a proper tree.
+std::string buildPrefix(const Node *node)
+{
+    static constexpr std::string_view pipe = "│   ";
+    static constexpr std::string_view blank = "    ";
+    static constexpr std::string_view tee = "├── ";
+    static constexpr std::string_view corner = "└── ";
+    if (node->parent == nullptr)
+        return std::string();
+
+    // One pass up the parent chain sizes the string, a second fills it in
+    // from the right, so the prefix is built without reallocating.
+    // The dummy root (it has no parent) is skipped so its isLastChild
+    // flag doesn’t affect vertical lines for deeper levels.
+    std::string_view branch = node->isLastChild ? corner : tee;
+    size_t length = branch.size();
+    for (const Node *parent = node->parent; parent->parent != nullptr; parent = parent->parent)
+        length += parent->isLastChild ? blank.size() : pipe.size();
+
+    std::string prefix(length, ' ');
+    char *out = prefix.data() + length;
+    out -= branch.size();
+    std::memcpy(out, branch.data(), branch.size());
+    for (const Node *parent = node->parent; parent->parent != nullptr; parent = parent->parent)
+    {
+        std::string_view segment = parent->isLastChild ? blank : pipe;
+        out -= segment.size();
+        std::memcpy(out, segment.data(), segment.size());
+    }
+    return prefix;
+}
+
+// Shorten a file path to fit within maxWidth by replacing middle parts with "..."
+std::string shortenPath(const std::string &path, int maxWidth)
+{
+    if (getDisplayWidth(path) <= maxWidth)
+    {
+        return path;
+    }
+
+    // Find the filename (last component)
+    size_t lastSlash = path.find_last_of('/');
+    if (lastSlash == std::string::npos)
+    {
+        // No slash found, just truncate the string
+        return path.substr(0, maxWidth - 3) + "...";
+    }
+
+    std::string filename = path.substr(lastSlash + 1);
+    std::string directory = path.substr(0, lastSlash);
+
+    // If filename alone is too long, truncate it
+    if (getDisplayWidth(filename) > maxWidth - 4)
+    { // -4 for ".../"
+        return ".../" + filename.substr(0, maxWidth - 7) + "...";
+    }
+
+    // Calculate remaining space for directory
+    int remainingSpace = maxWidth - getDisplayWidth(filename) - 1; // -1 for the slash
+
+    if (getDisplayWidth(directory) <= remainingSpace)
+    {
+        return path; // Original fits
+    }
+
+    // Need to shorten directory part
+    // Strategy: keep start and end of path, replace middle with "..."
+    int prefixLen = std::max(1, remainingSpace / 3);
+    int suffixLen = std::max(1, remainingSpace - prefixLen - 3); // -3 for "..."
+
+    if (prefixLen + suffixLen + 3 >= getDisplayWidth(directory))
+    {
+        return path; // Would not actually shorten
+    }
+
+    std::string prefix = directory.substr(0, prefixLen);
+    std::string suffix = directory.substr(directory.length() - suffixLen);
+
+    return prefix + "..." + suffix + "/" + filename;
+}
+
+// Get the type icon for a node
+std::string getTypeIcon(const Node *node)
+{
+    if (node->isDummyRoot)
+    {
+        return ""; // No icons for dummy roots
+    }
+
+    const json *v = nodeValue(node);
+    if (!v)
+        return ""; // Unparsed containers are never empty dictionaries
+    if (v->is_string())
+        return "℀ ";
+    else if (v->is_boolean())
+        return v->get<bool>() ? "☒ " : "☐ ";
+    else if (v->is_number())
+        return "⅑ ";
+    else if (v->is_null())
+        return "⊘ ";
+    else if (v->is_object() && v->empty())
+        return "⁞ "; // Only for empty dictionaries
+    else if (v->is_array())
+        return ""; // No icon for arrays
+    else if (v->is_object())
+        return ""; // No icon for non-empty objects
+    return "";
+}
+
+// Append one character of a string value as it is displayed and return
+// its width in columns; `i` moves past it.  Control characters are
+// escaped, and with `quoted` also quotes and backslashes, as inside a
+// JSON string.
+static int appendDisplayChar(std::string_view text, size_t &i, bool quoted, std::string &out)
+{
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (c < 0x80)
+    {
+        ++i;
+        const char *escape = nullptr;
+        if (c == '\\' && quoted)
+            escape = "\\\\";
+        else if (c == '\"' && quoted)
+            escape = "\\\"";
+        else if (c == '\n')
+            escape = "\\n";
+        else if (c == '\r')
+            escape = "\\r";
+        else if (c == '\t')
+            escape = "\\t";
+        if (escape)
+        {
+            out += escape;
+            return 2;
+        }
+        if (c < 0x20)
+        {
+            char buf[7];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+            out += buf;
+            return 6;
+        }
+        out += static_cast<char>(c);
+        return 1;
+    }
+    std::mbstate_t state{};
+    wchar_t wc;
+    size_t n = mbrtowc(&wc, text.data() + i, std::min<size_t>(text.size() - i, MB_LEN_MAX), &state);
+    if (n == 0 || n == (size_t)-1 || n == (size_t)-2)
+    {
+        // Not valid UTF-8: pass the byte on as one column
+        out += static_cast<char>(c);
+        ++i;
+        return 1;
+    }
+    out.append(text.data() + i, n);
+    i += n;
+    int w = wcwidth(wc);
+    return w < 0 ? static_cast<int>(n) : w;
+}
+
+std::string labelText(std::string_view text, int maxWidth, bool *truncated)
+{
+    std::string out;
+    int width = 0;
+    // Length of `out` that still leaves room for the "..." of a cut
+    size_t fits = 0;
+    for (size_t i = 0; i < text.size();)
+    {
+        int w = appendDisplayChar(text, i, true, out);
+        if (width + w > maxWidth)
+        {
+            out.resize(fits);
+            out += "...";
+            if (truncated)
+                *truncated = true;
+            return out;
+        }
+        width += w;
+        if (width <= maxWidth - 3)
+            fits = out.size();
+    }
+    if (truncated)
+        *truncated = false;
+    return out;
+}
+
+size_t pagerLine(std::string_view text, size_t from, int width, std::string &line)
+{
+    line.clear();
+    int used = 0;
+    size_t i = from;
+    while (i < text.size())
+    {
+        if (text[i] == '\n')
+            return i + 1;
+        size_t start = i;
+        size_t length = line.size();
+        int w = appendDisplayChar(text, i, false, line);
+        if (used + w > width && used > 0)
+        {
+            line.resize(length);
+            return start;
+        }
+        used += w;
+    }
+    return text.size();
+}
+
+// Get the content without type icon
+std::string getContentLabel(const Node *node, int maxWidth)
+{
+    const json *v = nodeValue(node);
+    // Containers of indexed documents may be known only by their span.
+    bool object = v ? v->is_object() : isUnparsedObject(node);
+    bool list = v ? v->is_array() : !object;
+    if (node->isDummyRoot)
+    {
+        std::string type;
+        if (!v && NodeTree::owner(node)->isRecordList())
+        {
+            size_t count = nodeSize(node);
+            type = "🗂️ lines, " + std::to_string(count) + (count == 1 ? " record" : " records");
+        }
+        else if (object)
+        {
+            size_t count = nodeSize(node);
+            type = "📦 dictionary, " + std::to_string(count) + (count == 1 ? " key" : " keys");
+        }
+        else if (list)
+        {
+            size_t count = nodeSize(node);
+            type = "🗂️ list, " + std::to_string(count) + (count == 1 ? " item" : " items");
+        }
+        else if (v->is_string())
+            type = "℀ string";
+        else if (v->is_number())
+            type = "⅑ number";
+        else if (v->is_boolean())
+            type = "☒ boolean";
+        else if (v->is_null())
+            type = "⊘ null";
+        else
+            type = "📄 value";
+
+        // Add file size information from stored file sizes
+        auto it = fileSizes.find(nodeKey(node));
+        if (it != fileSizes.end())
+        {
+            std::string fileSizeStr = formatFileSize(it->second);
+            type += ", " + fileSizeStr;
+        }
+
+        // Shorten the filename for display
+        std::string shortKey = shortenPath(nodeKey(node), maxWidth - getDisplayWidth(type) - 4); // -4 for " ()"
+        return shortKey + " (" + type + ")";
+    }
+
+    // For objects and arrays, no icons for expandable items
+    if (object)
+    {
+        size_t count = nodeSize(node);
+        return nodeKey(node) + " (dictionary, " + std::to_string(count) + (count == 1 ? " key)" : " keys)");
+    }
+    else if (list)
+    {
+        size_t count = nodeSize(node);
+        std::string baseLabel = nodeKey(node) + " (list, " + std::to_string(count) + (count == 1 ? " item)" : " items)");
+
+        // Array previews are rendered directly in drawLine; return base label only
+        return baseLabel;
+    }
+    else if (v->is_string())
+    {
+        // Only as much of the string as fits is escaped and measured
+        std::string key = nodeKey(node);
+        int valueWidth = std::max(maxWidth - getDisplayWidth(key) - 4, 8); // -4 for ': ""'
+        return key + ": \"" + labelText(v->get_ref<const std::string &>(), valueWidth) + "\"";
+    }
+    else if (v->is_boolean())
+    {
+        return nodeKey(node) + ": " + std::string(v->get<bool>() ? "true" : "false");
+    }
+    else if (v->is_number())
+    {
+        return nodeKey(node) + ": " + v->dump();
+    }
+    else if (v->is_null())
+    {
+        return nodeKey(node) + ": null";
+    }
+    else
+    {
+        // Fallback for other types
+        return nodeKey(node);
+    }
+}
+
+// Get the content label with search match information
+std::string getContentLabelWithSearch(const Node *node, const SearchState &search, int maxWidth)
+{
+    // For non-dummy root nodes, just use the original function
+    if (!node->isDummyRoot)
+    {
+        return getContentLabel(node, maxWidth);
+    }
+
+    // For dummy root nodes, add search match count if search is active
+    std::string baseLabel = getContentLabel(node, maxWidth);
+
+    if (!search.term.empty() && !search.matches.empty())
+    {
+        // Count matches that belong to this dummy root's subtree
+        size_t matchCount = search.matchCount(node);
+
+        if (matchCount > 0)
+        {
+            // Find the closing parenthesis in the base label
+            size_t closeParenPos = baseLabel.rfind(')');
+            if (closeParenPos != std::string::npos)
+            {
+                // Insert the match count before the closing parenthesis
+                std::string matchInfo = ", 🔍 " + std::to_string(matchCount) + (matchCount == 1 ? " match" : " matches");
+                baseLabel.insert(closeParenPos, matchInfo);
+            }
+        }
+    }
+
+    return baseLabel;
+}
+
+// Generate a preview of array values for inline display
+// (arrayPreview removed; previews are rendered directly in drawLine)
+
+// Collapse every branch of the given node.  When keepRoot is true the
+// top‑level node remains expanded so the structure of the document is
+// still visible.  Children that were never materialised are collapsed
+// already, so only the built part of the tree is walked.
+static void collapseAllFlags(Node *node, bool keepRoot)
+{
+    if (!node->isDummyRoot || !keepRoot)
+    {
+        node->expanded = false;
+    }
+    for (Node &child : builtChildren(node))
+    {
+        collapseAllFlags(&child, false);
+    }
+}
+
+void collapseAll(Node *node, bool keepRoot)
+{
+    collapseAllFlags(node, keepRoot);
+    refreshVisibleCounts(node);
+}
+
+Expansion::Expansion(std::vector<Node *> roots, int maxLevel)
+    : roots(std::move(roots)), maxLevel(maxLevel)
+{
+}
+
+// Open a node and queue its children.  Counts are kept current as nodes
+// open, so a step costs what it expands, not what is expanded already.
+void Expansion::open(Node *node, int level)
+{
+    added += ensureChildren(node).size();
+    setExpanded(node, true);
+    frames.push_back(Frame{node, 0, level});
+}
+
+bool Expansion::step(uint64_t rowBudget)
+{
+    if (!started && maxLevel != unlimited)
+    {
+        // Expanding to a level starts from a collapsed tree.  Children
+        // that were never materialised are collapsed already.
+        for (Node *root : roots)
+        {
+            collapseAllFlags(root, false);
+            refreshVisibleCounts(root);
+        }
+    }
+    started = true;
+
+    uint64_t stop = rowBudget > UINT64_MAX - added ? UINT64_MAX : added + rowBudget;
+    while (added < stop)
+    {
+        if (frames.empty())
+        {
+            if (nextRoot == roots.size())
+                break;
+            Node *root = roots[nextRoot++];
+            if (maxLevel > 0)
+                open(root, 0);
+            continue;
+        }
+        Frame &frame = frames.back();
+        std::span<Node> children = builtChildren(frame.node);
+        if (frame.next == children.size())
+        {
+            frames.pop_back();
+            continue;
+        }
+        Node *child = &children[frame.next++];
+        int level = frame.level + 1;
+        if (level < maxLevel && hasChildren(child))
+            open(child, level);
+    }
+    return done();
+}
+
+void expandAll(Node *node)
+{
+    Expansion({node}).step();
+}
+
+// Expand nodes up to a specific nesting level.
+// Level 0 means collapse all, level 1 means show only first level, etc.
+void expandToLevel(Node *node, int targetLevel, int currentLevel)
+{
+    Expansion({node}, std::max(targetLevel - currentLevel, 0)).step();
+}
+
+void SearchState::addMatches(std::span<const Node *const> found)
+{
+    for (const Node *match : found)
+    {
+        matchPositions.emplace(match, matches.size());
+        matches.push_back(match);
+        const Node *root = match;
+        while (root->parent != nullptr)
+            root = root->parent;
+        ++rootMatchCounts[root];
+    }
+}
+
+void SearchState::clearMatches()
+{
+    matches.clear();
+    matchPositions.clear();
+    rootMatchCounts.clear();
+    changes.clear();
+}
+
+size_t SearchState::matchPosition(const Node *node) const
+{
+    auto it = matchPositions.find(node);
+    return it != matchPositions.end() ? it->second : npos;
+}
+
+size_t SearchState::matchCount(const Node *root) const
+{
+    auto it = rootMatchCounts.find(root);
+    return it != rootMatchCounts.end() ? it->second : 0;
+}
+
+const DiffChange *SearchState::change(const Node *node) const
+{
+    auto it = changes.find(node);
+    return it != changes.end() ? &it->second : nullptr;
+}
+
+// Recursively search for nodes matching the given search term.  Both
+// keys and values can be searched.  The search term and the
+// candidates are compared in lowercase to achieve case‑insensitive
+// matching.  When searching values, primitive values are converted to
+// their JSON string representation.  This runs a SearchJob and waits
+// for it to finish.
+void searchTree(const Node *node, const std::string &term,
+                       bool searchKeys, bool searchValues,
+                       std::vector<const Node *> &out)
+{
+    if (term.empty())
+        return;
+    SearchJob job({node}, term, searchKeys, searchValues);
+    job.wait();
+    job.collect(out);
+}
+
+namespace
+{
+constexpr unsigned char asciiLower(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c | 0x20) : c;
+}
+
+constexpr unsigned char asciiUpper(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') ? static_cast<unsigned char>(c & ~0x20) : c;
+}
+
+bool equalFolded(const char *text, const char *foldedNeedle, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (asciiLower(static_cast<unsigned char>(text[i])) != static_cast<unsigned char>(foldedNeedle[i]))
+            return false;
+    }
+    return true;
+}
+
+// Decode UTF-8 and fold each code point with towlower().  Bytes that are
+// not part of a valid sequence are kept as themselves so they can still
+// match literally.
+void foldUtf8(std::string_view text, std::u32string &out)
+{
+    out.clear();
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(text.data());
+    const unsigned char *end = p + text.size();
+    while (p < end)
+    {
+        char32_t cp = *p;
+        size_t length = 1;
+        if (cp >= 0xC0 && cp < 0xE0 && end - p >= 2 && (p[1] & 0xC0) == 0x80)
+        {
+            cp = ((cp & 0x1F) << 6) | (p[1] & 0x3F);
+            length = 2;
+        }
+        else if (cp >= 0xE0 && cp < 0xF0 && end - p >= 3 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80)
+        {
+            cp = ((cp & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+            length = 3;
+        }
+        else if (cp >= 0xF0 && cp < 0xF8 && end - p >= 4 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80 &&
+                 (p[3] & 0xC0) == 0x80)
+        {
+            cp = ((cp & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+            length = 4;
+        }
+        out.push_back(static_cast<char32_t>(towlower(static_cast<wint_t>(cp))));
+        p += length;
+    }
+}
+} // namespace
+
+CaseInsensitiveMatcher::CaseInsensitiveMatcher(std::string_view needle)
+{
+    for (char c : needle)
+    {
+        if (static_cast<unsigned char>(c) & 0x80)
+            ascii = false;
+        folded.push_back(static_cast<char>(asciiLower(static_cast<unsigned char>(c))));
+    }
+    foldUtf8(needle, wide);
+}
+
+bool CaseInsensitiveMatcher::matches(std::string_view haystack) const
+{
+    if (wide.empty())
+        return true;
+    if (!ascii)
+        return findUnicode(haystack);
+    bool sawNonAscii = false;
+    if (findAscii(haystack, sawNonAscii))
+        return true;
+    // A few non-ASCII characters fold to ASCII letters (the Kelvin sign,
+    // dotted capital I), so only a pure ASCII miss is final.
+    return sawNonAscii && findUnicode(haystack);
+}
+
+bool CaseInsensitiveMatcher::findAscii(std::string_view haystack, bool &sawNonAscii) const
+{
+    const size_t m = folded.size();
+    const size_t n = haystack.size();
+    if (n < m)
+    {
+        for (char c : haystack)
+            sawNonAscii |= (static_cast<unsigned char>(c) & 0x80) != 0;
+        return false;
+    }
+    const char *p = haystack.data();
+    const unsigned char first = static_cast<unsigned char>(folded[0]);
+    const unsigned char last = static_cast<unsigned char>(folded[m - 1]);
+    // Bytes between the first and last that still need comparing.
+    const size_t middle = m > 2 ? m - 2 : 0;
+    const size_t candidates = n - m + 1;
+    size_t i = 0;
+    unsigned highBits = 0;
+
+#if defined(__SSE2__)
+    const __m128i first1 = _mm_set1_epi8(static_cast<char>(first));
+    const __m128i first2 = _mm_set1_epi8(static_cast<char>(asciiUpper(first)));
+    const __m128i last1 = _mm_set1_epi8(static_cast<char>(last));
+    const __m128i last2 = _mm_set1_epi8(static_cast<char>(asciiUpper(last)));
+    for (; i + 16 <= candidates; i += 16)
+    {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + m - 1));
+        highBits |= static_cast<unsigned>(_mm_movemask_epi8(head));
+        __m128i eqFirst = _mm_or_si128(_mm_cmpeq_epi8(head, first1), _mm_cmpeq_epi8(head, first2));
+        __m128i eqLast = _mm_or_si128(_mm_cmpeq_epi8(tail, last1), _mm_cmpeq_epi8(tail, last2));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast)));
+        while (mask)
+        {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (equalFolded(p + i + bit + 1, folded.data() + 1, middle))
+                return true;
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t first1 = vdupq_n_u8(first);
+    const uint8x16_t first2 = vdupq_n_u8(asciiUpper(first));
+    const uint8x16_t last1 = vdupq_n_u8(last);
+    const uint8x16_t last2 = vdupq_n_u8(asciiUpper(last));
+    for (; i + 16 <= candidates; i += 16)
+    {
+        uint8x16_t head = vld1q_u8(reinterpret_cast<const uint8_t *>(p + i));
+        uint8x16_t tail = vld1q_u8(reinterpret_cast<const uint8_t *>(p + i + m - 1));
+        highBits |= vmaxvq_u8(head) >> 7;
+        uint8x16_t eq = vandq_u8(vorrq_u8(vceqq_u8(head, first1), vceqq_u8(head, first2)),
+                                 vorrq_u8(vceqq_u8(tail, last1), vceqq_u8(tail, last2)));
+        // Narrow to four bits per byte to get a scalar candidate mask.
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (mask)
+        {
+            unsigned bit = static_cast<unsigned>(__builtin_ctzll(mask)) >> 2;
+            if (equalFolded(p + i + bit + 1, folded.data() + 1, middle))
+                return true;
+            mask &= ~(0xFULL << (bit * 4));
+        }
+    }
+#endif
+
+    for (; i < candidates; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(p[i]);
+        highBits |= c & 0x80;
+        if (asciiLower(c) == first && asciiLower(static_cast<unsigned char>(p[i + m - 1])) == last &&
+            equalFolded(p + i + 1, folded.data() + 1, middle))
+            return true;
+    }
+    // The last m - 1 bytes are never a candidate start.
+    for (size_t k = candidates; k < n; ++k)
+        highBits |= static_cast<unsigned char>(p[k]) & 0x80;
+    sawNonAscii = highBits != 0;
+    return false;
+}
+
+bool CaseInsensitiveMatcher::findUnicode(std::string_view haystack) const
+{
+    thread_local std::u32string text;
+    foldUtf8(haystack, text);
+    return std::u32string_view(text).find(wide) != std::u32string_view::npos;
+}
+
+// The text a value is matched against in value searches: string contents,
+// the formatted number, or the type name shown for containers.
+static bool valueMatches(const json &v, const CaseInsensitiveMatcher &matcher)
+{
+    switch (v.type())
+    {
+    case json::value_t::string:
+        return matcher.matches(v.get_ref<const std::string &>());
+    case json::value_t::boolean:
+        return matcher.matches(v.get<bool>() ? "true" : "false");
+    case json::value_t::number_integer:
+    case json::value_t::number_unsigned:
+    {
+        char buf[24];
+        auto res = v.is_number_unsigned() ? std::to_chars(buf, buf + sizeof(buf), v.get<uint64_t>())
+                                          : std::to_chars(buf, buf + sizeof(buf), v.get<int64_t>());
+        return matcher.matches(std::string_view(buf, static_cast<size_t>(res.ptr - buf)));
+    }
+    case json::value_t::number_float:
+    {
+        // Formatted as dump() would, without allocating
+        double d = v.get<double>();
+        if (!std::isfinite(d))
+            return matcher.matches("null");
+        char buf[64];
+        char *end = nlohmann::detail::to_chars(buf, buf + sizeof(buf), d);
+        return matcher.matches(std::string_view(buf, static_cast<size_t>(end - buf)));
+    }
+    case json::value_t::null:
+        return matcher.matches("null");
+    case json::value_t::object:
+        return matcher.matches("dictionary");
+    case json::value_t::array:
+        return matcher.matches("list");
+    default:
+        return matcher.matches(v.dump());
+    }
+}
+
+// Recursive descent over the query text; steps and filter expressions are
+// appended to the query as they are recognised.
+class Query::Parser
+{
+public:
+    Parser(Query &query, std::string_view text) : query(query), text(text) {}
+
+    bool parse(std::string &error)
+    {
+        skipSpace();
+        if (!eat('$'))
+            return failed("a query starts with $", error);
+        while (skipSpace(), pos < text.size())
+        {
+            Step step;
+            if (eat('.'))
+            {
+                step.recursive = eat('.');
+                if (step.recursive && peek('['))
+                {
+                    if (!bracket(step))
+                        return failed(nullptr, error);
+                }
+                else if (eat('*'))
+                    step.kind = Step::Kind::Wildcard;
+                else if (step.kind = Step::Kind::Name, !name(step.name))
+                    return failed("expected a member name", error);
+            }
+            else if (peek('['))
+            {
+                if (!bracket(step))
+                    return failed(nullptr, error);
+            }
+            else
+                return failed("expected . or [", error);
+            if (query.steps.size() == 63)
+                return failed("too many steps", error);
+            query.steps.push_back(std::move(step));
+        }
+        return true;
+    }
+
+private:
+    bool failed(const char *what, std::string &error)
+    {
+        if (what)
+            message = what;
+        error = message + " at column " + std::to_string(pos + 1);
+        return false;
+    }
+    bool fail(const char *what)
+    {
+        if (message.empty())
+            message = what;
+        return false;
+    }
+    void skipSpace()
+    {
+        while (pos < text.size() && isJsonSpace(text[pos]))
+            ++pos;
+    }
+    bool peek(char c) const { return pos < text.size() && text[pos] == c; }
+    bool eat(char c)
+    {
+        if (!peek(c))
+            return false;
+        ++pos;
+        return true;
+    }
+    bool eat(std::string_view token)
+    {
+        if (text.substr(pos, token.size()) != token)
+            return false;
+        pos += token.size();
+        return true;
+    }
+
+    // A bare member name runs to the next operator or bracket.
+    bool name(std::string &out)
+    {
+        size_t begin = pos;
+        while (pos < text.size() && !isJsonSpace(text[pos]) && !std::strchr(".[]()'\"=!<>&|@$*,", text[pos]))
+            ++pos;
+        out.assign(text.substr(begin, pos - begin));
+        return !out.empty();
+    }
+    bool quoted(std::string &out)
+    {
+        char quote = text[pos++];
+        out.clear();
+        while (pos < text.size() && text[pos] != quote)
+        {
+            if (text[pos] == '\\' && pos + 1 < text.size())
+                ++pos;
+            out += text[pos++];
+        }
+        if (!eat(quote))
+            return fail("unterminated string");
+        return true;
+    }
+    bool integer(int64_t &out)
+    {
+        const char *begin = text.data() + pos;
+        auto res = std::from_chars(begin, text.data() + text.size(), out);
+        if (res.ec != std::errc())
+            return fail("expected an index");
+        pos += static_cast<size_t>(res.ptr - begin);
+        return true;
+    }
+
+    // [name], [index], [*] or [?(filter)]
+    bool bracket(Step &step)
+    {
+        eat('[');
+        skipSpace();
+        if (peek('\'') || peek('"'))
+        {
+            step.kind = Step::Kind::Name;
+            if (!quoted(step.name))
+                return false;
+        }
+        else if (eat('*'))
+            step.kind = Step::Kind::Wildcard;
+        else if (eat('?'))
+        {
+            step.kind = Step::Kind::Filter;
+            skipSpace();
+            if (!eat('('))
+                return fail("expected ( after ?");
+            if (!orExpr(step.filter))
+                return false;
+            skipSpace();
+            if (!eat(')'))
+                return fail("expected )");
+        }
+        else
+        {
+            step.kind = Step::Kind::Index;
+            if (!integer(step.index))
+                return false;
+        }
+        skipSpace();
+        return eat(']') || fail("expected ]");
+    }
+
+    size_t add(Expr expr)
+    {
+        query.exprs.push_back(std::move(expr));
+        return query.exprs.size() - 1;
+    }
+    bool orExpr(size_t &out)
+    {
+        if (!andExpr(out))
+            return false;
+        while (skipSpace(), eat("||"))
+        {
+            Expr expr{Expr::Op::Or};
+            expr.left = out;
+            if (!andExpr(expr.right))
+                return false;
+            out = add(std::move(expr));
+        }
+        return true;
+    }
+    bool andExpr(size_t &out)
+    {
+        if (!unary(out))
+            return false;
+        while (skipSpace(), eat("&&"))
+        {
+            Expr expr{Expr::Op::And};
+            expr.left = out;
+            if (!unary(expr.right))
+                return false;
+            out = add(std::move(expr));
+        }
+        return true;
+    }
+    bool unary(size_t &out)
+    {
+        skipSpace();
+        if (peek('!') && text.substr(pos, 2) != "!=")
+        {
+            ++pos;
+            Expr expr{Expr::Op::Not};
+            if (!unary(expr.left))
+                return false;
+            out = add(std::move(expr));
+            return true;
+        }
+        if (eat('('))
+        {
+            if (!orExpr(out))
+                return false;
+            skipSpace();
+            return eat(')') || fail("expected )");
+        }
+        return comparison(out);
+    }
+    bool comparison(size_t &out)
+    {
+        static const std::pair<std::string_view, Expr::Op> operators[] = {
+            {"==", Expr::Op::Equal},   {"!=", Expr::Op::NotEqual},     {"<=", Expr::Op::LessEqual},
+            {">=", Expr::Op::GreaterEqual}, {"<", Expr::Op::Less}, {">", Expr::Op::Greater},
+        };
+        Expr expr{Expr::Op::Exists};
+        if (!operand(expr.a))
+            return false;
+        skipSpace();
+        for (const auto &[token, op] : operators)
+        {
+            if (eat(token))
+            {
+                expr.op = op;
+                if (!operand(expr.b))
+                    return false;
+                break;
+            }
+        }
+        if (expr.op == Expr::Op::Exists && !expr.a.isPath)
+            return fail("expected a comparison");
+        out = add(std::move(expr));
+        return true;
+    }
+    bool operand(Operand &out)
+    {
+        skipSpace();
+        if (eat('@'))
+        {
+            out.isPath = true;
+            for (;;)
+            {
+                PathItem item;
+                if (eat('.'))
+                {
+                    if (!name(item.name))
+                        return fail("expected a member name");
+                }
+                else if (peek('['))
+                {
+                    ++pos;
+                    skipSpace();
+                    if (peek('\'') || peek('"'))
+                    {
+                        if (!quoted(item.name))
+                            return false;
+                    }
+                    else if (!integer(item.index))
+                        return false;
+                    else
+                        item.isIndex = true;
+                    skipSpace();
+                    if (!eat(']'))
+                        return fail("expected ]");
+                }
+                else
+                    return true;
+                out.path.push_back(std::move(item));
+            }
+        }
+        if (peek('\'') || peek('"'))
+        {
+            std::string value;
+            if (!quoted(value))
+                return false;
+            out.literal = std::move(value);
+            return true;
+        }
+        for (const char *word : {"true", "false", "null"})
+        {
+            if (eat(std::string_view(word)))
+            {
+                out.literal = json::parse(word);
+                return true;
+            }
+        }
+        size_t begin = pos;
+        while (pos < text.size() && std::strchr("+-.0123456789eE", text[pos]))
+            ++pos;
+        out.literal = json::parse(text.substr(begin, pos - begin), nullptr, false);
+        if (begin == pos || !out.literal.is_number())
+        {
+            pos = begin;
+            return fail("expected @, a number, a string, true, false or null");
+        }
+        return true;
+    }
+
+    Query &query;
+    std::string_view text;
+    size_t pos = 0;
+    std::string message;
+};
+
+bool Query::compile(std::string_view text, std::string &error)
+{
+    steps.clear();
+    exprs.clear();
+    return Parser(*this, text).parse(error);
+}
+
+bool Query::matchesFilter(size_t index, const json &value) const
+{
+    const Expr &expr = exprs[index];
+    // Paths that lead nowhere yield null.
+    auto resolve = [&](const Operand &operand) -> const json * {
+        if (!operand.isPath)
+            return &operand.literal;
+        const json *v = &value;
+        for (const PathItem &item : operand.path)
+        {
+            if (item.isIndex)
+            {
+                if (!v->is_array())
+                    return nullptr;
+                int64_t at = item.index < 0 ? static_cast<int64_t>(v->size()) + item.index : item.index;
+                if (at < 0 || static_cast<uint64_t>(at) >= v->size())
+                    return nullptr;
+                v = &(*v)[static_cast<size_t>(at)];
+            }
+            else
+            {
+                if (!v->is_object())
+                    return nullptr;
+                auto it = v->find(item.name);
+                if (it == v->end())
+                    return nullptr;
+                v = &*it;
+            }
+        }
+        return v;
+    };
+    // Numbers order numerically and strings bytewise; nothing else orders.
+    auto less = [](const json *a, const json *b) {
+        if (!a || !b)
+            return false;
+        if (a->is_number() && b->is_number())
+            return *a < *b;
+        if (a->is_string() && b->is_string())
+            return a->get_ref<const std::string &>() < b->get_ref<const std::string &>();
+        return false;
+    };
+    auto equal = [](const json *a, const json *b) { return a && b ? *a == *b : a == b; };
+
+    switch (expr.op)
+    {
+    case Expr::Op::Or:
+        return matchesFilter(expr.left, value) || matchesFilter(expr.right, value);
+    case Expr::Op::And:
+        return matchesFilter(expr.left, value) && matchesFilter(expr.right, value);
+    case Expr::Op::Not:
+        return !matchesFilter(expr.left, value);
+    case Expr::Op::Exists:
+        return resolve(expr.a) != nullptr;
+    default:
+        break;
+    }
+    const json *a = resolve(expr.a);
+    const json *b = resolve(expr.b);
+    switch (expr.op)
+    {
+    case Expr::Op::Equal:
+        return equal(a, b);
+    case Expr::Op::NotEqual:
+        return !equal(a, b);
+    case Expr::Op::Less:
+        return less(a, b);
+    case Expr::Op::LessEqual:
+        return less(a, b) || (a && b && (a->is_number() || a->is_string()) && equal(a, b));
+    case Expr::Op::Greater:
+        return less(b, a);
+    case Expr::Op::GreaterEqual:
+        return less(b, a) || (a && b && (a->is_number() || a->is_string()) && equal(a, b));
+    default:
+        return false;
+    }
+}
+
+const Node *resolvePointer(const Node *root, std::string_view pointer, std::string &error)
+{
+    if (!pointer.empty() && pointer[0] != '/')
+    {
+        error = "A JSON Pointer starts with /";
+        return nullptr;
+    }
+    const Node *node = root;
+    size_t pos = 0;
+    while (pos < pointer.size())
+    {
+        size_t end = std::min(pointer.find('/', pos + 1), pointer.size());
+        std::string token;
+        for (size_t i = pos + 1; i < end; ++i)
+        {
+            if (pointer[i] != '~')
+                token += pointer[i];
+            else if (i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1'))
+                token += pointer[++i] == '0' ? '~' : '/';
+            else
+            {
+                error = "Invalid escape in " + std::string(pointer.substr(0, end));
+                return nullptr;
+            }
+        }
+        std::span<Node> children = ensureChildren(node);
+        const Node *next = nullptr;
+        if (!children.empty() && children.front().name)
+        {
+            auto it = std::lower_bound(children.begin(), children.end(), token,
+                                       [](const Node &child, const std::string &key) { return *child.name < key; });
+            if (it != children.end() && *it->name == token)
+                next = &*it;
+        }
+        else if (!token.empty() && token.size() < 20 && (token == "0" || token[0] != '0') &&
+                 std::all_of(token.begin(), token.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        {
+            uint64_t index = std::stoull(token);
+            if (index < children.size())
+                next = &children[index];
+        }
+        if (!next)
+        {
+            error = "Nothing at " + std::string(pointer.substr(0, end));
+            return nullptr;
+        }
+        node = next;
+        pos = end;
+    }
+    return node;
+}
+
+// Slices per worker; more slices balance uneven documents better.
+static constexpr size_t kSlicesPerWorker = 16;
+
+// Differences between two documents.  Every container gets a content hash,
+// computed bottom-up by workers that each take a range of the top-level
+// children, so that the walk over both documents passes equal subtrees
+// without looking inside.  The hashes of a top-level child's containers
+// are kept in document order with the size of each one's subtree, which
+// is how the walk finds the hashes of a container's children from its
+// own.  Arrays are aligned on their equal elements: equal heads and
+// tails are skipped and the rest is matched up patience style, on
+// elements that occur once on each side, or by a longest common
+// subsequence where that finds none and the section is small.  Elements
+// left over with an equal on the other side have moved; the others are
+// paired up in order between the matched ones.
+class SearchJob::Diff
+{
+public:
+    enum class Type : uint8_t
+    {
+        Primitive,
+        Object,
+        Array,
+    };
+    // A container's hash and the number of containers in its subtree,
+    // itself included.  A member that looks like a container but does not
+    // parse is shown, and hashed, as its raw text; it gets an entry of
+    // size 0 so that its type can be corrected from it.
+    struct Entry
+    {
+        uint64_t hash = 0;
+        uint64_t size = 0;
+    };
+    // A member of a container being compared, or a document's root.
+    struct Child
+    {
+        std::string_view key;
+        uint64_t hash = 0;
+        Type type = Type::Primitive;
+        // Where the value is: parsed, a record of a line-delimited root,
+        // or else a span of the document's text.
+        const json *value = nullptr;
+        size_t record = SIZE_MAX;
+        ValueSpan span;
+        const Entry *entries = nullptr;
+    };
+    // A container opened for its children.
+    struct Open
+    {
+        const json *value = nullptr;
+        std::optional<json> parsed;
+        ValueSpan span;
+        const Entry *entries = nullptr;
+    };
+    struct Side
+    {
+        std::string_view text;
+        const NodeTree *records = nullptr;
+        Child self;
+        std::vector<Child> items;
+        // Container hashes of the items, by task
+        std::vector<std::vector<Entry>> entries;
+        std::vector<uint32_t> path;
+        Slice *slice = nullptr;
+    };
+
+    Diff(const std::atomic<bool> &stop) : stop(stop) {}
+
+    void describe(Side &side, const Node *root);
+    void hashItems(unsigned threads);
+    void walk();
+
+private:
+    static Type typeOf(const json &v);
+    static Type typeOf(std::string_view text, const ValueSpan &span);
+    uint64_t hashValue(const json &v, std::vector<Entry> &out) const;
+    uint64_t hashSpan(std::string_view text, const ValueSpan &span, std::vector<Entry> &out) const;
+    void hashRange(Side &side, size_t task);
+    void open(const Side &side, const Child &child, Open &out) const;
+    void children(const Side &side, const Open &open, std::vector<Child> &out, std::vector<SpanMember> &members) const;
+    void align(const std::vector<Child> &left, const std::vector<Child> &right, size_t leftBegin, size_t leftEnd,
+               size_t rightBegin, size_t rightEnd, std::vector<std::pair<size_t, size_t>> &matched) const;
+    void compare(const std::vector<Child> &left, const std::vector<Child> &right, bool object);
+    void compare(const Child &left, size_t leftIndex, const Child &right, size_t rightIndex);
+    void emit(int side, size_t index, DiffChange change);
+
+public:
+    Side sides[2];
+
+private:
+    const std::atomic<bool> &stop;
+    size_t width = 1;
+};
+
+namespace
+{
+uint64_t mixHash(uint64_t hash, uint64_t value)
+{
+    uint64_t x = hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+uint64_t stringHash(std::string_view text)
+{
+    return std::hash<std::string_view>()(text);
+}
+
+// Numbers that compare equal hash alike, whatever their representation.
+uint64_t primitiveHash(const json &v)
+{
+    switch (v.type())
+    {
+    case json::value_t::boolean:
+        return mixHash(2, v.get<bool>());
+    case json::value_t::number_integer:
+        return mixHash(3, static_cast<uint64_t>(v.get<int64_t>()));
+    case json::value_t::number_unsigned:
+    {
+        uint64_t u = v.get<uint64_t>();
+        return mixHash(u <= static_cast<uint64_t>(INT64_MAX) ? 3 : 4, u);
+    }
+    case json::value_t::number_float:
+    {
+        double d = v.get<double>();
+        if (d >= -9.2e18 && d <= 9.2e18 && d == std::trunc(d))
+            return mixHash(3, static_cast<uint64_t>(static_cast<int64_t>(d)));
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        return mixHash(4, bits);
+    }
+    case json::value_t::string:
+        return mixHash(5, stringHash(v.get_ref<const std::string &>()));
+    default:
+        return mixHash(1, 0);
+    }
+}
+} // namespace
+
+SearchJob::Diff::Type SearchJob::Diff::typeOf(const json &v)
+{
+    return v.is_object() ? Type::Object : v.is_array() ? Type::Array : Type::Primitive;
+}
+
+SearchJob::Diff::Type SearchJob::Diff::typeOf(std::string_view text, const ValueSpan &span)
+{
+    char first = text[span.begin];
+    return first == '{' ? Type::Object : first == '[' ? Type::Array : Type::Primitive;
+}
+
+// Runs on the owning thread: the top-level items of an indexed document
+// come from its built children.
+void SearchJob::Diff::describe(Side &side, const Node *root)
+{
+    NodeTree *tree = NodeTree::owner(root);
+    if (const json *v = nodeValue(root))
+    {
+        side.self.value = v;
+        side.self.type = typeOf(*v);
+        if (side.self.type == Type::Primitive)
+            return;
+        for (auto it = v->begin(); it != v->end(); ++it)
+        {
+            Child child;
+            if (v->is_object())
+                child.key = it.key();
+            child.value = &*it;
+            child.type = typeOf(*it);
+            side.items.push_back(child);
+        }
+        return;
+    }
+    if (tree->isRecordList())
+    {
+        side.records = tree;
+        side.self.type = Type::Array;
+        side.items.resize(tree->recordCount());
+        for (size_t i = 0; i < side.items.size(); ++i)
+            side.items[i].record = i;
+        return;
+    }
+    side.text = tree->text();
+    side.self.span = *nodeSpan(root);
+    side.self.type = typeOf(side.text, side.self.span);
+    std::span<Node> built = ensureChildren(root);
+    if (built.empty())
+        return;
+    // Only the byte ranges are read; the owning thread may cache child
+    // counts in the same spans meanwhile.
+    const ValueSpan *spans = blockHeader(built.data()).spans;
+    side.items.resize(built.size());
+    for (size_t i = 0; i < built.size(); ++i)
+    {
+        Child &child = side.items[i];
+        if (built[i].name)
+            child.key = *built[i].name;
+        child.span = ValueSpan{spans[i].begin, spans[i].end};
+        child.type = typeOf(side.text, child.span);
+    }
+}
+
+uint64_t SearchJob::Diff::hashValue(const json &v, std::vector<Entry> &out) const
+{
+    Type type = typeOf(v);
+    if (type == Type::Primitive)
+        return primitiveHash(v);
+    size_t at = out.size();
+    out.emplace_back();
+    uint64_t hash = static_cast<uint64_t>(type) + 6;
+    for (auto it = v.begin(); it != v.end(); ++it)
+    {
+        if (type == Type::Object)
+            hash = mixHash(hash, stringHash(it.key()));
+        hash = mixHash(hash, hashValue(*it, out));
+    }
+    hash = mixHash(hash, v.size());
+    out[at] = Entry{hash, out.size() - at};
+    return hash;
+}
+
+// Like hashValue() for a value that is only in the text: parsed if small,
+// else scanned for its members.
+uint64_t SearchJob::Diff::hashSpan(std::string_view text, const ValueSpan &span, std::vector<Entry> &out) const
+{
+    if (!isLargeContainer(text, span))
+    {
+        json value = parseSpanText(text, span);
+        uint64_t hash = hashValue(value, out);
+        if (typeOf(value) != typeOf(text, span))
+            out.push_back(Entry{hash, 0});
+        return hash;
+    }
+    Type type = typeOf(text, span);
+    size_t at = out.size();
+    out.emplace_back();
+    std::vector<SpanMember> members;
+    scanMembers(text, span, members);
+    uint64_t hash = static_cast<uint64_t>(type) + 6;
+    for (const SpanMember &member : members)
+    {
+        if (stop.load(std::memory_order_relaxed))
+            return 0;
+        if (type == Type::Object)
+            hash = mixHash(hash, stringHash(member.key));
+        hash = mixHash(hash, hashSpan(text, member.span, out));
+    }
+    hash = mixHash(hash, members.size());
+    out[at] = Entry{hash, out.size() - at};
+    return hash;
+}
+
+void SearchJob::Diff::hashRange(Side &side, size_t task)
+{
+    std::vector<Entry> &out = side.entries[task];
+    size_t end = std::min(side.items.size(), (task + 1) * width);
+    for (size_t i = task * width; i < end && !stop.load(std::memory_order_relaxed); ++i)
+    {
+        Child &child = side.items[i];
+        if (child.value)
+            child.hash = hashValue(*child.value, out);
+        else if (child.record != SIZE_MAX)
+        {
+            json value = parseRecordText(side.records->recordText(child.record));
+            child.type = typeOf(value);
+            child.hash = hashValue(value, out);
+        }
+        else
+            child.hash = hashSpan(side.text, child.span, out);
+    }
+}
+
+void SearchJob::Diff::hashItems(unsigned threads)
+{
+    size_t total = sides[0].items.size() + sides[1].items.size();
+    width = std::max<size_t>(1, total / (static_cast<size_t>(threads) * kSlicesPerWorker));
+    std::vector<std::pair<Side *, size_t>> tasks;
+    for (Side &side : sides)
+    {
+        side.entries.resize((side.items.size() + width - 1) / width);
+        for (size_t task = 0; task < side.entries.size(); ++task)
+            tasks.emplace_back(&side, task);
+    }
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < tasks.size();)
+            hashRange(*tasks[i].first, tasks[i].second);
+    };
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < std::min<size_t>(threads, tasks.size()); ++i)
+        helpers.emplace_back(work);
+    work();
+    for (std::thread &helper : helpers)
+        helper.join();
+    if (stop.load(std::memory_order_relaxed))
+        return;
+
+    // The entries are complete; point the items at theirs and hash the roots.
+    for (Side &side : sides)
+    {
+        for (size_t task = 0; task < side.entries.size(); ++task)
+        {
+            const Entry *entry = side.entries[task].data();
+            size_t end = std::min(side.items.size(), (task + 1) * width);
+            for (size_t i = task * width; i < end; ++i)
+            {
+                Child &child = side.items[i];
+                if (child.type == Type::Primitive)
+                    continue;
+                if (entry->size == 0)
+                {
+                    child.type = Type::Primitive;
+                    ++entry;
+                    continue;
+                }
+                child.entries = entry;
+                entry += entry->size;
+            }
+        }
+        Child &self = side.self;
+        if (self.type == Type::Primitive)
+        {
+            self.hash = primitiveHash(*self.value);
+            continue;
+        }
+        uint64_t hash = static_cast<uint64_t>(self.type) + 6;
+        for (const Child &child : side.items)
+        {
+            if (self.type == Type::Object)
+                hash = mixHash(hash, stringHash(child.key));
+            hash = mixHash(hash, child.hash);
+        }
+        self.hash = mixHash(hash, side.items.size());
+    }
+}
+
+void SearchJob::Diff::open(const Side &side, const Child &child, Open &out) const
+{
+    out.entries = child.entries;
+    if (child.value)
+        out.value = child.value;
+    else if (child.record != SIZE_MAX)
+        out.value = &out.parsed.emplace(parseRecordText(side.records->recordText(child.record)));
+    else if (!isLargeContainer(side.text, child.span))
+        out.value = &out.parsed.emplace(parseSpanText(side.text, child.span));
+    else
+        out.span = child.span;
+}
+
+// The members of an opened container, with the hashes found while
+// hashing.  Keys of text members point into `members`.
+void SearchJob::Diff::children(const Side &side, const Open &open, std::vector<Child> &out,
+                               std::vector<SpanMember> &members) const
+{
+    const Entry *entry = open.entries + 1;
+    auto place = [&](Child &child) {
+        if (child.type == Type::Primitive)
+            return;
+        child.hash = entry->hash;
+        if (entry->size == 0)
+        {
+            child.type = Type::Primitive;
+            ++entry;
+            return;
+        }
+        child.entries = entry;
+        entry += entry->size;
+    };
+    if (open.value)
+    {
+        out.reserve(open.value->size());
+        for (auto it = open.value->begin(); it != open.value->end(); ++it)
+        {
+            Child &child = out.emplace_back();
+            if (open.value->is_object())
+                child.key = it.key();
+            child.value = &*it;
+            child.type = typeOf(*it);
+            if (child.type == Type::Primitive)
+                child.hash = primitiveHash(*it);
+            place(child);
+        }
+        return;
+    }
+    scanMembers(side.text, open.span, members);
+    out.reserve(members.size());
+    for (const SpanMember &member : members)
+    {
+        Child &child = out.emplace_back();
+        child.key = member.key;
+        child.span = member.span;
+        child.type = typeOf(side.text, member.span);
+        if (child.type == Type::Primitive)
+            child.hash = primitiveHash(parseSpanText(side.text, member.span));
+        place(child);
+    }
+}
+
+void SearchJob::Diff::emit(int side, size_t index, DiffChange change)
+{
+    Side &s = sides[side];
+    std::vector<uint32_t> &found = s.slice->found;
+    found.push_back(static_cast<uint32_t>(s.path.size() + (index != SIZE_MAX)));
+    found.insert(found.end(), s.path.begin(), s.path.end());
+    if (index != SIZE_MAX)
+        found.push_back(static_cast<uint32_t>(index));
+    s.slice->changes.push_back(change);
+}
+
+void SearchJob::Diff::walk()
+{
+    const Child &left = sides[0].self;
+    const Child &right = sides[1].self;
+    if (left.hash == right.hash)
+        return;
+    if (left.type != right.type || left.type == Type::Primitive)
+    {
+        emit(0, SIZE_MAX, DiffChange::Changed);
+        emit(1, SIZE_MAX, DiffChange::Changed);
+        return;
+    }
+    compare(sides[0].items, sides[1].items, left.type == Type::Object);
+}
+
+// Members with different hashes.  Objects are merged by their sorted keys.
+void SearchJob::Diff::compare(const std::vector<Child> &left, const std::vector<Child> &right, bool object)
+{
+    if (object)
+    {
+        size_t i = 0;
+        size_t j = 0;
+        while ((i < left.size() || j < right.size()) && !stop.load(std::memory_order_relaxed))
+        {
+            if (j == right.size() || (i < left.size() && left[i].key < right[j].key))
+                emit(0, i++, DiffChange::Removed);
+            else if (i == left.size() || right[j].key < left[i].key)
+                emit(1, j++, DiffChange::Added);
+            else
+            {
+                compare(left[i], i, right[j], j);
+                ++i;
+                ++j;
+            }
+        }
+        return;
+    }
+
+    size_t begin = 0;
+    size_t leftEnd = left.size();
+    size_t rightEnd = right.size();
+    while (begin < leftEnd && begin < rightEnd && left[begin].hash == right[begin].hash)
+        ++begin;
+    while (leftEnd > begin && rightEnd > begin && left[leftEnd - 1].hash == right[rightEnd - 1].hash)
+    {
+        --leftEnd;
+        --rightEnd;
+    }
+    std::vector<std::pair<size_t, size_t>> matched;
+    align(left, right, begin, leftEnd, begin, rightEnd, matched);
+
+    // Of the elements left over, those with an equal on the other side
+    // have moved.
+    std::vector<bool> leftMoved(leftEnd - begin);
+    std::vector<bool> rightMoved(rightEnd - begin);
+    std::vector<bool> leftMatched(leftEnd - begin);
+    std::vector<bool> rightMatched(rightEnd - begin);
+    for (const auto &[i, j] : matched)
+    {
+        leftMatched[i - begin] = true;
+        rightMatched[j - begin] = true;
+    }
+    std::unordered_map<uint64_t, size_t> spare;
+    for (size_t j = begin; j < rightEnd; ++j)
+        if (!rightMatched[j - begin])
+            ++spare[right[j].hash];
+    std::unordered_map<uint64_t, size_t> taken;
+    for (size_t i = begin; i < leftEnd; ++i)
+    {
+        auto it = leftMatched[i - begin] ? spare.end() : spare.find(left[i].hash);
+        if (it != spare.end() && it->second > 0)
+        {
+            --it->second;
+            ++taken[left[i].hash];
+            leftMoved[i - begin] = true;
+        }
+    }
+    for (size_t j = begin; j < rightEnd; ++j)
+    {
+        auto it = rightMatched[j - begin] ? taken.end() : taken.find(right[j].hash);
+        if (it != taken.end() && it->second > 0)
+        {
+            --it->second;
+            rightMoved[j - begin] = true;
+        }
+    }
+
+    // Between matched elements, pair up the rest in order.  Changes are
+    // emitted in document order on each side.
+    matched.emplace_back(leftEnd, rightEnd);
+    size_t i = begin;
+    size_t j = begin;
+    std::vector<size_t> leftRest;
+    std::vector<size_t> rightRest;
+    for (const auto &[leftStop, rightStop] : matched)
+    {
+        if (stop.load(std::memory_order_relaxed))
+            return;
+        leftRest.clear();
+        rightRest.clear();
+        for (size_t k = i; k < leftStop; ++k)
+            if (!leftMoved[k - begin])
+                leftRest.push_back(k);
+        for (size_t k = j; k < rightStop; ++k)
+            if (!rightMoved[k - begin])
+                rightRest.push_back(k);
+        size_t paired = std::min(leftRest.size(), rightRest.size());
+        for (size_t k = 0; k < paired; ++k)
+        {
+            for (; i < leftRest[k]; ++i)
+                emit(0, i, DiffChange::Moved);
+            for (; j < rightRest[k]; ++j)
+                emit(1, j, DiffChange::Moved);
+            compare(left[i], i, right[j], j);
+            ++i;
+            ++j;
+        }
+        for (; i < leftStop; ++i)
+            emit(0, i, leftMoved[i - begin] ? DiffChange::Moved : DiffChange::Removed);
+        for (; j < rightStop; ++j)
+            emit(1, j, rightMoved[j - begin] ? DiffChange::Moved : DiffChange::Added);
+        ++i;
+        ++j;
+    }
+}
+
+// Pairs of equal elements of left[leftBegin, leftEnd) and right[rightBegin,
+// rightEnd), in order on both sides.  A section is split on the longest
+// run of elements that occur once on each side and the sections between
+// them are aligned in turn.
+void SearchJob::Diff::align(const std::vector<Child> &left, const std::vector<Child> &right, size_t leftBegin,
+                            size_t leftEnd, size_t rightBegin, size_t rightEnd,
+                            std::vector<std::pair<size_t, size_t>> &matched) const
+{
+    // Sections larger than this that have no unique elements in common
+    // are left unaligned
+    constexpr size_t kMaxLcsCells = size_t(1) << 22;
+    struct Section
+    {
+        size_t leftBegin, leftEnd, rightBegin, rightEnd;
+    };
+    std::vector<Section> todo{{leftBegin, leftEnd, rightBegin, rightEnd}};
+    std::vector<std::pair<uint64_t, size_t>> leftHashes;
+    std::vector<std::pair<uint64_t, size_t>> rightHashes;
+    std::vector<std::pair<size_t, size_t>> unique;
+    while (!todo.empty() && !stop.load(std::memory_order_relaxed))
+    {
+        auto [lb, le, rb, re] = todo.back();
+        todo.pop_back();
+        while (lb < le && rb < re && left[lb].hash == right[rb].hash)
+            matched.emplace_back(lb++, rb++);
+        while (le > lb && re > rb && left[le - 1].hash == right[re - 1].hash)
+            matched.emplace_back(--le, --re);
+        if (lb == le || rb == re)
+            continue;
+
+        // Elements that occur once on each side, by left position
+        leftHashes.clear();
+        rightHashes.clear();
+        for (size_t i = lb; i < le; ++i)
+            leftHashes.emplace_back(left[i].hash, i);
+        for (size_t j = rb; j < re; ++j)
+            rightHashes.emplace_back(right[j].hash, j);
+        std::sort(leftHashes.begin(), leftHashes.end());
+        std::sort(rightHashes.begin(), rightHashes.end());
+        auto once = [](const auto &hashes, size_t k) {
+            return (k == 0 || hashes[k - 1].first != hashes[k].first) &&
+                   (k + 1 == hashes.size() || hashes[k + 1].first != hashes[k].first);
+        };
+        unique.clear();
+        for (size_t i = 0, j = 0; i < leftHashes.size() && j < rightHashes.size();)
+        {
+            if (leftHashes[i].first < rightHashes[j].first)
+                ++i;
+            else if (rightHashes[j].first < leftHashes[i].first)
+                ++j;
+            else
+            {
+                if (once(leftHashes, i) && once(rightHashes, j))
+                    unique.emplace_back(leftHashes[i].second, rightHashes[j].second);
+                ++i;
+                ++j;
+            }
+        }
+
+        if (!unique.empty())
+        {
+            // The longest run increasing on the right too, by patience sorting
+            std::sort(unique.begin(), unique.end());
+            std::vector<size_t> tops;
+            std::vector<size_t> previous(unique.size(), SIZE_MAX);
+            for (size_t k = 0; k < unique.size(); ++k)
+            {
+                auto pile = std::lower_bound(tops.begin(), tops.end(), unique[k].second,
+                                             [&](size_t top, size_t j) { return unique[top].second < j; });
+                if (pile != tops.begin())
+                    previous[k] = *(pile - 1);
+                if (pile == tops.end())
+                    tops.push_back(k);
+                else
+                    *pile = k;
+            }
+            size_t nextLeft = le;
+            size_t nextRight = re;
+            for (size_t k = tops.back(); k != SIZE_MAX; k = previous[k])
+            {
+                auto [i, j] = unique[k];
+                matched.emplace_back(i, j);
+                todo.push_back({i + 1, nextLeft, j + 1, nextRight});
+                nextLeft = i;
+                nextRight = j;
+            }
+            todo.push_back({lb, nextLeft, rb, nextRight});
+            continue;
+        }
+
+        size_t rows = le - lb;
+        size_t columns = re - rb;
+        if (rows > kMaxLcsCells / columns)
+            continue;
+        // Lengths of the longest common subsequences of the suffixes
+        std::vector<uint32_t> lengths((rows + 1) * (columns + 1));
+        auto at = [&](size_t i, size_t j) -> uint32_t & { return lengths[i * (columns + 1) + j]; };
+        for (size_t i = rows; i-- > 0;)
+            for (size_t j = columns; j-- > 0;)
+                at(i, j) = left[lb + i].hash == right[rb + j].hash ? at(i + 1, j + 1) + 1
+                                                                   : std::max(at(i + 1, j), at(i, j + 1));
+        for (size_t i = 0, j = 0; i < rows && j < columns;)
+        {
+            if (left[lb + i].hash == right[rb + j].hash)
+                matched.emplace_back(lb + i++, rb + j++);
+            else if (at(i + 1, j) >= at(i, j + 1))
+                ++i;
+            else
+                ++j;
+        }
+    }
+    std::sort(matched.begin(), matched.end());
+}
+
+// Two members in the same place: equal, different values, or containers
+// of the same kind to compare member by member.
+void SearchJob::Diff::compare(const Child &left, size_t leftIndex, const Child &right, size_t rightIndex)
+{
+    if (left.hash == right.hash)
+        return;
+    if (left.type != right.type || left.type == Type::Primitive)
+    {
+        emit(0, leftIndex, DiffChange::Changed);
+        emit(1, rightIndex, DiffChange::Changed);
+        return;
+    }
+    Open leftOpen;
+    Open rightOpen;
+    open(sides[0], left, leftOpen);
+    open(sides[1], right, rightOpen);
+    std::vector<Child> leftChildren;
+    std::vector<Child> rightChildren;
+    std::vector<SpanMember> leftMembers;
+    std::vector<SpanMember> rightMembers;
+    children(sides[0], leftOpen, leftChildren, leftMembers);
+    children(sides[1], rightOpen, rightChildren, rightMembers);
+    sides[0].path.push_back(static_cast<uint32_t>(leftIndex));
+    sides[1].path.push_back(static_cast<uint32_t>(rightIndex));
+    compare(leftChildren, rightChildren, left.type == Type::Object);
+    sides[0].path.pop_back();
+    sides[1].path.pop_back();
+}
+
+SearchJob::SearchJob(std::vector<const Node *> startNodes, const std::string &term, bool searchKeys,
+                     bool searchValues, unsigned threads)
+    : starts(std::move(startNodes)), matcher(term), searchKeys(searchKeys), searchValues(searchValues)
+{
+    if (matcher.empty() || (!searchKeys && !searchValues))
+        return;
+    start(threads);
+}
+
+SearchJob::SearchJob(std::vector<const Node *> startNodes, Query compiled, unsigned threads)
+    : starts(std::move(startNodes)), searchKeys(false), searchValues(false), query(std::move(compiled)),
+      querying(true)
+{
+    start(threads);
+}
+
+SearchJob::SearchJob(const Node *left, const Node *right, unsigned threads)
+    : starts{left, right}, searchKeys(false), searchValues(false), diff(std::make_unique<Diff>(stop))
+{
+    timed = perfStats.enabled();
+    if (timed)
+        started = std::chrono::steady_clock::now();
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < 2; ++i)
+    {
+        auto slice = std::make_unique<Slice>();
+        slice->start = i;
+        diff->sides[i].slice = slice.get();
+        diff->describe(diff->sides[i], starts[i]);
+        slices.push_back(std::move(slice));
+    }
+    workers.emplace_back(&SearchJob::runDiff, this, threads);
+}
+
+void SearchJob::runDiff(unsigned threads)
+{
+    diff->hashItems(threads);
+    if (!stop.load(std::memory_order_relaxed))
+        diff->walk();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &slice : slices)
+            slice->done.store(true, std::memory_order_release);
+    }
+    sliceDone.notify_all();
+}
+
+void SearchJob::start(unsigned threads)
+{
+    timed = perfStats.enabled();
+    if (timed)
+        started = std::chrono::steady_clock::now();
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < starts.size(); ++i)
+    {
+        auto slice = std::make_unique<Slice>();
+        slice->start = i;
+        slice->state = query.initial();
+        describe(*slice, starts[i]);
+        slices.push_back(std::move(slice));
+    }
+
+    // Split the widest slice until there is enough work to go round.
+    // Halving keeps slices in document order: a node's own match comes
+    // first, then its children left to right.
+    size_t target = threads * kSlicesPerWorker;
+    for (size_t round = 0; slices.size() < target && round < target * 4; ++round)
+    {
+        size_t widest = 0;
+        size_t width = 0;
+        for (size_t i = 0; i < slices.size(); ++i)
+        {
+            size_t w = slices[i]->childEnd - slices[i]->childBegin;
+            if (w > width)
+            {
+                width = w;
+                widest = i;
+            }
+        }
+        if (width == 0)
+            break;
+        Slice &s = *slices[widest];
+        if (width >= 2)
+        {
+            auto upper = std::make_unique<Slice>();
+            upper->start = s.start;
+            upper->path = s.path;
+            upper->value = s.value;
+            upper->records = s.records;
+            upper->text = s.text;
+            upper->spanChildren = s.spanChildren;
+            upper->childSpans = s.childSpans;
+            upper->spanObject = s.spanObject;
+            upper->name = s.name;
+            upper->includeSelf = false;
+            upper->childBegin = s.childBegin + width / 2;
+            upper->childEnd = s.childEnd;
+            upper->childTotal = s.childTotal;
+            upper->state = s.state;
+            s.childEnd = upper->childBegin;
+            slices.insert(slices.begin() + widest + 1, std::move(upper));
+        }
+        else
+        {
+            // A single child: search the child itself as its own slice.
+            auto child = std::make_unique<Slice>();
+            child->start = s.start;
+            child->path = s.path;
+            child->path.push_back(static_cast<uint32_t>(s.childBegin));
+            if (!s.value)
+            {
+                // Records and spans are resolved through the tree, here on
+                // the owning thread.
+                const Node *node = starts[s.start];
+                for (uint32_t index : s.path)
+                    node = &ensureChildren(node)[index];
+                describe(*child, &ensureChildren(node)[s.childBegin]);
+            }
+            else
+            {
+                auto it = std::next(s.value->begin(), static_cast<std::ptrdiff_t>(s.childBegin));
+                child->value = &*it;
+                child->name = s.value->is_object() ? &it.key() : nullptr;
+                child->selfIndex = s.childBegin;
+                child->childEnd = child->value->is_structured() ? child->value->size() : 0;
+                child->childTotal = child->childEnd;
+            }
+            if (querying)
+            {
+                // Children too large to parse reach no filter.
+                child->state = query.advance(s.state, child->name, s.childBegin, s.childTotal,
+                                             [&] { return child->value; });
+                if (!query.canDescend(child->state))
+                    child->childEnd = 0;
+            }
+            s.childEnd = s.childBegin;
+            slices.insert(slices.begin() + widest + 1, std::move(child));
+        }
+    }
+
+    // Slicing has built every node the workers read names from.
+    if (searchKeys)
+        keyTable.forEach([&](const std::string &key) { internedMatches.emplace(&key, matcher.matches(key)); });
+
+    size_t count = std::min<size_t>(threads, slices.size());
+    for (size_t i = 0; i < count; ++i)
+        workers.emplace_back(&SearchJob::run, this);
+}
+
+// Point a slice at a node and all of its children.
+void SearchJob::describe(Slice &slice, const Node *node) const
+{
+    slice.value = nodeValue(node);
+    slice.name = node->name;
+    slice.selfIndex = node->parent ? childIndex(node) : 0;
+    if (slice.value)
+    {
+        slice.childEnd = slice.value->is_structured() ? slice.value->size() : 0;
+        slice.childTotal = slice.childEnd;
+        return;
+    }
+    NodeTree *tree = NodeTree::owner(node);
+    if (const ValueSpan *span = nodeSpan(node))
+    {
+        slice.text = tree->text();
+        slice.spanObject = slice.text[span->begin] == '{';
+        std::span<Node> children = ensureChildren(node);
+        if (!children.empty())
+        {
+            slice.spanChildren = children.data();
+            slice.childSpans = blockHeader(children.data()).spans;
+        }
+        slice.childEnd = children.size();
+        slice.childTotal = slice.childEnd;
+        return;
+    }
+    slice.records = tree;
+    slice.childEnd = nodeSize(node);
+    slice.childTotal = slice.childEnd;
+}
+
+SearchJob::~SearchJob()
+{
+    cancel();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void SearchJob::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop.store(true, std::memory_order_relaxed);
+    }
+    sliceDone.notify_all();
+}
+
+void SearchJob::run()
+{
+    for (;;)
+    {
+        size_t i = nextSlice.fetch_add(1, std::memory_order_relaxed);
+        if (i >= slices.size() || stop.load(std::memory_order_relaxed))
+            return;
+        if (querying)
+            querySlice(*slices[i]);
+        else
+            searchSlice(*slices[i]);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slices[i]->done.store(true, std::memory_order_release);
+        }
+        sliceDone.notify_all();
+    }
+}
+
+void SearchJob::searchSlice(Slice &slice)
+{
+    std::vector<uint32_t> path;
+    // Keys of array elements are their "[i]" labels, as shown in the tree.
+    // Names of built span children are interned and were matched upfront.
+    auto matches = [&](const json &v, const std::string *name, size_t index, bool interned = false) {
+        if (searchKeys)
+        {
+            if (name)
+            {
+                auto known = interned ? internedMatches.find(name) : internedMatches.end();
+                if (known != internedMatches.end() ? known->second : matcher.matches(*name))
+                    return true;
+            }
+            else
+            {
+                char buf[24];
+                buf[0] = '[';
+                char *end = std::to_chars(buf + 1, buf + sizeof(buf) - 1, index).ptr;
+                *end++ = ']';
+                if (matcher.matches(std::string_view(buf, static_cast<size_t>(end - buf))))
+                    return true;
+            }
+        }
+        return searchValues && valueMatches(v, matcher);
+    };
+    auto record = [&]() {
+        slice.found.push_back(static_cast<uint32_t>(path.size()));
+        slice.found.insert(slice.found.end(), path.begin(), path.end());
+    };
+    auto visit = [&](auto &self, const json &v) -> void {
+        if (stop.load(std::memory_order_relaxed))
+            return;
+        if (!v.is_structured())
+            return;
+        uint32_t index = 0;
+        for (auto it = v.begin(); it != v.end(); ++it, ++index)
+        {
+            path.push_back(index);
+            if (matches(*it, v.is_object() ? &it.key() : nullptr, index))
+                record();
+            self(self, *it);
+            path.pop_back();
+        }
+    };
+
+    // Values too large to parse match value searches by their type name.
+    static const json listStandIn = json::array();
+    static const json objectStandIn = json::object();
+    auto standIn = [&](std::string_view text, const ValueSpan &span) -> const json & {
+        return text[span.begin] == '{' ? objectStandIn : listStandIn;
+    };
+    // A member of an unparsed container: parsed if small, else scanned.
+    auto visitSpan = [&](auto &self, std::string_view text, const ValueSpan &span, const std::string *name,
+                         size_t index, bool interned) -> void {
+        if (stop.load(std::memory_order_relaxed))
+            return;
+        if (!isLargeContainer(text, span))
+        {
+            json value = parseSpanText(text, span);
+            if (matches(value, name, index, interned))
+                record();
+            visit(visit, value);
+            return;
+        }
+        if (matches(standIn(text, span), name, index, interned))
+            record();
+        std::vector<SpanMember> members;
+        scanMembers(text, span, members);
+        bool object = text[span.begin] == '{';
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            path.push_back(static_cast<uint32_t>(i));
+            self(self, text, members[i].span, object ? &members[i].key : nullptr, i, false);
+            path.pop_back();
+        }
+    };
+
+    if (!slice.text.empty())
+    {
+        if (slice.includeSelf &&
+            matches(slice.spanObject ? objectStandIn : listStandIn, slice.name, slice.selfIndex, true))
+            record();
+        for (size_t index = slice.childBegin; index < slice.childEnd; ++index)
+        {
+            // Only the byte range is read; the owning thread may be
+            // caching child counts in the same spans meanwhile.
+            ValueSpan span{slice.childSpans[index].begin, slice.childSpans[index].end};
+            path.push_back(static_cast<uint32_t>(index));
+            visitSpan(visitSpan, slice.text, span, slice.spanChildren[index].name, index, true);
+            path.pop_back();
+        }
+        return;
+    }
+
+    // A line-delimited root matches value searches as a list.
+    if (slice.includeSelf && matches(slice.value ? *slice.value : listStandIn, slice.name, slice.selfIndex))
+        record();
+    if (slice.childBegin == slice.childEnd)
+        return;
+    if (slice.records)
+    {
+        for (size_t index = slice.childBegin; index < slice.childEnd; ++index)
+        {
+            if (stop.load(std::memory_order_relaxed))
+                return;
+            json value = parseRecordText(slice.records->recordText(index));
+            path.push_back(static_cast<uint32_t>(index));
+            if (matches(value, nullptr, index))
+                record();
+            visit(visit, value);
+            path.pop_back();
+        }
+        return;
+    }
+    const json &v = *slice.value;
+    auto it = std::next(v.begin(), static_cast<std::ptrdiff_t>(slice.childBegin));
+    for (size_t index = slice.childBegin; index < slice.childEnd; ++index, ++it)
+    {
+        path.push_back(static_cast<uint32_t>(index));
+        if (matches(*it, v.is_object() ? &it.key() : nullptr, index))
+            record();
+        visit(visit, *it);
+        path.pop_back();
+    }
+}
+
+void SearchJob::querySlice(Slice &slice)
+{
+    std::vector<uint32_t> path;
+    auto record = [&]() {
+        slice.found.push_back(static_cast<uint32_t>(path.size()));
+        slice.found.insert(slice.found.end(), path.begin(), path.end());
+    };
+    // A child reaching the steps `next`: recorded when that completes the
+    // query, then walked by descend() while steps remain.
+    auto child = [&](Query::State next, size_t index, auto &&descend) {
+        if (!next)
+            return;
+        path.push_back(static_cast<uint32_t>(index));
+        if (query.accepts(next))
+            record();
+        if (query.canDescend(next))
+            descend(next);
+        path.pop_back();
+    };
+    auto visit = [&](auto &self, const json &v, Query::State state) -> void {
+        if (stop.load(std::memory_order_relaxed) || !v.is_structured())
+            return;
+        bool object = v.is_object();
+        size_t count = v.size();
+        size_t index = 0;
+        for (auto it = v.begin(); it != v.end(); ++it, ++index)
+        {
+            const json &member = *it;
+            child(query.advance(state, object ? &it.key() : nullptr, index, count, [&] { return &member; }),
+                  index, [&](Query::State next) { self(self, member, next); });
+        }
+    };
+    // Children of an unparsed container: each parsed if small and needed,
+    // else scanned in turn.
+    auto visitSpan = [&](auto &self, std::string_view text, const ValueSpan &span, Query::State state) -> void {
+        if (stop.load(std::memory_order_relaxed))
+            return;
+        std::vector<SpanMember> members;
+        scanMembers(text, span, members);
+        bool object = text[span.begin] == '{';
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            const ValueSpan &memberSpan = members[i].span;
+            bool large = isLargeContainer(text, memberSpan);
+            std::optional<json> parsed;
+            auto value = [&]() -> const json * {
+                if (large)
+                    return nullptr;
+                if (!parsed)
+                    parsed = parseSpanText(text, memberSpan);
+                return &*parsed;
+            };
+            child(query.advance(state, object ? &members[i].key : nullptr, i, members.size(), value), i,
+                  [&](Query::State next) {
+                      if (large)
+                          self(self, text, memberSpan, next);
+                      else
+                          visit(visit, *value(), next);
+                  });
+        }
+    };
+
+    if (slice.includeSelf && query.accepts(slice.state))
+        record();
+    if (!query.canDescend(slice.state))
+        return;
+    if (!slice.text.empty())
+    {
+        for (size_t index = slice.childBegin; index < slice.childEnd; ++index)
+        {
+            if (stop.load(std::memory_order_relaxed))
+                return;
+            // Only the byte range is read, as in searchSlice().
+            ValueSpan span{slice.childSpans[index].begin, slice.childSpans[index].end};
+            bool large = isLargeContainer(slice.text, span);
+            std::optional<json> parsed;
+            auto value = [&]() -> const json * {
+                if (large)
+                    return nullptr;
+                if (!parsed)
+                    parsed = parseSpanText(slice.text, span);
+                return &*parsed;
+            };
+            child(query.advance(slice.state, slice.spanChildren[index].name, index, slice.childTotal, value), index,
+                  [&](Query::State next) {
+                      if (large)
+                          visitSpan(visitSpan, slice.text, span, next);
+                      else
+                          visit(visit, *value(), next);
+                  });
+        }
+        return;
+    }
+    if (slice.records)
+    {
+        // Records are only parsed when a filter or a later step needs them.
+        for (size_t index = slice.childBegin; index < slice.childEnd; ++index)
+        {
+            if (stop.load(std::memory_order_relaxed))
+                return;
+            std::optional<json> parsed;
+            auto value = [&]() -> const json * {
+                if (!parsed)
+                    parsed = parseRecordText(slice.records->recordText(index));
+                return &*parsed;
+            };
+            child(query.advance(slice.state, nullptr, index, slice.childTotal, value), index,
+                  [&](Query::State next) { visit(visit, *value(), next); });
+        }
+        return;
+    }
+    if (slice.childBegin == slice.childEnd)
+        return;
+    const json &v = *slice.value;
+    bool object = v.is_object();
+    auto it = std::next(v.begin(), static_cast<std::ptrdiff_t>(slice.childBegin));
+    for (size_t index = slice.childBegin; index < slice.childEnd; ++index, ++it)
+    {
+        const json &member = *it;
+        child(query.advance(slice.state, object ? &it.key() : nullptr, index, slice.childTotal,
+                            [&] { return &member; }),
+              index, [&](Query::State next) { visit(visit, member, next); });
+    }
+}
+
+bool SearchJob::collect(SearchState &state)
+{
+    std::vector<const Node *> found;
+    std::vector<DiffChange> changes;
+    if (!collect(found, &changes))
+        return false;
+    for (size_t i = 0; i < changes.size(); ++i)
+        state.changes.emplace(found[i], changes[i]);
+    state.addMatches(found);
+    return true;
+}
+
+bool SearchJob::collect(std::vector<const Node *> &out)
+{
+    return collect(out, nullptr);
+}
+
+bool SearchJob::collect(std::vector<const Node *> &out, std::vector<DiffChange> *changes)
+{
+    size_t before = out.size();
+    while (nextToCollect < slices.size() && !stop.load(std::memory_order_relaxed) &&
+           slices[nextToCollect]->done.load(std::memory_order_acquire))
+    {
+        const Slice &slice = *slices[nextToCollect++];
+        const Node *base = starts[slice.start];
+        for (uint32_t index : slice.path)
+            base = &ensureChildren(base)[index];
+        for (size_t i = 0; i < slice.found.size();)
+        {
+            uint32_t length = slice.found[i++];
+            const Node *node = base;
+            for (uint32_t k = 0; k < length; ++k)
+                node = &ensureChildren(node)[slice.found[i++]];
+            out.push_back(node);
+        }
+        if (changes)
+            changes->insert(changes->end(), slice.changes.begin(), slice.changes.end());
+    }
+    perfStats.add(PerfCounter::SearchMatches, out.size() - before);
+    if (timed && finished())
+    {
+        // Searches are timed from start to the last collected match
+        perfStats.record(PerfPhase::Search, std::chrono::steady_clock::now() - started);
+        timed = false;
+    }
+    return out.size() != before;
+}
+
+void SearchJob::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    sliceDone.wait(lock, [&] {
+        return stop.load(std::memory_order_relaxed) || std::all_of(slices.begin(), slices.end(),
+                           [](const auto &slice) { return slice->done.load(std::memory_order_acquire); });
+    });
+}
+
+bool SearchJob::finished() const
+{
+    return stop.load(std::memory_order_relaxed) || nextToCollect >= slices.size();
+}
+
+namespace
+{
+// Bytes of a string as the printer writes it, quotes included.
+uint64_t serializedStringBytes(std::string_view text)
+{
+    uint64_t bytes = text.size() + 2;
+    for (char ch : text)
+    {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        bool shortEscape = c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t';
+        bytes += shortEscape ? 1 : 5;
+    }
+    return bytes;
+}
+
+// Bytes of a primitive as the printer writes it.
+uint64_t serializedPrimitiveBytes(const json &v)
+{
+    char number[64];
+    switch (v.type())
+    {
+    case json::value_t::string:
+        return serializedStringBytes(v.get_ref<const std::string &>());
+    case json::value_t::boolean:
+        return v.get<bool>() ? 4 : 5;
+    case json::value_t::number_integer:
+        return std::to_chars(number, number + sizeof(number), v.get<int64_t>()).ptr - number;
+    case json::value_t::number_unsigned:
+        return std::to_chars(number, number + sizeof(number), v.get<uint64_t>()).ptr - number;
+    case json::value_t::number_float:
+    {
+        double d = v.get<double>();
+        if (std::isnan(d))
+            return 3;
+        if (std::isinf(d))
+            return d > 0 ? 8 : 9;
+        return nlohmann::detail::to_chars(number, number + sizeof(number), d) - number;
+    }
+    default:
+        return 4;
+    }
+}
+
+SubtreeStats::Type statsType(const json &v)
+{
+    switch (v.type())
+    {
+    case json::value_t::object:
+        return SubtreeStats::Object;
+    case json::value_t::array:
+        return SubtreeStats::Array;
+    case json::value_t::string:
+        return SubtreeStats::String;
+    case json::value_t::boolean:
+        return SubtreeStats::Boolean;
+    case json::value_t::number_integer:
+    case json::value_t::number_unsigned:
+    case json::value_t::number_float:
+        return SubtreeStats::Number;
+    default:
+        return SubtreeStats::Null;
+    }
+}
+} // namespace
+
+// Runs on the owning thread, which parses the node if need be and builds
+// the children of an indexed container, as SearchJob::Diff does.
+StatsJob::StatsJob(const Node *node, const SubtreeStatsCache &cache, unsigned threads) : subject(node)
+{
+    NodeTree *tree = NodeTree::owner(node);
+    std::span<Node> built = node->childrenBuilt ? std::span<Node>(node->children, node->childCount)
+                                                : std::span<Node>();
+    if (const json *v = nodeValue(node))
+    {
+        type = statsType(*v);
+        if (type != SubtreeStats::Object && type != SubtreeStats::Array)
+        {
+            countValue(*v, sum, 0);
+            complete.store(true, std::memory_order_release);
+            return;
+        }
+        for (auto it = v->begin(); it != v->end(); ++it)
+        {
+            Item item;
+            if (type == SubtreeStats::Object)
+                item.name = &it.key();
+            children.push_back(item);
+            sources.push_back(Source{&*it});
+        }
+    }
+    else if (tree->isRecordList())
+    {
+        records = tree;
+        type = SubtreeStats::Array;
+        children.resize(tree->recordCount());
+        sources.resize(children.size());
+        for (size_t i = 0; i < sources.size(); ++i)
+            sources[i].record = i;
+    }
+    else
+    {
+        text = tree->text();
+        type = text[nodeSpan(node)->begin] == '{' ? SubtreeStats::Object : SubtreeStats::Array;
+        built = ensureChildren(node);
+        const ValueSpan *spans = built.empty() ? nullptr : blockHeader(built.data()).spans;
+        children.resize(built.size());
+        sources.resize(built.size());
+        for (size_t i = 0; i < built.size(); ++i)
+        {
+            children[i].name = built[i].name;
+            sources[i].span = ValueSpan{spans[i].begin, spans[i].end};
+        }
+    }
+    // The figures of children counted before, by an earlier job on them.
+    if (records)
+    {
+        auto found = cache.records.find(records);
+        size_t known = found == cache.records.end() ? 0 : std::min(found->second.size(), children.size());
+        for (size_t i = 0; i < known; ++i)
+        {
+            if (found->second[i].values == 0)
+                continue;
+            children[i].stats = found->second[i];
+            sources[i].known = true;
+        }
+    }
+    else if (built.size() == children.size())
+    {
+        for (size_t i = 0; i < built.size(); ++i)
+        {
+            auto found = cache.nodes.find(&built[i]);
+            if (found == cache.nodes.end())
+                continue;
+            children[i].stats = found->second;
+            sources[i].known = true;
+        }
+    }
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    width = std::max<size_t>(1, children.size() / (static_cast<size_t>(threads) * kSlicesPerWorker));
+    tasks = (children.size() + width - 1) / width;
+    if (tasks == 0)
+    {
+        addUp();
+        return;
+    }
+    for (size_t i = 0; i < std::min<size_t>(threads, tasks); ++i)
+        workers.emplace_back(&StatsJob::run, this);
+}
+
+StatsJob::~StatsJob()
+{
+    cancel();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void StatsJob::cancel()
+{
+    stop.store(true, std::memory_order_relaxed);
+}
+
+bool StatsJob::finished() const
+{
+    return complete.load(std::memory_order_acquire);
+}
+
+double StatsJob::progress() const
+{
+    return children.empty() ? 1.0 : double(itemsDone.load(std::memory_order_relaxed)) / children.size();
+}
+
+void StatsJob::store(SubtreeStatsCache &cache) const
+{
+    if (!finished())
+        return;
+    cache.store(subject, sum);
+    if (records)
+    {
+        std::vector<SubtreeStats> &counted = cache.records[records];
+        counted.resize(std::max(counted.size(), children.size()));
+        for (size_t i = 0; i < children.size(); ++i)
+            counted[i] = children[i].stats;
+        return;
+    }
+    if (!subject->childrenBuilt || subject->childCount != children.size())
+        return;
+    for (size_t i = 0; i < children.size(); ++i)
+        cache.nodes[&subject->children[i]] = children[i].stats;
+}
+
+// The tree whose records include the node, if it is one.
+static const NodeTree *recordOwner(const Node *node)
+{
+    if (!node->parent || node->parent->parent)
+        return nullptr;
+    const NodeTree *tree = NodeTree::owner(node);
+    return tree->isRecordList() ? tree : nullptr;
+}
+
+const SubtreeStats *SubtreeStatsCache::find(const Node *node) const
+{
+    if (const NodeTree *tree = recordOwner(node))
+    {
+        auto found = records.find(tree);
+        size_t index = childIndex(node);
+        if (found == records.end() || index >= found->second.size() || found->second[index].values == 0)
+            return nullptr;
+        return &found->second[index];
+    }
+    auto found = nodes.find(node);
+    return found == nodes.end() ? nullptr : &found->second;
+}
+
+void SubtreeStatsCache::store(const Node *node, const SubtreeStats &stats)
+{
+    if (const NodeTree *tree = recordOwner(node))
+    {
+        std::vector<SubtreeStats> &counted = records[tree];
+        size_t index = childIndex(node);
+        if (index >= counted.size())
+            counted.resize(index + 1);
+        counted[index] = stats;
+        return;
+    }
+    nodes[node] = stats;
+}
+
+void SubtreeStatsCache::forgetRecords(const NodeTree &tree, size_t first)
+{
+    const Node *root = tree.root();
+    nodes.erase(root);
+    auto found = records.find(&tree);
+    if (found != records.end() && found->second.size() > first)
+        found->second.resize(first);
+    auto forget = [&](auto &self, const Node *node) -> void {
+        for (const Node &child : builtChildren(node))
+        {
+            nodes.erase(&child);
+            self(self, &child);
+        }
+    };
+    std::span<Node> built = builtChildren(root);
+    for (size_t i = first; i < built.size(); ++i)
+        forget(forget, &built[i]);
+}
+
+void StatsJob::run()
+{
+    for (;;)
+    {
+        size_t task = nextTask.fetch_add(1, std::memory_order_relaxed);
+        if (task >= tasks || stop.load(std::memory_order_relaxed))
+            return;
+        countRange(task);
+        // Whoever finishes the last range adds up the node's figures.
+        if (tasksDone.fetch_add(1, std::memory_order_acq_rel) + 1 == tasks && !stop.load(std::memory_order_relaxed))
+            addUp();
+    }
+}
+
+void StatsJob::countRange(size_t task)
+{
+    size_t end = std::min(children.size(), (task + 1) * width);
+    for (size_t i = task * width; i < end && !stop.load(std::memory_order_relaxed); ++i)
+    {
+        const Source &source = sources[i];
+        SubtreeStats &stats = children[i].stats;
+        if (source.known)
+        {
+            // Counted by an earlier job
+        }
+        else if (source.value)
+            countValue(*source.value, stats, 0);
+        else if (source.record != SIZE_MAX)
+            countValue(parseRecordText(records->recordText(source.record)), stats, 0);
+        else
+            countSpan(source.span, stats, 0);
+        itemsDone.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void StatsJob::countValue(const json &v, SubtreeStats &stats, uint32_t level) const
+{
+    SubtreeStats::Type t = statsType(v);
+    ++stats.values;
+    ++stats.types[t];
+    stats.depth = std::max(stats.depth, level);
+    if (t != SubtreeStats::Object && t != SubtreeStats::Array)
+    {
+        stats.bytes += serializedPrimitiveBytes(v);
+        return;
+    }
+    // Brackets and the commas between members
+    stats.bytes += v.empty() ? 2 : v.size() + 1;
+    for (auto it = v.begin(); it != v.end() && !stop.load(std::memory_order_relaxed); ++it)
+    {
+        if (t == SubtreeStats::Object)
+            stats.bytes += serializedStringBytes(it.key()) + 1;
+        countValue(*it, stats, level + 1);
+    }
+}
+
+// Like countValue() for a value that is only in the text: parsed if
+// small, else scanned for its members.
+void StatsJob::countSpan(const ValueSpan &span, SubtreeStats &stats, uint32_t level) const
+{
+    if (!isLargeContainer(text, span))
+    {
+        countValue(parseSpanText(text, span), stats, level);
+        return;
+    }
+    bool object = text[span.begin] == '{';
+    std::vector<SpanMember> members;
+    scanMembers(text, span, members);
+    ++stats.values;
+    ++stats.types[object ? SubtreeStats::Object : SubtreeStats::Array];
+    stats.depth = std::max(stats.depth, level);
+    stats.bytes += members.empty() ? 2 : members.size() + 1;
+    for (const SpanMember &member : members)
+    {
+        if (stop.load(std::memory_order_relaxed))
+            return;
+        if (object)
+            stats.bytes += serializedStringBytes(member.key) + 1;
+        countSpan(member.span, stats, level + 1);
+    }
+}
+
+void StatsJob::addUp()
+{
+    sum.values = 1;
+    sum.types[type] = 1;
+    sum.bytes = children.empty() ? 2 : children.size() + 1;
+    for (const Item &item : children)
+    {
+        sum.values += item.stats.values;
+        for (int t = 0; t < SubtreeStats::TypeCount; ++t)
+            sum.types[t] += item.stats.types[t];
+        sum.depth = std::max(sum.depth, item.stats.depth + 1);
+        sum.bytes += item.stats.bytes;
+        if (item.name)
+            sum.bytes += serializedStringBytes(*item.name) + 1;
+    }
+    complete.store(true, std::memory_order_release);
+}
+
+// Expand all ancestors of the given node so that it becomes visible.
+void expandPath(Node *node)
+{
+    Node *cur = node->parent;
+    while (cur)
+    {
+        setExpanded(cur, true);
+        cur = cur->parent;
+    }
+}
+
+// Base64 encoding for OSC 52 clipboard support.  Appends the encoding of
+// `input`; pieces whose length is a multiple of 3 encode to pieces of one
+// long encoding.
+static void base64Append(std::string_view input, std::string &encoded)
+{
+    static const char base64_chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+        "abcdefghijklmnopqrstuvwxyz"
+        "0123456789+/";
+
+    size_t start = encoded.size();
+    int val = 0, valb = -6;
+    for (unsigned char c : input)
+    {
+        val = (val << 8) + c;
+        valb += 8;
+        while (valb >= 0)
+        {
+            encoded.push_back(base64_chars[(val >> valb) & 0x3F]);
+            valb -= 6;
+        }
+    }
+    if (valb > -6)
+        encoded.push_back(base64_chars[((val << 8) >> (valb + 8)) & 0x3F]);
+    while ((encoded.size() - start) % 4)
+        encoded.push_back('=');
+}
+
+// Write everything to a descriptor; false once it fails.
+static bool writeAll(int fd, std::string_view data)
+{
+    while (!data.empty())
+    {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+}
+
+static bool envSet(const char *name)
+{
+    const char *value = std::getenv(name);
+    return value && *value;
+}
+
+// Check if an executable exists in PATH
+static bool inPath(const char *name)
+{
+    const char *path = std::getenv("PATH");
+    if (!path)
+        return false;
+    std::string_view rest(path);
+    while (true)
+    {
+        size_t colon = rest.find(':');
+        std::string dir(rest.substr(0, colon));
+        std::string candidate = (dir.empty() ? std::string(".") : dir) + "/" + name;
+        if (access(candidate.c_str(), X_OK) == 0)
+            return true;
+        if (colon == std::string_view::npos)
+            return false;
+        rest.remove_prefix(colon + 1);
+    }
+}
+
+// Check if OSC 52 clipboard sequences are likely to be supported
+bool osc52Likely()
+{
+    // Check for explicit opt-out
+    const char *noOsc52 = std::getenv("NO_OSC52");
+    if (noOsc52 && *noOsc52)
+        return false;
+
+    const char *term = std::getenv("TERM");
+    if (!term)
+        return false;
+
+    std::string termStr(term);
+
+    // Terminals that definitely don't support OSC 52
+    if (termStr == "dumb" || termStr == "linux")
+        return false;
+
+    // Common terminals/muxers that support OSC 52 (including tmux!)
+    return termStr.find("xterm") != std::string::npos ||
+           termStr.find("tmux") != std::string::npos ||
+           termStr.find("screen") != std::string::npos ||
+           termStr.find("rxvt") != std::string::npos ||
+           termStr.find("alacritty") != std::string::npos ||
+           termStr.find("foot") != std::string::npos ||
+           termStr.find("kitty") != std::string::npos ||
+           termStr.find("wezterm") != std::string::npos;
+}
+
+ClipboardTarget clipboardTarget()
+{
+    const char *off = std::getenv("JSON_VIEW_NO_CLIPBOARD");
+    if (off && *off && std::strcmp(off, "0") != 0)
+        return ClipboardTarget::None;
+    if (envSet("JSON_VIEW_CLIPBOARD_FILE"))
+        return ClipboardTarget::File;
+    if (envSet("WAYLAND_DISPLAY") && inPath("wl-copy"))
+        return ClipboardTarget::WlCopy;
+    if (envSet("DISPLAY"))
+    {
+        if (inPath("xclip"))
+            return ClipboardTarget::Xclip;
+        if (inPath("xsel"))
+            return ClipboardTarget::Xsel;
+    }
+    return osc52Likely() ? ClipboardTarget::Osc52 : ClipboardTarget::None;
+}
+
+// Get a descriptive message about why the clipboard cannot be used
+std::string getClipboardStatusMessage()
+{
+    if (envSet("JSON_VIEW_NO_CLIPBOARD") && std::strcmp(std::getenv("JSON_VIEW_NO_CLIPBOARD"), "0") != 0)
+    {
+        return "Clipboard disabled by JSON_VIEW_NO_CLIPBOARD";
+    }
+    if (std::getenv("TMUX") && !osc52Likely())
+    {
+        return "Clipboard not supported - tmux needs OSC 52 configuration";
+    }
+    return "Clipboard not supported by this terminal";
+}
+
+// Many terminals and multiplexers drop longer OSC 52 sequences (the limit
+// is on the base64 payload).
+static constexpr size_t kOsc52MaxPayload = 100000;
+// Text is encoded and written in pieces of this many bytes.
+static constexpr size_t kOsc52Chunk = 3 * 1024;
+
+// Send text to the terminal's clipboard with an OSC 52 sequence, writing
+// the base64 payload a piece at a time.
+static bool writeOsc52(std::string_view text)
+{
+    // Try to write to /dev/tty first, fall back to stdout
+    int fd = open("/dev/tty", O_WRONLY | O_CLOEXEC);
+    bool own = fd >= 0;
+    if (!own && isatty(STDOUT_FILENO))
+        fd = STDOUT_FILENO;
+    if (fd < 0)
+        return false;
+    bool ok = writeAll(fd, "\033]52;c;");
+    std::string encoded;
+    for (size_t done = 0; ok && done < text.size(); done += kOsc52Chunk)
+    {
+        encoded.clear();
+        base64Append(text.substr(done, kOsc52Chunk), encoded);
+        ok = writeAll(fd, encoded);
+    }
+    // Use BEL terminator instead of ST for better compatibility
+    ok = ok && writeAll(fd, "\a");
+    if (own)
+        close(fd);
+    return ok;
+}
+
+// Start a clipboard tool reading from a pipe.  Its output goes to
+// /dev/null so that it cannot disturb the screen.
+static pid_t startClipboardTool(const char *const argv[], int &input)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return -1;
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    pid_t pid;
+    int rc = posix_spawnp(&pid, argv[0], &actions, nullptr, const_cast<char *const *>(argv), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (rc != 0)
+    {
+        close(fds[1]);
+        return -1;
+    }
+    input = fds[1];
+    return pid;
+}
+
+std::string copyToClipboard(const Node *node, const std::function<void(size_t)> &progress)
+{
+    ClipboardTarget target = clipboardTarget();
+    if (target == ClipboardTarget::None)
+        return getClipboardStatusMessage();
+
+    size_t total = 0;
+    std::string error;
+    if (target == ClipboardTarget::Osc52)
+    {
+        // Nothing is sent until the whole text is known to fit.
+        constexpr size_t limit = kOsc52MaxPayload / 4 * 3;
+        std::string text;
+        JsonPrinter printer([&](std::string_view chunk) {
+            total += chunk.size();
+            if (text.size() + chunk.size() > limit)
+                return false;
+            text.append(chunk);
+            if (progress)
+                progress(total);
+            return true;
+        });
+        if (!printer.printNode(node, error))
+        {
+            if (total > limit)
+                return "Not copied: over the " + formatFileSize(limit) + " OSC 52 limit (see JSON_VIEW_CLIPBOARD_FILE)";
+            return "Not copied: " + error;
+        }
+        if (!writeOsc52(text))
+            return "Not copied: cannot write to the terminal";
+        return "JSON copied to clipboard (" + formatFileSize(total) + ")";
+    }
+
+    static const char *const wlCopy[] = {"wl-copy", nullptr};
+    static const char *const xclip[] = {"xclip", "-selection", "clipboard", nullptr};
+    static const char *const xsel[] = {"xsel", "--clipboard", "--input", nullptr};
+    const char *path = std::getenv("JSON_VIEW_CLIPBOARD_FILE");
+    int fd = -1;
+    pid_t pid = -1;
+    std::string name;
+    if (target == ClipboardTarget::File)
+    {
+        name = path;
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return "Not copied: cannot write " + name + ": " + std::strerror(errno);
+    }
+    else
+    {
+        const char *const *argv = target == ClipboardTarget::WlCopy ? wlCopy : target == ClipboardTarget::Xclip ? xclip : xsel;
+        name = argv[0];
+        pid = startClipboardTool(argv, fd);
+        if (pid < 0)
+            return "Not copied: cannot run " + name;
+    }
+
+    // A tool that exits early must not take the viewer with it.
+    struct sigaction ignore{}, previous;
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &previous);
+    int writeError = 0;
+    bool ok;
+    {
+        JsonPrinter printer([&](std::string_view chunk) {
+            total += chunk.size();
+            if (!writeAll(fd, chunk))
+            {
+                writeError = errno;
+                return false;
+            }
+            if (progress)
+                progress(total);
+            return true;
+        });
+        ok = printer.printNode(node, error);
+    }
+    close(fd);
+    sigaction(SIGPIPE, &previous, nullptr);
+    if (writeError)
+        error = name + ": " + std::strerror(writeError);
+    if (pid > 0)
+    {
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        if (ok && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+        {
+            ok = false;
+            error = name + " failed";
+        }
+    }
+    if (!ok)
+        return "Not copied: " + error;
+    if (target == ClipboardTarget::File)
+        return "JSON written to " + name + " (" + formatFileSize(total) + ")";
+    return "JSON copied to clipboard with " + name + " (" + formatFileSize(total) + ")";
+}
+
+// Reconstruct JSON from a node and its children
+json reconstructJson(const Node *node)
+{
+    if (node->isDummyRoot)
+    {
+        const NodeTree *tree = NodeTree::owner(node);
+        if (tree->isRecordList())
+        {
+            // A line-delimited document copies as an array of its records
+            json records = json::array();
+            for (size_t i = 0; i < tree->recordCount(); ++i)
+                records.push_back(parseRecordText(tree->recordText(i)));
+            return records;
+        }
+    }
+
+    // Return the JSON value of this node, parsing large containers of
+    // indexed documents just for the copy
+    if (const json *v = nodeValue(node))
+        return *v;
+    return parseSpanText(NodeTree::owner(node)->text(), *nodeSpan(node));
+}
+
+// Format file size in human-readable units
+std::string formatFileSize(size_t size)
+{
+    const char *units[] = {"Bytes", "KB", "MB", "GB", "TB"};
+    const size_t unitCount = sizeof(units) / sizeof(units[0]);
+
+    double fileSize = static_cast<double>(size);
+    size_t unitIndex = 0;
+
+    while (fileSize >= 1024.0 && unitIndex < unitCount - 1)
+    {
+        fileSize /= 1024.0;
+        unitIndex++;
+    }
+
+    // Format with appropriate precision
+    std::ostringstream oss;
+    if (unitIndex == 0)
+    {
+        // For bytes, show exact count
+        oss << static_cast<size_t>(fileSize) << " " << units[unitIndex];
+    }
+    else if (fileSize < 10.0)
+    {
+        // For smaller values, show one decimal place
+        oss.precision(1);
+        oss << std::fixed << fileSize << " " << units[unitIndex];
+    }
+    else
+    {
+        // For larger values, show whole numbers
+        oss << static_cast<int>(fileSize + 0.5) << " " << units[unitIndex];
+    }
+
+    return oss.str();
+}
+
+PerfStats perfStats;
+
+static constexpr const char *kPhaseNames[PerfStats::phaseCount] = {
+    "read", "parse", "special numbers", "build tree", "visible rows", "search", "draw"};
+static constexpr const char *kCounterNames[PerfStats::counterCount] = {
+    "bytes read", "nodes built", "values parsed", "special numbers", "search matches"};
+
+void PerfStats::record(PerfPhase phase, std::chrono::steady_clock::duration elapsed)
+{
+    if (!enabled())
+        return;
+    Phase &p = phases[static_cast<size_t>(phase)];
+    auto nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    p.calls.fetch_add(1, std::memory_order_relaxed);
+    p.nanos.fetch_add(nanos, std::memory_order_relaxed);
+    p.lastNanos.store(nanos, std::memory_order_relaxed);
+}
+
+uint64_t PerfStats::calls(PerfPhase phase) const
+{
+    return phases[static_cast<size_t>(phase)].calls.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds PerfStats::total(PerfPhase phase) const
+{
+    return std::chrono::nanoseconds(phases[static_cast<size_t>(phase)].nanos.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds PerfStats::last(PerfPhase phase) const
+{
+    return std::chrono::nanoseconds(phases[static_cast<size_t>(phase)].lastNanos.load(std::memory_order_relaxed));
+}
+
+uint64_t PerfStats::count(PerfCounter counter) const
+{
+    return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+// "850 us", "12.3 ms" or "4.56 s".
+static std::string formatDuration(std::chrono::nanoseconds duration)
+{
+    double us = static_cast<double>(duration.count()) / 1e3;
+    char text[32];
+    if (us < 1000.0)
+        snprintf(text, sizeof(text), "%.0f us", us);
+    else if (us < 1e6)
+        snprintf(text, sizeof(text), "%.1f ms", us / 1e3);
+    else
+        snprintf(text, sizeof(text), "%.2f s", us / 1e6);
+    return text;
+}
+
+std::string PerfStats::summary() const
+{
+    std::string out = "json-view statistics:\n";
+    char line[128];
+    snprintf(line, sizeof(line), "  %-16s %10s %12s %12s %12s\n", "phase", "calls", "total", "average", "last");
+    out += line;
+    for (size_t i = 0; i < phaseCount; ++i)
+    {
+        auto phase = static_cast<PerfPhase>(i);
+        uint64_t n = calls(phase);
+        if (n == 0)
+            continue;
+        snprintf(line, sizeof(line), "  %-16s %10llu %12s %12s %12s\n", kPhaseNames[i],
+                 static_cast<unsigned long long>(n), formatDuration(total(phase)).c_str(),
+                 formatDuration(total(phase) / n).c_str(), formatDuration(last(phase)).c_str());
+        out += line;
+    }
+    for (size_t i = 0; i < counterCount; ++i)
+    {
+        uint64_t value = count(static_cast<PerfCounter>(i));
+        std::string shown = static_cast<PerfCounter>(i) == PerfCounter::BytesRead ? formatFileSize(value)
+                                                                                  : std::to_string(value);
+        snprintf(line, sizeof(line), "  %-16s %s\n", kCounterNames[i], shown.c_str());
+        out += line;
+    }
+    snprintf(line, sizeof(line), "  %-16s %zu (%s)\n", "interned keys", keyTable.size(),
+             formatFileSize(keyTable.bytes()).c_str());
+    out += line;
+    snprintf(line, sizeof(line), "  %-16s %s\n", "peak memory", formatFileSize(peakMemoryUsage()).c_str());
+    out += line;
+    return out;
+}
+
+std::string PerfStats::overlay() const
+{
+    std::string out = "draw " + formatDuration(last(PerfPhase::Draw));
+    out += ", parse " + formatDuration(total(PerfPhase::Parse));
+    if (calls(PerfPhase::Search))
+        out += ", search " + formatDuration(last(PerfPhase::Search));
+    out += ", nodes " + std::to_string(count(PerfCounter::NodesBuilt));
+    out += ", rss " + formatFileSize(peakMemoryUsage());
+    return out;
+}
+
+size_t peakMemoryUsage()
+{
+    struct rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+// Output is written in chunks of about this size.
+static constexpr size_t kPrinterBuffer = 1 << 20;
+
+// Indentation is copied from one run of spaces.
+static const std::string kIndentSpaces(256, ' ');
+
+namespace
+{
+// Thrown out of the printing when the sink wants no more output.
+struct PrinterStopped
+{
+};
+} // namespace
+
+JsonPrinter::JsonPrinter(int fd)
+    : fd(fd)
+{
+    buffer.reserve(kPrinterBuffer + kIndentSpaces.size());
+}
+
+JsonPrinter::JsonPrinter(Sink sink)
+    : sink(std::move(sink))
+{
+    buffer.reserve(kPrinterBuffer + kIndentSpaces.size());
+}
+
+JsonPrinter::~JsonPrinter()
+{
+    try
+    {
+        flush();
+    }
+    catch (const PrinterStopped &)
+    {
+    }
+}
+
+void JsonPrinter::write(std::string_view text)
+{
+    buffer.append(text);
+    if (buffer.size() >= kPrinterBuffer)
+        flush();
+}
+
+void JsonPrinter::flush()
+{
+    if (sink)
+    {
+        if (buffer.empty())
+            return;
+        bool more = sink(buffer);
+        written += buffer.size();
+        buffer.clear();
+        if (!more)
+            throw PrinterStopped{};
+        return;
+    }
+    size_t done = 0;
+    while (done < buffer.size())
+    {
+        ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break; // nowhere to write to; drop the output
+        done += static_cast<size_t>(n);
+    }
+    written += buffer.size();
+    buffer.clear();
+}
+
+// A new line at the given depth.  This runs once per member, so it is
+// also where a full buffer is written out.
+void JsonPrinter::newLine(int indent)
+{
+    if (buffer.size() >= kPrinterBuffer)
+        flush();
+    buffer.push_back('\n');
+    for (; indent > static_cast<int>(kIndentSpaces.size()); indent -= static_cast<int>(kIndentSpaces.size()))
+        buffer.append(kIndentSpaces);
+    buffer.append(kIndentSpaces, 0, static_cast<size_t>(indent));
+}
+
+// Quote and escape a string as json::dump() does.  Runs of characters
+// that need no escape are copied in one go.
+void JsonPrinter::printString(std::string_view text)
+{
+    buffer.push_back('"');
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        buffer.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c)
+        {
+        case '"':
+            buffer.append("\\\"");
+            break;
+        case '\\':
+            buffer.append("\\\\");
+            break;
+        case '\b':
+            buffer.append("\\b");
+            break;
+        case '\f':
+            buffer.append("\\f");
+            break;
+        case '\n':
+            buffer.append("\\n");
+            break;
+        case '\r':
+            buffer.append("\\r");
+            break;
+        case '\t':
+            buffer.append("\\t");
+            break;
+        default:
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            buffer.append(escape);
+            break;
+        }
+        }
+    }
+    buffer.append(text.data() + run, text.size() - run);
+    buffer.push_back('"');
+}
+
+// Pretty-print JSON preserving NaN/Infinity literals
+void JsonPrinter::print(const json &j, int indent)
+{
+    char number[64];
+    switch (j.type())
+    {
+    case json::value_t::object:
+        if (j.empty())
+        {
+            buffer.append("{}");
+            return;
+        }
+        buffer.push_back('{');
+        for (auto it = j.cbegin(); it != j.cend(); ++it)
+        {
+            if (it != j.cbegin())
+                buffer.push_back(',');
+            newLine(indent + 2);
+            printString(it.key());
+            buffer.append(": ");
+            print(it.value(), indent + 2);
+        }
+        newLine(indent);
+        buffer.push_back('}');
+        break;
+    case json::value_t::array:
+        if (j.empty())
+        {
+            buffer.append("[]");
+            return;
+        }
+        buffer.push_back('[');
+        for (auto it = j.cbegin(); it != j.cend(); ++it)
+        {
+            if (it != j.cbegin())
+                buffer.push_back(',');
+            newLine(indent + 2);
+            print(*it, indent + 2);
+        }
+        newLine(indent);
+        buffer.push_back(']');
+        break;
+    case json::value_t::string:
+        printString(j.get_ref<const std::string &>());
+        break;
+    case json::value_t::boolean:
+        buffer.append(j.get<bool>() ? "true" : "false");
+        break;
+    case json::value_t::number_integer:
+        buffer.append(number, std::to_chars(number, number + sizeof(number), j.get<int64_t>()).ptr);
+        break;
+    case json::value_t::number_unsigned:
+        buffer.append(number, std::to_chars(number, number + sizeof(number), j.get<uint64_t>()).ptr);
+        break;
+    case json::value_t::number_float:
+    {
+        double d = j.get<double>();
+        if (std::isnan(d))
+            buffer.append("NaN");
+        else if (std::isinf(d))
+            buffer.append(d > 0 ? "Infinity" : "-Infinity");
+        else
+            buffer.append(number, nlohmann::detail::to_chars(number, number + sizeof(number), d));
+        break;
+    }
+    case json::value_t::null:
+        buffer.append("null");
+        break;
+    default:
+        buffer.append(j.dump());
+        break;
+    }
+}
+
+namespace
+{
+// A syntax error found while printing from text, at `offset`.
+struct TextSyntaxError
+{
+    size_t offset;
+    std::string detail;
+};
+} // namespace
+
+// Describe a syntax error like the parser does, adding the byte offset.
+static std::string formatSyntaxError(size_t line, size_t column, size_t offset, const std::string &detail)
+{
+    return "parse error at line " + std::to_string(line) + ", column " + std::to_string(column) + " (offset " +
+           std::to_string(offset) + "): " + detail;
+}
+
+static std::string describeSyntaxError(std::string_view text, size_t offset, const std::string &detail)
+{
+    offset = std::min(offset, text.size());
+    size_t line = 1 + static_cast<size_t>(std::count(text.begin(), text.begin() + offset, '\n'));
+    size_t lineStart = text.rfind('\n', offset ? offset - 1 : 0);
+    size_t column = lineStart == std::string_view::npos || lineStart >= offset ? offset + 1 : offset - lineStart;
+    return formatSyntaxError(line, column, offset, detail);
+}
+
+// Print the value at span.  Containers too large to parse whole are split
+// into their members, which are printed in turn; objects collect their
+// members first so they come out in the DOM's order.
+void JsonPrinter::printSpan(std::string_view text, const ValueSpan &span, int indent)
+{
+    if (!isLargeContainer(text, span))
+    {
+        std::string_view piece = text.substr(span.begin, span.end - span.begin);
+        try
+        {
+            print(parseJsonWithSpecialNumbers(piece), indent);
+        }
+        catch (const json::parse_error &e)
+        {
+            // Keep the parser's explanation but report the position in
+            // the whole text.
+            std::string what = e.what();
+            size_t detail = what.find(": ");
+            throw TextSyntaxError{span.begin + (e.byte ? e.byte - 1 : 0),
+                                  detail == std::string::npos ? what : what.substr(detail + 2)};
+        }
+        return;
+    }
+
+    size_t errorAt = 0;
+    auto malformed = [&]() {
+        return TextSyntaxError{errorAt, errorAt >= span.end ? "unexpected end of input"
+                                                            : std::string("unexpected '") + text[errorAt] + "'"};
+    };
+    bool first = true;
+    if (text[span.begin] == '[')
+    {
+        bool closed = forEachMember(
+            text, span,
+            [&](std::string_view, const ValueSpan &value) {
+                buffer.append(first ? "[" : ",");
+                first = false;
+                newLine(indent + 2);
+                printSpan(text, value, indent + 2);
+            },
+            nullptr, &errorAt);
+        if (!closed)
+            throw malformed();
+        if (first)
+            buffer.append("[]");
+        else
+        {
+            newLine(indent);
+            buffer.push_back(']');
+        }
+        return;
+    }
+
+    std::vector<SpanMember> members;
+    bool closed = forEachMember(
+        text, span,
+        [&](std::string_view key, const ValueSpan &value) {
+            // Names are validated like values, so escapes and non-ASCII
+            // text go through the parser.
+            bool plain = std::all_of(key.begin(), key.end(), [](char c) {
+                unsigned char u = static_cast<unsigned char>(c);
+                return u >= 0x20 && u < 0x80 && c != '\\';
+            });
+            std::string name;
+            if (plain)
+                name.assign(key.substr(1, key.size() - 2));
+            else
+            {
+                try
+                {
+                    name = json::parse(key).get<std::string>();
+                }
+                catch (const json::exception &)
+                {
+                    throw TextSyntaxError{static_cast<size_t>(key.data() - text.data()), "invalid member name"};
+                }
+            }
+            members.push_back(SpanMember{std::move(name), value});
+        },
+        nullptr, &errorAt);
+    if (!closed)
+        throw malformed();
+    if (members.empty())
+    {
+        buffer.append("{}");
+        return;
+    }
+    sortMembers(members);
+    buffer.push_back('{');
+    for (const SpanMember &member : members)
+    {
+        if (!first)
+            buffer.push_back(',');
+        first = false;
+        newLine(indent + 2);
+        printString(member.key);
+        buffer.append(": ");
+        printSpan(text, member.span, indent + 2);
+    }
+    newLine(indent);
+    buffer.push_back('}');
+}
+
+bool JsonPrinter::printText(std::string_view text, std::string &error, std::string_view whole)
+{
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && isJsonSpace(text[begin]))
+        ++begin;
+    while (end > begin && isJsonSpace(text[end - 1]))
+        --end;
+    // Parse errors are reported against the text as given.
+    bool large = begin < end && isLargeContainer(text, ValueSpan{begin, end});
+    ValueSpan span{large ? begin : 0, large ? end : text.size()};
+    size_t writtenBefore = written;
+    size_t bufferedBefore = buffer.size();
+    try
+    {
+        printSpan(text, span, 0);
+        return true;
+    }
+    catch (const TextSyntaxError &e)
+    {
+        error = whole.empty() ? describeSyntaxError(text, e.offset, e.detail)
+                              : describeSyntaxError(whole, text.data() - whole.data() + e.offset, e.detail);
+    }
+    // Drop what was not written out yet; if part of the document already
+    // was, at least end its line.
+    if (written == writtenBefore)
+        buffer.resize(bufferedBefore);
+    else
+    {
+        buffer.clear();
+        buffer.push_back('\n');
+    }
+    return false;
+}
+
+bool JsonPrinter::printNode(const Node *node, std::string &error)
+{
+    const NodeTree *tree = NodeTree::owner(node);
+    try
+    {
+        if (node->isDummyRoot && tree->isRecordList())
+        {
+            // One record at a time; records that do not parse copy as
+            // strings, as they are shown
+            buffer.push_back('[');
+            for (size_t i = 0; i < tree->recordCount(); ++i)
+            {
+                if (i)
+                    buffer.push_back(',');
+                newLine(2);
+                print(parseRecordText(tree->recordText(i)), 2);
+            }
+            if (tree->recordCount())
+                newLine(0);
+            buffer.push_back(']');
+        }
+        else if (const json *v = nodeValue(node))
+            print(*v, 0);
+        else
+            printSpan(tree->text(), *nodeSpan(node), 0);
+        flush();
+        return true;
+    }
+    catch (const TextSyntaxError &e)
+    {
+        error = describeSyntaxError(tree->text(), e.offset, e.detail);
+    }
+    catch (const PrinterStopped &)
+    {
+        error = "output stopped";
+    }
+    buffer.clear();
+    return false;
+}
+
+// Pretty-print JSON preserving NaN/Infinity literals
+void printFormattedJson(const json &j, int indent)
+{
+    std::cout.flush();
+    JsonPrinter printer;
+    printer.print(j, indent);
+}
+
+Compression detectCompression(std::string_view head)
+{
+    if (head.size() >= 2 && head[0] == '\x1f' && head[1] == '\x8b')
+        return Compression::Gzip;
+    if (head.size() >= 4 && head.substr(0, 4) == std::string_view("\x28\xb5\x2f\xfd", 4))
+        return Compression::Zstd;
+    return Compression::None;
+}
+
+Compression fileCompression(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return Compression::None;
+    char head[4];
+    ssize_t n = ::pread(fd, head, sizeof(head), 0);
+    ::close(fd);
+    return n > 0 ? detectCompression(std::string_view(head, static_cast<size_t>(n))) : Compression::None;
+}
+
+// Decompressed text is handed over in chunks of this size, and at most
+// kDecompressAhead of them wait for the reader.
+static constexpr size_t kDecompressChunk = 1 << 20;
+static constexpr size_t kDecompressAhead = 4;
+// zlib counts its input in 32-bit units.
+static constexpr size_t kDecompressInputSlice = 1 << 30;
+
+namespace
+{
+// Decompresses gzip (including concatenated members) or zstd input on a
+// thread of its own, a few chunks ahead of the reader, so decompressing
+// overlaps with whatever consumes the text and only those chunks of it
+// exist at a time.  The compressed bytes are in memory, or are read from
+// a descriptor after `head`, the ones already read from it.
+class Decompressor
+{
+public:
+    Decompressor(std::string_view data, Compression compression) : data(data)
+    {
+        worker = std::thread(&Decompressor::run, this, compression);
+    }
+    Decompressor(int fd, std::string head, Compression compression) : fd(fd), readBuffer(std::move(head))
+    {
+        headPending = !readBuffer.empty();
+        consumed.store(readBuffer.size(), std::memory_order_relaxed);
+        worker = std::thread(&Decompressor::run, this, compression);
+    }
+    ~Decompressor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+    Decompressor(const Decompressor &) = delete;
+    Decompressor &operator=(const Decompressor &) = delete;
+
+    // Like read(2): up to size bytes, 0 at the end and -1 on failure.
+    ssize_t read(char *out, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return !chunks.empty() || finished; });
+        if (chunks.empty())
+            return failure.empty() ? 0 : -1;
+        const std::string &front = chunks.front();
+        size_t n = std::min(size, front.size() - offset);
+        std::memcpy(out, front.data() + offset, n);
+        offset += n;
+        if (offset == front.size())
+        {
+            chunks.pop_front();
+            offset = 0;
+            changed.notify_all();
+        }
+        return static_cast<ssize_t>(n);
+    }
+
+    // Compressed bytes consumed so far.
+    size_t position() const { return consumed.load(std::memory_order_relaxed); }
+    // Why read() returned -1.
+    std::string error() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return failure;
+    }
+
+private:
+    void run(Compression compression)
+    {
+        std::string error;
+        bool ok = compression == Compression::Gzip ? inflateGzip(error) : inflateZstd(error);
+        if (ok && !readError.empty())
+        {
+            ok = false;
+            error = readError;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ok)
+                failure = error.empty() ? "invalid compressed data" : error;
+            finished = true;
+        }
+        changed.notify_all();
+    }
+
+    // The next piece of compressed input; false at its end.
+    bool nextInput(std::string_view &in)
+    {
+        if (fd < 0)
+        {
+            if (dataGiven)
+                return false;
+            dataGiven = true;
+            in = data;
+            return !in.empty();
+        }
+        if (headPending)
+        {
+            headPending = false;
+            in = readBuffer;
+            return true;
+        }
+        readBuffer.resize(kDecompressChunk);
+        for (;;)
+        {
+            ssize_t n = ::read(fd, readBuffer.data(), readBuffer.size());
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                readError = std::strerror(errno);
+            if (n <= 0)
+                return false;
+            perfStats.add(PerfCounter::BytesRead, static_cast<size_t>(n));
+            in = std::string_view(readBuffer.data(), static_cast<size_t>(n));
+            return true;
+        }
+    }
+
+    // Queue a chunk for the reader; false when the reader has gone.
+    bool deliver(std::string &chunk, size_t size)
+    {
+        if (size == 0)
+            return true;
+        chunk.resize(size);
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return chunks.size() < kDecompressAhead || stop; });
+        if (stop)
+            return false;
+        chunks.push_back(std::move(chunk));
+        lock.unlock();
+        changed.notify_all();
+        chunk.assign(kDecompressChunk, '\0');
+        return true;
+    }
+
+    bool stopped()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stop;
+    }
+
+    bool inflateGzip(std::string &error)
+    {
+#ifdef JSON_VIEW_HAVE_ZLIB
+        z_stream zs{};
+        if (inflateInit2(&zs, 15 + 32) != Z_OK)
+        {
+            error = "cannot start decompressing";
+            return false;
+        }
+        std::string out(kDecompressChunk, '\0');
+        size_t produced = 0;
+        std::string_view in;
+        // Inside a member that has not ended; after the first member only
+        // another member or trailing garbage can follow, as for gzip -d.
+        bool inMember = false;
+        bool sawMember = false;
+        bool flushing = false;
+        bool ok = true;
+        for (;;)
+        {
+            if (zs.avail_in == 0 && !flushing)
+            {
+                if (in.empty() && !nextInput(in))
+                    break;
+                size_t take = std::min(in.size(), kDecompressInputSlice);
+                zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+                zs.avail_in = static_cast<uInt>(take);
+                in.remove_prefix(take);
+            }
+            zs.next_out = reinterpret_cast<Bytef *>(out.data() + produced);
+            zs.avail_out = static_cast<uInt>(out.size() - produced);
+            uInt before = zs.avail_in;
+            int rc = inflate(&zs, Z_NO_FLUSH);
+            consumed.fetch_add(before - zs.avail_in, std::memory_order_relaxed);
+            produced = out.size() - zs.avail_out;
+            flushing = produced == out.size();
+            if (rc == Z_STREAM_END)
+            {
+                inMember = false;
+                sawMember = true;
+                inflateReset(&zs);
+            }
+            else if (rc == Z_OK)
+                inMember = true;
+            else if (rc != Z_BUF_ERROR)
+            {
+                if (!sawMember || inMember)
+                {
+                    error = zs.msg ? zs.msg : "invalid gzip data";
+                    ok = false;
+                }
+                break;
+            }
+            if (flushing && !deliver(out, produced))
+                break;
+            if (flushing)
+                produced = 0;
+        }
+        if (ok && inMember)
+        {
+            error = "unexpected end of gzip data";
+            ok = false;
+        }
+        inflateEnd(&zs);
+        deliver(out, produced);
+        return ok || stopped();
+#else
+        error = "this build cannot read gzip files";
+        return false;
+#endif
+    }
+
+    bool inflateZstd(std::string &error)
+    {
+#ifdef JSON_VIEW_HAVE_ZSTD
+        ZSTD_DStream *zs = ZSTD_createDStream();
+        if (!zs || ZSTD_isError(ZSTD_initDStream(zs)))
+        {
+            ZSTD_freeDStream(zs);
+            error = "cannot start decompressing";
+            return false;
+        }
+        std::string out(kDecompressChunk, '\0');
+        size_t produced = 0;
+        std::string_view in;
+        ZSTD_inBuffer input{nullptr, 0, 0};
+        // Zero once a frame has been decoded and flushed completely.
+        size_t pending = 0;
+        bool flushing = false;
+        bool ok = true;
+        for (;;)
+        {
+            if (input.pos == input.size && !flushing)
+            {
+                if (in.empty() && !nextInput(in))
+                    break;
+                size_t take = std::min(in.size(), kDecompressInputSlice);
+                input = ZSTD_inBuffer{in.data(), take, 0};
+                in.remove_prefix(take);
+            }
+            ZSTD_outBuffer output{out.data(), out.size(), produced};
+            size_t before = input.pos;
+            pending = ZSTD_decompressStream(zs, &output, &input);
+            consumed.fetch_add(input.pos - before, std::memory_order_relaxed);
+            if (ZSTD_isError(pending))
+            {
+                error = ZSTD_getErrorName(pending);
+                ok = false;
+                break;
+            }
+            produced = output.pos;
+            flushing = produced == out.size();
+            if (flushing && !deliver(out, produced))
+                break;
+            if (flushing)
+                produced = 0;
+        }
+        if (ok && pending != 0)
+        {
+            error = "unexpected end of zstd data";
+            ok = false;
+        }
+        ZSTD_freeDStream(zs);
+        deliver(out, produced);
+        return ok || stopped();
+#else
+        error = "this build cannot read zstd files";
+        return false;
+#endif
+    }
+
+    std::string_view data;
+    bool dataGiven = false;
+    int fd = -1;
+    std::string readBuffer;
+    bool headPending = false;
+    std::string readError;
+    std::atomic<size_t> consumed{0};
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::string> chunks;
+    size_t offset = 0;
+    bool finished = false;
+    bool stop = false;
+    std::string failure;
+    std::thread worker;
+};
+
+// An unlinked file for decompressed text: in $TMPDIR, else /var/tmp,
+// which unlike /tmp is seldom kept in memory.
+int openTemporaryFile(std::string &error)
+{
+    const char *tmp = std::getenv("TMPDIR");
+    std::string directory = tmp && *tmp ? tmp : "/var/tmp";
+#ifdef O_TMPFILE
+    int fd = ::open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0)
+        return fd;
+#endif
+    std::string name = directory + "/json-view.XXXXXX";
+    int temporary = mkstemp(name.data());
+    if (temporary < 0)
+    {
+        error = "cannot create a temporary file in " + directory + ": " + std::strerror(errno);
+        return -1;
+    }
+    ::unlink(name.c_str());
+    fcntl(temporary, F_SETFD, FD_CLOEXEC);
+    return temporary;
+}
+} // namespace
+
+bool InputBuffer::decompress(std::string &error, ParseProgress *progress)
+{
+    Compression compression = detectCompression(view());
+    if (compression == Compression::None)
+        return true;
+    int fd = openTemporaryFile(error);
+    if (fd < 0)
+        return false;
+    bool ok = true;
+    try
+    {
+        Decompressor decompressor(view(), compression);
+        std::vector<char> chunk(kDecompressChunk);
+        while (ok)
+        {
+            ssize_t n = decompressor.read(chunk.data(), chunk.size());
+            if (n < 0)
+            {
+                error = decompressor.error();
+                ok = false;
+            }
+            if (n <= 0)
+                break;
+            if (progress)
+                progress->update(decompressor.position());
+            for (ssize_t written = 0; ok && written < n;)
+            {
+                ssize_t w = ::write(fd, chunk.data() + written, static_cast<size_t>(n - written));
+                if (w < 0 && errno == EINTR)
+                    continue;
+                if (w < 0)
+                {
+                    error = std::string("cannot write decompressed text: ") + std::strerror(errno);
+                    ok = false;
+                }
+                else
+                    written += w;
+            }
+        }
+    }
+    catch (...)
+    {
+        ::close(fd);
+        throw;
+    }
+    if (ok && ::lseek(fd, 0, SEEK_SET) != 0)
+    {
+        error = std::strerror(errno);
+        ok = false;
+    }
+    ok = ok && openDescriptor(fd, error);
+    ::close(fd);
+    return ok;
+}
+
+InputBuffer::~InputBuffer()
+{
+    release();
+}
+
+InputBuffer::InputBuffer(InputBuffer &&other) noexcept
+    : mapped(other.mapped), mappedSize(other.mappedSize), owned(std::move(other.owned))
+{
+    other.mapped = nullptr;
+    other.mappedSize = 0;
+}
+
+InputBuffer &InputBuffer::operator=(InputBuffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        mapped = other.mapped;
+        mappedSize = other.mappedSize;
+        owned = std::move(other.owned);
+        other.mapped = nullptr;
+        other.mappedSize = 0;
+    }
+    return *this;
+}
+
+// Drop the mapping or heap buffer so the memory is returned immediately
+// rather than when the object goes out of scope.
+void InputBuffer::release()
+{
+    if (mapped)
+    {
+        munmap(const_cast<char *>(mapped), mappedSize);
+        mapped = nullptr;
+        mappedSize = 0;
+    }
+    std::string().swap(owned);
+}
+
+bool InputBuffer::openFile(const std::string &path, std::string &error)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error = std::strerror(errno);
+        return false;
+    }
+    bool ok = openDescriptor(fd, error);
+    ::close(fd);
+    return ok;
+}
+
+// Load the contents behind an open descriptor.  The descriptor is not
+// closed, so this also serves stdin.
+bool InputBuffer::openDescriptor(int fd, std::string &error)
+{
+    release();
+    PerfTimer timer(PerfPhase::Read);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        error = std::strerror(errno);
+        return false;
+    }
+
+    // Map regular files read from the start.  A descriptor that has already
+    // been advanced (e.g. a partially consumed redirect) is read below so the
+    // consumed prefix is not shown.
+    if (S_ISREG(st.st_mode) && st.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0)
+    {
+        size_t length = static_cast<size_t>(st.st_size);
+        void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+#ifdef MADV_SEQUENTIAL
+            madvise(addr, length, MADV_SEQUENTIAL);
+#endif
+            mapped = static_cast<const char *>(addr);
+            mappedSize = length;
+            perfStats.add(PerfCounter::BytesRead, length);
+            return true;
+        }
+    }
+
+    // Pipes, terminals, special files and anything mmap refused: read in
+    // large chunks, using the reported size as a hint when there is one.
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+        owned.reserve(static_cast<size_t>(st.st_size));
+    constexpr size_t chunkSize = 1 << 20;
+    for (;;)
+    {
+        size_t used = owned.size();
+        owned.resize(used + chunkSize);
+        ssize_t n = ::read(fd, &owned[used], chunkSize);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                owned.resize(used);
+                continue;
+            }
+            error = std::strerror(errno);
+            owned.clear();
+            return false;
+        }
+        owned.resize(used + static_cast<size_t>(n));
+        if (n == 0)
+            break;
+    }
+    perfStats.add(PerfCounter::BytesRead, owned.size());
+    return true;
+}
+
+// NaN, Infinity and -Infinity are not valid JSON, but they show up in
+// dumps produced by Python and JavaScript tooling.  The standard lexer
+// rejects them, so SpecialNumberIterator rewrites each bare literal into a
+// quoted placeholder while the lexer pulls characters, and SpecialNumberSax
+// turns those placeholders back into numbers as the DOM is built.  The
+// input is read exactly once and no rewritten copy is materialised.
+static constexpr const char *kNaNPlaceholder = "\"__JSON_VIEW_NaN__\"";
+static constexpr const char *kInfPlaceholder = "\"__JSON_VIEW_INF__\"";
+static constexpr const char *kNegInfPlaceholder = "\"__JSON_VIEW_NEG_INF__\"";
+
+void ParseProgress::update(size_t position)
+{
+    consumed.store(position, std::memory_order_relaxed);
+    if (cancel && cancel->load(std::memory_order_relaxed))
+        throw ParseCancelled();
+}
+
+namespace
+{
+// Plain character iterator that publishes its position to a ParseProgress.
+class ProgressIterator
+{
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char *;
+    using reference = const char &;
+
+    ProgressIterator(const char *pos, const char *base, ParseProgress *progress)
+        : pos(pos), base(base), progress(progress)
+    {
+    }
+
+    reference operator*() const { return *pos; }
+
+    ProgressIterator &operator++()
+    {
+        ++pos;
+        if ((reinterpret_cast<uintptr_t>(pos) & (kProgressStride - 1)) == 0)
+            progress->update(static_cast<size_t>(pos - base));
+        return *this;
+    }
+
+    bool operator==(const ProgressIterator &other) const { return pos == other.pos; }
+    bool operator!=(const ProgressIterator &other) const { return pos != other.pos; }
+
+private:
+    const char *pos;
+    const char *base;
+    ParseProgress *progress;
+};
+
+class SpecialNumberIterator
+{
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char *;
+    using reference = const char &;
+
+    SpecialNumberIterator(const char *pos, const char *end, const char *base = nullptr,
+                          ParseProgress *progress = nullptr)
+        : pos(pos), end(end), base(base), progress(progress)
+    {
+        settle();
+    }
+
+    reference operator*() const { return pending ? *pending : *pos; }
+
+    SpecialNumberIterator &operator++()
+    {
+        if (pending)
+        {
+            if (*++pending == '\0')
+                pending = nullptr;
+        }
+        else
+        {
+            char c = *pos++;
+            if (progress && (reinterpret_cast<uintptr_t>(pos) & (kProgressStride - 1)) == 0)
+                progress->update(static_cast<size_t>(pos - base));
+            if (escaped)
+                escaped = false;
+            else if (inString && c == '\\')
+                escaped = true;
+            else if (c == '"')
+                inString = !inString;
+        }
+        if (!pending)
+            settle();
+        return *this;
+    }
+
+    bool operator==(const SpecialNumberIterator &other) const
+    {
+        return pos == other.pos && pending == other.pending;
+    }
+    bool operator!=(const SpecialNumberIterator &other) const { return !(*this == other); }
+
+private:
+    // Substitute a placeholder when a literal starts at the current position.
+    void settle()
+    {
+        if (inString || pos == end)
+            return;
+        std::string_view rest(pos, static_cast<size_t>(end - pos));
+        switch (*pos)
+        {
+        case 'N':
+            if (rest.compare(0, 3, "NaN") == 0)
+                substitute(kNaNPlaceholder, 3);
+            break;
+        case 'I':
+            if (rest.compare(0, 8, "Infinity") == 0)
+                substitute(kInfPlaceholder, 8);
+            break;
+        case '-':
+            if (rest.compare(0, 9, "-Infinity") == 0)
+                substitute(kNegInfPlaceholder, 9);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void substitute(const char *placeholder, size_t literalLength)
+    {
+        perfStats.add(PerfCounter::SpecialNumbers);
+        pending = placeholder;
+        pos += literalLength;
+    }
+
+    const char *pos;
+    const char *end;
+    const char *base;
+    ParseProgress *progress;
+    const char *pending = nullptr;
+    bool inString = false;
+    bool escaped = false;
+};
+
+using SpecialNumberAdapter = decltype(nlohmann::detail::input_adapter(
+    std::declval<SpecialNumberIterator>(), std::declval<SpecialNumberIterator>()));
+
+template <typename Adapter>
+class SpecialNumberSax : public nlohmann::detail::json_sax_dom_parser<json, Adapter>
+{
+    using Base = nlohmann::detail::json_sax_dom_parser<json, Adapter>;
+
+public:
+    using Base::Base;
+
+    bool string(json::string_t &val)
+    {
+        // Placeholders are 17-21 bytes and share a prefix, so the common
+        // case is rejected by the length or first-byte test.
+        if (val.size() >= 17 && val.size() <= 21 && val[0] == '_' && val.compare(0, 12, "__JSON_VIEW_") == 0)
+        {
+            if (val == "__JSON_VIEW_NaN__")
+                return Base::number_float(std::numeric_limits<double>::quiet_NaN(), val);
+            if (val == "__JSON_VIEW_INF__")
+                return Base::number_float(std::numeric_limits<double>::infinity(), val);
+            if (val == "__JSON_VIEW_NEG_INF__")
+                return Base::number_float(-std::numeric_limits<double>::infinity(), val);
+        }
+        return Base::string(val);
+    }
+};
+} // namespace
+
+// Parse JSON while preserving NaN/Infinity literals.  Documents that do not
+// contain the literals anywhere (the overwhelmingly common case) are handed
+// to the standard parser untouched.  When progress is given the parser
+// publishes its position there as it goes.
+json parseJsonWithSpecialNumbers(std::string_view contents, ParseProgress *progress)
+{
+    PerfTimer timer(PerfPhase::Parse);
+    const char *begin = contents.data();
+    const char *end = begin + contents.size();
+    PerfTimer scan(PerfPhase::SpecialNumbers);
+    bool special = contents.find("NaN") != std::string_view::npos ||
+                   contents.find("Infinity") != std::string_view::npos;
+    scan.stop();
+    if (!special)
+    {
+        if (!progress)
+            return json::parse(begin, end);
+        json j = json::parse(ProgressIterator(begin, begin, progress), ProgressIterator(end, begin, progress));
+        progress->consumed.store(contents.size(), std::memory_order_relaxed);
+        return j;
+    }
+
+    json j;
+    SpecialNumberSax<SpecialNumberAdapter> sax(j);
+    json::sax_parse(SpecialNumberIterator(begin, end, begin, progress), SpecialNumberIterator(end, end), &sax);
+    if (progress)
+        progress->consumed.store(contents.size(), std::memory_order_relaxed);
+    return j;
+}
+
+// Validation reads its input in chunks of this size.
+static constexpr size_t kValidateChunk = 1 << 20;
+
+namespace
+{
+// Source of the streaming validator: a descriptor read a chunk at a time,
+// with NaN/Infinity rewritten into placeholders as SpecialNumberIterator
+// does.  It knows the line and column it has reached, so errors can be
+// reported by position.  In line mode every newline ends the current
+// record until nextRecord() is called.  Compressed input is recognised
+// by its first bytes and decompressed on the way.
+class ChunkReader
+{
+public:
+    ChunkReader(int fd, bool lines, ParseProgress *progress)
+        : fd(fd), lines(lines), progress(progress), buffer(kValidateChunk)
+    {
+    }
+    ChunkReader(std::unique_ptr<Decompressor> source, ParseProgress *progress)
+        : fd(-1), lines(false), progress(progress), buffer(kValidateChunk), decompressor(std::move(source)),
+          sniffed(true)
+    {
+    }
+
+    std::char_traits<char>::int_type next()
+    {
+        if (pending)
+        {
+            char c = *pending++;
+            if (*pending == '\0')
+                pending = nullptr;
+            return std::char_traits<char>::to_int_type(c);
+        }
+        if (atRecordEnd || !available(1))
+        {
+            pastEnd = true;
+            return std::char_traits<char>::eof();
+        }
+        char c = buffer[pos];
+        if (c == '\n' && lines)
+        {
+            // Left for nextRecord(), so errors point into the record
+            atRecordEnd = true;
+            pastEnd = true;
+            return std::char_traits<char>::eof();
+        }
+        if (!inString && (c == 'N' || c == 'I' || c == '-') && substitute())
+            return next();
+        consume(1);
+        if (escaped)
+            escaped = false;
+        else if (inString && c == '\\')
+            escaped = true;
+        else if (c == '"')
+            inString = !inString;
+        return std::char_traits<char>::to_int_type(c);
+    }
+
+    // Skip blank lines; false at the end of the input.
+    bool nextRecord()
+    {
+        atRecordEnd = false;
+        pastEnd = false;
+        inString = false;
+        escaped = false;
+        while (available(1))
+        {
+            char c = buffer[pos];
+            if (c != '\n' && !isJsonSpace(c))
+                return true;
+            consume(1);
+        }
+        return false;
+    }
+
+    // Input bytes read, before any decompression.
+    size_t bytesRead() const { return decompressor ? decompressor->position() : consumed; }
+    // Position of the last byte handed out, or of the end of the input
+    // (or record) once that was reached, as the library's lexer counts.
+    size_t offset() const { return pastEnd ? consumed : consumed ? consumed - 1 : 0; }
+    size_t line() const { return currentLine; }
+    size_t column() const { return std::max<size_t>(1, consumed - lineStart + (pastEnd ? 1 : 0)); }
+    const std::string &readError() const { return error; }
+
+private:
+    // Make at least `count` bytes available, reading more if need be.
+    bool available(size_t count)
+    {
+        if (end - pos >= count)
+            return true;
+        if (eof)
+            return false;
+        std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+        end -= pos;
+        pos = 0;
+        while (end < count && !eof)
+        {
+            ssize_t n = decompressor ? decompressor->read(buffer.data() + end, buffer.size() - end)
+                                     : readInput(buffer.data() + end, buffer.size() - end);
+            if (n < 0 && !decompressor && errno == EINTR)
+                continue;
+            if (n < 0)
+                error = decompressor ? decompressor->error() : std::strerror(errno);
+            if (n <= 0)
+                eof = true;
+            else
+                end += static_cast<size_t>(n);
+        }
+        if (progress)
+            progress->update(bytesRead());
+        return end - pos >= count;
+    }
+
+    // Read from the descriptor, switching to a decompressor when the
+    // first bytes are a gzip or zstd header.
+    ssize_t readInput(char *out, size_t size)
+    {
+        if (sniffed)
+        {
+            ssize_t n = ::read(fd, out, size);
+            if (n > 0)
+                perfStats.add(PerfCounter::BytesRead, static_cast<size_t>(n));
+            return n;
+        }
+        char head[4];
+        size_t got = 0;
+        while (got < sizeof(head))
+        {
+            ssize_t n = ::read(fd, head + got, sizeof(head) - got);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && got == 0)
+                return -1;
+            if (n <= 0)
+                break;
+            got += static_cast<size_t>(n);
+        }
+        sniffed = true;
+        perfStats.add(PerfCounter::BytesRead, got);
+        Compression compression = detectCompression(std::string_view(head, got));
+        if (compression == Compression::None)
+        {
+            std::memcpy(out, head, got);
+            return static_cast<ssize_t>(got);
+        }
+        decompressor = std::make_unique<Decompressor>(fd, std::string(head, got), compression);
+        ssize_t n = decompressor->read(out, size);
+        if (n < 0)
+            error = decompressor->error();
+        return n;
+    }
+
+    void consume(size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (buffer[pos + i] == '\n')
+            {
+                ++currentLine;
+                lineStart = consumed + i + 1;
+            }
+        }
+        pos += count;
+        consumed += count;
+    }
+
+    bool substitute()
+    {
+        static constexpr struct
+        {
+            std::string_view literal;
+            const char *placeholder;
+        } kLiterals[] = {
+            {"NaN", kNaNPlaceholder},
+            {"Infinity", kInfPlaceholder},
+            {"-Infinity", kNegInfPlaceholder},
+        };
+        for (const auto &entry : kLiterals)
+        {
+            if (buffer[pos] != entry.literal[0])
+                continue;
+            available(entry.literal.size());
+            if (std::string_view(buffer.data() + pos, end - pos).substr(0, entry.literal.size()) != entry.literal)
+                continue;
+            consume(entry.literal.size());
+            pending = entry.placeholder;
+            return true;
+        }
+        return false;
+    }
+
+    int fd;
+    bool lines;
+    ParseProgress *progress;
+    std::vector<char> buffer;
+    size_t pos = 0;
+    size_t end = 0;
+    size_t consumed = 0;
+    size_t currentLine = 1;
+    size_t lineStart = 0;
+    const char *pending = nullptr;
+    bool inString = false;
+    bool escaped = false;
+    bool atRecordEnd = false;
+    // The end of the input or record was handed out
+    bool pastEnd = false;
+    bool eof = false;
+    std::string error;
+    std::unique_ptr<Decompressor> decompressor;
+    bool sniffed = false;
+};
+
+// The library's lexer pulls characters through get_character().
+struct ChunkReaderAdapter
+{
+    using char_type = char;
+    ChunkReader *reader;
+
+    std::char_traits<char>::int_type get_character() { return reader->next(); }
+};
+
+// Accepts every value and keeps the explanation of the first error.
+class ValidatingSax : public nlohmann::detail::json_sax_acceptor<json>
+{
+public:
+    std::string detail;
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &ex)
+    {
+        std::string what = ex.what();
+        size_t colon = what.find(": ");
+        detail = colon == std::string::npos ? what : what.substr(colon + 2);
+        return false;
+    }
+};
+} // namespace
+
+bool validateJson(int fd, bool lines, std::string &error, ParseProgress *progress)
+{
+    PerfTimer timer(PerfPhase::Parse);
+    ChunkReader reader(fd, lines, progress);
+    while (!lines || reader.nextRecord())
+    {
+        ValidatingSax sax;
+        nlohmann::detail::parser<json, ChunkReaderAdapter> parser(ChunkReaderAdapter{&reader});
+        if (!parser.sax_parse(&sax))
+        {
+            error = reader.readError().empty()
+                        ? formatSyntaxError(reader.line(), reader.column(), reader.offset(), sax.detail)
+                        : reader.readError();
+            if (progress)
+                progress->consumed.store(reader.bytesRead(), std::memory_order_relaxed);
+            return false;
+        }
+        if (!lines)
+            break;
+    }
+    if (progress)
+        progress->consumed.store(reader.bytesRead(), std::memory_order_relaxed);
+    return true;
+}
+
+json parseCompressedJson(std::string_view compressed, ParseProgress *progress)
+{
+    PerfTimer timer(PerfPhase::Parse);
+    ChunkReader reader(std::make_unique<Decompressor>(compressed, detectCompression(compressed)), progress);
+    json j;
+    SpecialNumberSax<ChunkReaderAdapter> sax(j);
+    try
+    {
+        nlohmann::detail::parser<json, ChunkReaderAdapter>(ChunkReaderAdapter{&reader}).sax_parse(&sax);
+    }
+    catch (const json::exception &)
+    {
+        // A damaged stream ends early; say so rather than what the
+        // parser made of the missing text.
+        if (!reader.readError().empty())
+            throw std::runtime_error(reader.readError());
+        throw;
+    }
+    if (progress)
+        progress->consumed.store(compressed.size(), std::memory_order_relaxed);
+    return j;
+}
+
+static size_t defaultMemoryBudget()
+{
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || pageSize <= 0)
+        return SIZE_MAX;
+    return static_cast<size_t>(pages) / 2 * static_cast<size_t>(pageSize);
+}
+
+// File names that are read as JSON Lines unless told otherwise.
+bool isLineDelimitedPath(const std::string &path)
+{
+    auto endsWith = [&](std::string_view suffix) {
+        return path.size() > suffix.size() &&
+               std::equal(suffix.rbegin(), suffix.rend(), path.rbegin(),
+                          [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); });
+    };
+    if (endsWith(".gz"))
+        return isLineDelimitedPath(path.substr(0, path.size() - 3));
+    if (endsWith(".zst"))
+        return isLineDelimitedPath(path.substr(0, path.size() - 4));
+    return endsWith(".jsonl") || endsWith(".ndjson");
+}
+
+// Only inputs whose scan takes noticeable time get a cached index.
+static constexpr size_t kMinCachedIndexInput = 1 << 20;
+
+// Directory holding saved indexes, or empty when there is no home.
+static std::string indexCacheDirectory()
+{
+    const char *xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg)
+        return std::string(xdg) + "/json-view";
+    const char *home = std::getenv("HOME");
+    if (home && *home)
+        return std::string(home) + "/.cache/json-view";
+    return std::string();
+}
+
+// Create a directory and its missing parents.
+static bool makeDirectories(const std::string &path)
+{
+    for (size_t slash = path.find('/', 1);; slash = path.find('/', slash + 1))
+    {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0700) != 0 && errno != EEXIST)
+            return false;
+        if (slash == std::string::npos)
+            return true;
+    }
+}
+
+// Identity of a file version: the cached index must match all of it.
+static std::string indexCacheKey(const std::string &path, std::string &absolute)
+{
+    char *resolved = realpath(path.c_str(), nullptr);
+    if (!resolved)
+        return std::string();
+    absolute = resolved;
+    std::free(resolved);
+    struct stat st;
+    if (stat(absolute.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return std::string();
+#if defined(__APPLE__)
+    long nanoseconds = st.st_mtimespec.tv_nsec;
+#else
+    long nanoseconds = st.st_mtim.tv_nsec;
+#endif
+    std::string key;
+    putIndexField(key, static_cast<uint64_t>(st.st_size));
+    putIndexField(key, static_cast<int64_t>(st.st_mtime));
+    putIndexField(key, static_cast<int64_t>(nanoseconds));
+    putIndexField(key, static_cast<uint32_t>(absolute.size()));
+    return key + absolute;
+}
+
+std::unique_ptr<NodeTree> buildIndexedTree(InputBuffer input, const std::string &path, NodeTree::Layout layout,
+                                           ParseProgress *progress)
+{
+    std::string cacheFile;
+    std::string key;
+    InputBuffer cached;
+    std::string_view saved;
+    std::string directory = indexCacheDirectory();
+    if (input.size() >= kMinCachedIndexInput && !std::getenv("JSON_VIEW_NO_INDEX_CACHE") && !directory.empty())
+    {
+        std::string absolute;
+        key = indexCacheKey(path, absolute);
+        if (!key.empty())
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/%016zx.idx", std::hash<std::string>()(absolute));
+            cacheFile = directory + name;
+            std::string error;
+            if (cached.openFile(cacheFile, error) && cached.view().substr(0, key.size()) == key)
+                saved = cached.view().substr(key.size());
+        }
+    }
+
+    auto tree = std::make_unique<NodeTree>(std::move(input), path, layout, progress, saved);
+    if (!cacheFile.empty() && !tree->restoredIndex())
+    {
+        std::string index = tree->saveIndex();
+        // Write under a temporary name so readers never see half a file.
+        std::string temporary = cacheFile + "." + std::to_string(getpid());
+        if (!index.empty() && makeDirectories(directory))
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out << key << index;
+            out.close();
+            if (!out || std::rename(temporary.c_str(), cacheFile.c_str()) != 0)
+                std::remove(temporary.c_str());
+        }
+    }
+    return tree;
+}
+
+FileWatcher::FileWatcher(const std::string &path)
+    : watchedPath(path)
+{
+    statChanged();
+#if defined(__linux__)
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0 && inotify_add_watch(fd, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE) < 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+#elif defined(JSON_VIEW_KQUEUE)
+    fileFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    fd = fileFd >= 0 ? kqueue() : -1;
+    if (fd >= 0)
+    {
+        struct kevent change;
+        EV_SET(&change, fileFd, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB, 0, nullptr);
+        if (kevent(fd, &change, 1, nullptr, 0, nullptr) < 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+    if (fd >= 0)
+        ::close(fd);
+    if (fileFd >= 0)
+        ::close(fileFd);
+}
+
+bool FileWatcher::changed()
+{
+    if (fd < 0)
+        return statChanged();
+    bool any = false;
+#if defined(__linux__)
+    alignas(struct inotify_event) char events[4096];
+    while (::read(fd, events, sizeof(events)) > 0)
+        any = true;
+#elif defined(JSON_VIEW_KQUEUE)
+    struct kevent event;
+    struct timespec poll = {0, 0};
+    while (kevent(fd, nullptr, 0, &event, 1, &poll) > 0)
+        any = true;
+#endif
+    return any;
+}
+
+// The polling fallback: the file changed if its size or modification time
+// did.
+bool FileWatcher::statChanged()
+{
+    struct stat st;
+    if (::stat(watchedPath.c_str(), &st) != 0)
+        return false;
+    int64_t modified = static_cast<int64_t>(st.st_mtime);
+    bool changed = st.st_size != lastSize || modified != lastModified;
+    lastSize = st.st_size;
+    lastModified = modified;
+    return changed;
+}
+
+// Line-delimited and indexed inputs stay mapped and are parsed a piece at
+// a time, so they need about their own size rather than a whole DOM.
+static size_t memoryEstimate(size_t inputSize, bool mapped)
+{
+    return mapped ? inputSize : inputSize * kDomBytesPerInputByte;
+}
+
+// How much larger the text of a compressed input is assumed to be; JSON
+// typically compresses by this much or more.
+static constexpr size_t kCompressionRatio = 8;
+
+// Validation only ever holds one chunk of an input.
+size_t DocumentLoader::memoryEstimate(const Job &job) const
+{
+    if (!buildTrees)
+        return kValidateChunk;
+    size_t size = job.total.load(std::memory_order_relaxed);
+    if (job.compressed)
+        size = size > SIZE_MAX / kCompressionRatio ? SIZE_MAX : size * kCompressionRatio;
+    return ::memoryEstimate(size, job.lines || job.indexed);
+}
+
+InputFormat resolveFormat(InputFormat format, const std::string &path, size_t size, size_t memoryBudget)
+{
+    if (format != InputFormat::Auto)
+        return format;
+    if (isLineDelimitedPath(path))
+        return InputFormat::Lines;
+    if (memoryEstimate(size, false) > (memoryBudget ? memoryBudget : defaultMemoryBudget()))
+        return InputFormat::Indexed;
+    return InputFormat::Json;
+}
+
+DocumentLoader::DocumentLoader(std::vector<std::string> paths, bool buildTrees, InputFormat format,
+                               unsigned threads, size_t memoryBudget)
+    : memoryBudget(memoryBudget ? memoryBudget : defaultMemoryBudget()), buildTrees(buildTrees),
+      started(std::chrono::steady_clock::now())
+{
+    for (std::string &path : paths)
+    {
+        auto job = std::make_unique<Job>();
+        job->label = path.empty() ? "(stdin)" : path;
+        job->path = std::move(path);
+        job->lines = format == InputFormat::Lines ||
+                     (format == InputFormat::Auto && isLineDelimitedPath(job->path));
+        job->progress.cancel = &cancel;
+        // Sizes are known up front for regular files so the overall
+        // progress does not jump as each file is opened.
+        struct stat st;
+        int rc = job->path.empty() ? fstat(STDIN_FILENO, &st) : stat(job->path.c_str(), &st);
+        if (rc == 0 && S_ISREG(st.st_mode))
+            job->total.store(static_cast<size_t>(st.st_size), std::memory_order_relaxed);
+        job->compressed = !job->path.empty() && fileCompression(job->path) != Compression::None;
+        // Validation reads inputs as a stream, so it never indexes.  The
+        // text of a compressed file is guessed from a typical ratio.
+        size_t size = job->total.load(std::memory_order_relaxed);
+        if (job->compressed)
+            size = size > SIZE_MAX / kCompressionRatio ? SIZE_MAX : size * kCompressionRatio;
+        InputFormat resolved = resolveFormat(format, job->path, size, this->memoryBudget);
+        job->indexed = buildTrees && resolved == InputFormat::Indexed;
+        jobs.push_back(std::move(job));
+    }
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t count = std::min<size_t>(threads, jobs.size());
+    for (size_t i = 0; i < count; ++i)
+        workers.emplace_back(&DocumentLoader::run, this);
+}
+
+DocumentLoader::~DocumentLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancel.store(true, std::memory_order_relaxed);
+    }
+    budgetChanged.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+// Workers claim inputs in command-line order, so the document the caller
+// waits for next is always the oldest one in progress.
+void DocumentLoader::run()
+{
+    for (;;)
+    {
+        Job *job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            budgetChanged.wait(lock, [&] {
+                if (cancel.load(std::memory_order_relaxed) || nextToStart >= jobs.size())
+                    return true;
+                size_t estimate = memoryEstimate(*jobs[nextToStart]);
+                return memoryReserved == 0 || memoryReserved + estimate <= memoryBudget;
+            });
+            if (cancel.load(std::memory_order_relaxed) || nextToStart >= jobs.size())
+                return;
+            job = jobs[nextToStart++].get();
+            job->reserved = memoryEstimate(*job);
+            memoryReserved += job->reserved;
+        }
+        load(*job);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->finished = true;
+            // A failed input holds no document, so its share is free again.
+            if (!job->result.loaded())
+                releaseReservation(*job);
+        }
+        jobFinished.notify_all();
+    }
+}
+
+// Called with the mutex held.
+void DocumentLoader::releaseReservation(Job &job)
+{
+    if (job.reserved == 0)
+        return;
+    memoryReserved -= job.reserved;
+    job.reserved = 0;
+    budgetChanged.notify_all();
+}
+
+void DocumentLoader::load(Job &job)
+{
+    LoadedDocument &result = job.result;
+    result.label = job.label;
+    if (!buildTrees)
+    {
+        validate(job);
+        return;
+    }
+
+    InputBuffer input;
+    std::string openError;
+    bool opened = job.path.empty() ? input.openDescriptor(STDIN_FILENO, openError)
+                                   : input.openFile(job.path, openError);
+    if (!opened)
+    {
+        result.error = openError;
+        result.openFailed = true;
+        return;
+    }
+    result.size = input.size();
+    job.total.store(input.size(), std::memory_order_relaxed);
+    // Empty standard input is not an error; there is simply nothing to show.
+    if (job.path.empty() && input.empty())
+        return;
+    result.compressed = detectCompression(input.view()) != Compression::None;
+
+    // Indexes point into the text, so that has to exist as a whole.
+    if (result.compressed && (job.lines || job.indexed))
+    {
+        try
+        {
+            if (!input.decompress(openError, &job.progress))
+            {
+                result.error = openError;
+                return;
+            }
+        }
+        catch (const std::exception &ex)
+        {
+            result.error = ex.what();
+            return;
+        }
+        job.total.store(input.size(), std::memory_order_relaxed);
+        job.progress.consumed.store(0, std::memory_order_relaxed);
+    }
+
+    if (job.lines)
+    {
+        loadLines(job, std::move(input));
+        return;
+    }
+    if (job.indexed)
+    {
+        try
+        {
+            result.tree = job.path.empty() ? std::make_unique<NodeTree>(std::move(input), result.label,
+                                                                        NodeTree::Layout::Indexed, &job.progress)
+                                           : buildIndexedTree(std::move(input), job.path, NodeTree::Layout::Indexed,
+                                                              &job.progress);
+        }
+        catch (const std::exception &ex)
+        {
+            result.error = ex.what();
+        }
+        return;
+    }
+
+    try
+    {
+        result.doc = std::make_unique<json>(result.compressed ? parseCompressedJson(input.view(), &job.progress)
+                                                              : parseJsonWithSpecialNumbers(input.view(), &job.progress));
+        // The DOM owns copies of all values; give the input back early so
+        // it does not count twice against memory while the next file loads.
+        input.release();
+        result.tree = buildTree(result.doc.get(), result.label);
+    }
+    catch (const std::exception &ex)
+    {
+        result.doc.reset();
+        result.error = ex.what();
+    }
+}
+
+// Check an input without keeping anything of it.
+void DocumentLoader::validate(Job &job)
+{
+    LoadedDocument &result = job.result;
+    int fd = job.path.empty() ? STDIN_FILENO : ::open(job.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        result.error = std::strerror(errno);
+        result.openFailed = true;
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        result.size = static_cast<size_t>(st.st_size);
+        job.total.store(result.size, std::memory_order_relaxed);
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    try
+    {
+        result.valid = validateJson(fd, job.lines, result.error, &job.progress);
+    }
+    catch (const std::exception &ex)
+    {
+        result.error = ex.what();
+    }
+    if (!job.path.empty())
+        ::close(fd);
+    // Empty standard input is not an error; there is simply nothing to check.
+    if (!result.valid && job.path.empty() && job.progress.consumed.load(std::memory_order_relaxed) == 0)
+        result.error.clear();
+}
+
+// Index a line-delimited input.
+void DocumentLoader::loadLines(Job &job, InputBuffer input)
+{
+    LoadedDocument &result = job.result;
+    try
+    {
+        result.tree = job.path.empty()
+                          ? std::make_unique<NodeTree>(std::move(input), result.label, NodeTree::Layout::Lines,
+                                                       &job.progress)
+                          : buildIndexedTree(std::move(input), job.path, NodeTree::Layout::Lines, &job.progress);
+    }
+    catch (const std::exception &ex)
+    {
+        result.tree.reset();
+        result.error = ex.what();
+    }
+}
+
+std::vector<LoadedDocument> DocumentLoader::takeFinished()
+{
+    std::vector<LoadedDocument> out;
+    std::lock_guard<std::mutex> lock(mutex);
+    while (nextToTake < jobs.size() && jobs[nextToTake]->finished)
+    {
+        Job &job = *jobs[nextToTake++];
+        releaseReservation(job);
+        out.push_back(std::move(job.result));
+    }
+    return out;
+}
+
+bool DocumentLoader::waitNext(LoadedDocument &out)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (nextToTake >= jobs.size())
+        return false;
+    jobFinished.wait(lock, [&] { return jobs[nextToTake]->finished; });
+    Job &job = *jobs[nextToTake++];
+    releaseReservation(job);
+    out = std::move(job.result);
+    return true;
+}
+
+bool DocumentLoader::waitReady(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (nextToTake >= jobs.size())
+        return false;
+    return jobFinished.wait_for(lock, timeout, [&] { return jobs[nextToTake]->finished; });
+}
+
+bool DocumentLoader::done() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nextToTake >= jobs.size();
+}
+
+size_t DocumentLoader::bytesConsumed() const
+{
+    size_t total = 0;
+    for (const auto &job : jobs)
+        total += job->progress.consumed.load(std::memory_order_relaxed);
+    return total;
+}
+
+size_t DocumentLoader::bytesTotal() const
+{
+    size_t total = 0;
+    for (const auto &job : jobs)
+        total += job->total.load(std::memory_order_relaxed);
+    return total;
+}
+
+size_t DocumentLoader::pendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t pending = 0;
+    for (size_t i = nextToTake; i < jobs.size(); ++i)
+    {
+        if (!jobs[i]->finished)
+            ++pending;
+    }
+    return pending;
+}
+
+double DocumentLoader::secondsElapsed() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+std::string DocumentLoader::currentLabel() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = nextToTake; i < jobs.size(); ++i)
+    {
+        if (!jobs[i]->finished)
+            return jobs[i]->label;
+    }
+    return std::string();
 }
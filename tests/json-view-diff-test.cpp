@@ -0,0 +1,65 @@
+// Diffs two indexed documents and checks the differences found.
+// Usage: json-view-diff-test LEFT RIGHT EXPECTED...
+// where each EXPECTED is a node reported as different and how, such as
+// "b/y changed", with its path relative to its document, in the order
+// they are reported.
+#include "json_view_core.hpp"
+
+#include <iostream>
+
+static std::string relativePath(const Node *node)
+{
+    std::string path;
+    for (; node->parent; node = node->parent)
+        path = nodeKey(node) + (path.empty() ? "" : "/") + path;
+    return path;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " LEFT RIGHT EXPECTED..." << std::endl;
+        return 2;
+    }
+    std::unique_ptr<NodeTree> trees[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        InputBuffer input;
+        std::string error;
+        if (!input.openFile(argv[1 + i], error))
+        {
+            std::cerr << argv[1 + i] << ": " << error << std::endl;
+            return 2;
+        }
+        trees[i] = buildIndexedTree(std::move(input), argv[1 + i], NodeTree::Layout::Indexed);
+    }
+
+    SearchState state;
+    SearchJob job(trees[0]->root(), trees[1]->root());
+    job.wait();
+    job.collect(state);
+
+    std::vector<std::string> found;
+    for (const Node *match : state.matches)
+    {
+        const DiffChange *change = state.change(match);
+        std::string kind = !change                        ? "?"
+                           : *change == DiffChange::Added   ? "added"
+                           : *change == DiffChange::Removed ? "removed"
+                           : *change == DiffChange::Moved   ? "moved"
+                                                            : "changed";
+        found.push_back(relativePath(match) + " " + kind);
+    }
+    std::vector<std::string> expected(argv + 3, argv + argc);
+    if (found == expected)
+        return 0;
+    std::cerr << "expected:";
+    for (const std::string &item : expected)
+        std::cerr << " [" << item << "]";
+    std::cerr << "\nfound:   ";
+    for (const std::string &item : found)
+        std::cerr << " [" << item << "]";
+    std::cerr << std::endl;
+    return 1;
+}
@@ -0,0 +1,73 @@
+// Expands a generated document in small steps and checks that the row
+// counts kept along the way match those of a single expandAll() or
+// expandToLevel(), and a count from scratch after every step.
+#include "json_view_core.hpp"
+
+#include <iostream>
+
+static uint64_t countRows(const Node *node)
+{
+    uint64_t rows = 1;
+    if (node->expanded)
+    {
+        for (const Node &child : builtChildren(node))
+            rows += countRows(&child);
+    }
+    return rows;
+}
+
+static json makeDocument()
+{
+    json doc = json::object();
+    for (int i = 0; i < 300; ++i)
+    {
+        json item = {{"id", i}, {"tags", json::array()}, {"nested", {{"a", {1, 2, {{"b", i}}}}}}};
+        for (int t = 0; t < i % 7; ++t)
+            item["tags"].push_back("t" + std::to_string(t));
+        doc["items"].push_back(item);
+    }
+    doc["empty"] = json::object();
+    doc["name"] = "expand";
+    return doc;
+}
+
+static bool check(const char *what, int maxLevel, uint64_t budget)
+{
+    json doc = makeDocument();
+    std::unique_ptr<NodeTree> whole = buildTree(&doc, "whole");
+    std::unique_ptr<NodeTree> stepped = buildTree(&doc, "stepped");
+    if (maxLevel == Expansion::unlimited)
+        expandAll(whole->root());
+    else
+        expandToLevel(whole->root(), maxLevel);
+
+    // Start from a partly expanded tree, as a user would
+    setExpanded(stepped->root(), true);
+    setExpanded(&ensureChildren(stepped->root())[0], true);
+
+    Expansion expansion({stepped->root()}, maxLevel);
+    for (size_t steps = 0; !expansion.step(budget); ++steps)
+    {
+        uint64_t counted = countRows(stepped->root());
+        if (stepped->root()->visibleCount != counted || steps > 100000)
+        {
+            std::cerr << what << ": step " << steps << " keeps " << stepped->root()->visibleCount
+                      << " rows, counted " << counted << std::endl;
+            return false;
+        }
+    }
+    uint64_t expected = whole->root()->visibleCount;
+    uint64_t found = stepped->root()->visibleCount;
+    if (found == expected && countRows(stepped->root()) == expected)
+        return true;
+    std::cerr << what << ": " << found << " rows after steps, " << expected << " in one go" << std::endl;
+    return false;
+}
+
+int main()
+{
+    bool ok = check("expand all", Expansion::unlimited, 7);
+    ok = check("expand to level 3", 3, 5) && ok;
+    ok = check("expand to level 0", 0, 1) && ok;
+    return ok ? 0 : 1;
+}
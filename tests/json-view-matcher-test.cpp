@@ -0,0 +1,118 @@
+// Checks CaseInsensitiveMatcher against a plain byte-by-byte search with
+// needles at every position around the 16-byte chunks of its vector
+// loop, on non-ASCII text, and through value searches on floats.
+#include "json_view_core.hpp"
+
+#include <clocale>
+#include <iostream>
+
+static int failures = 0;
+
+static void expect(bool found, bool wanted, const std::string &needle, const std::string &haystack)
+{
+    if (found == wanted)
+        return;
+    ++failures;
+    std::cerr << "'" << needle << "' in '" << haystack << "': " << (found ? "found" : "not found") << std::endl;
+}
+
+static bool plainFind(const std::string &needle, const std::string &haystack)
+{
+    auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; };
+    for (size_t i = 0; i + needle.size() <= haystack.size(); ++i)
+    {
+        size_t k = 0;
+        while (k < needle.size() && lower(haystack[i + k]) == lower(needle[k]))
+            ++k;
+        if (k == needle.size())
+            return true;
+    }
+    return false;
+}
+
+static void chunkBoundaries()
+{
+    for (const std::string needle : {"q", "Qz", "qUz", "quZaR", "QuzarQuzarQuzarQu"})
+    {
+        CaseInsensitiveMatcher matcher(needle);
+        std::string upper = needle;
+        for (char &c : upper)
+            c = c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : static_cast<char>(c - 'A' + 'a');
+        for (size_t size = 0; size <= 80; ++size)
+        {
+            std::string haystack(size, 'x');
+            expect(matcher.matches(haystack), false, needle, haystack);
+            for (size_t at = 0; at < size; ++at)
+            {
+                // Whole, or cut short by the end of the haystack
+                std::string placed = haystack;
+                placed.replace(at, std::min(upper.size(), size - at), upper, 0, size - at);
+                placed.resize(size);
+                expect(matcher.matches(placed), plainFind(needle, placed), needle, placed);
+                // A first byte that matches with a last one that does not
+                if (at + needle.size() <= size && needle.size() > 1)
+                {
+                    std::string near = placed;
+                    near[at + needle.size() - 1] = 'x';
+                    expect(matcher.matches(near), plainFind(needle, near), needle, near);
+                }
+            }
+        }
+    }
+}
+
+static void nonAscii()
+{
+    expect(CaseInsensitiveMatcher("köln").matches("Grüße aus KÖLN"), true, "köln", "Grüße aus KÖLN");
+    expect(CaseInsensitiveMatcher("ÄRGER").matches("kein ärger"), true, "ÄRGER", "kein ärger");
+    expect(CaseInsensitiveMatcher("ωmega").matches("ΩMEGA"), true, "ωmega", "ΩMEGA");
+    expect(CaseInsensitiveMatcher("café").matches("CAFE"), false, "café", "CAFE");
+    for (size_t pad = 0; pad <= 40; ++pad)
+    {
+        // Multi-byte characters on either side of the chunk edges
+        std::string haystack = std::string(pad, 'a') + "Ünïcode " + std::string(pad % 17, 'b') + "Ende";
+        expect(CaseInsensitiveMatcher("üNÏCODE").matches(haystack), true, "üNÏCODE", haystack);
+        expect(CaseInsensitiveMatcher("ende").matches(haystack), true, "ende", haystack);
+        expect(CaseInsensitiveMatcher("ünïcodf").matches(haystack), false, "ünïcodf", haystack);
+        expect(CaseInsensitiveMatcher("bü").matches(haystack), false, "bü", haystack);
+    }
+}
+
+// Value searches see floats as they are printed.
+static void floats()
+{
+    json doc = {{"a", 2.5}, {"b", 1e100}, {"c", 0.1}, {"d", -0.0}, {"e", 3}};
+    std::unique_ptr<NodeTree> tree = buildTree(&doc, "floats");
+    const std::pair<const char *, std::vector<std::string>> cases[] = {
+        {"2.5", {"a"}}, {"E+100", {"b"}}, {"0.1", {"c"}}, {"-0.0", {"d"}}, {".0", {"d"}}, {"3", {"e"}},
+    };
+    for (const auto &[term, wanted] : cases)
+    {
+        SearchJob job({tree->root()}, term, false, true);
+        job.wait();
+        std::vector<const Node *> matches;
+        job.collect(matches);
+        std::vector<std::string> found;
+        for (const Node *match : matches)
+            found.push_back(nodeKey(match));
+        if (found == wanted)
+            continue;
+        ++failures;
+        std::cerr << "values matching '" << term << "':";
+        for (const std::string &key : found)
+            std::cerr << " " << key;
+        std::cerr << std::endl;
+    }
+}
+
+int main()
+{
+    chunkBoundaries();
+    // Code points are folded as the locale says, as in the viewers
+    if (std::setlocale(LC_ALL, "C.UTF-8") || std::setlocale(LC_ALL, "en_US.UTF-8"))
+        nonAscii();
+    else
+        std::cerr << "no UTF-8 locale; skipping non-ASCII cases" << std::endl;
+    floats();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+// Runs a JSONPath query, or resolves a JSON Pointer when it starts with /,
+// over a document and checks the nodes found.
+// Usage: json-view-query-test DOCUMENT QUERY EXPECTED...
+// where each EXPECTED is the path of a node found, such as "store/bike",
+// relative to the document, in the order they are found; "error" stands
+// for a query or pointer that is rejected.
+#include "json_view_core.hpp"
+
+#include <iostream>
+
+static std::string relativePath(const Node *node)
+{
+    std::string path;
+    for (; node->parent; node = node->parent)
+        path = nodeKey(node) + (path.empty() ? "" : "/") + path;
+    return path;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " DOCUMENT QUERY EXPECTED..." << std::endl;
+        return 2;
+    }
+    InputBuffer input;
+    std::string error;
+    if (!input.openFile(argv[1], error))
+    {
+        std::cerr << argv[1] << ": " << error << std::endl;
+        return 2;
+    }
+    std::unique_ptr<NodeTree> tree = buildIndexedTree(std::move(input), argv[1], NodeTree::Layout::Indexed);
+    std::string text = argv[2];
+
+    std::vector<std::string> found;
+    if (!text.empty() && text[0] == '/')
+    {
+        if (const Node *node = resolvePointer(tree->root(), text, error))
+            found.push_back(relativePath(node));
+    }
+    else
+    {
+        Query query;
+        if (query.compile(text, error))
+        {
+            SearchJob job({tree->root()}, std::move(query));
+            job.wait();
+            std::vector<const Node *> matches;
+            job.collect(matches);
+            for (const Node *match : matches)
+                found.push_back(relativePath(match));
+        }
+    }
+    if (!error.empty())
+        found.push_back("error");
+
+    std::vector<std::string> expected(argv + 3, argv + argc);
+    if (found == expected)
+        return 0;
+    std::cerr << text << (error.empty() ? "" : ": " + error) << "\nexpected:";
+    for (const std::string &item : expected)
+        std::cerr << " [" << item << "]";
+    std::cerr << "\nfound:   ";
+    for (const std::string &item : found)
+        std::cerr << " [" << item << "]";
+    std::cerr << std::endl;
+    return 1;
+}